@@ -0,0 +1,225 @@
+/**
+ @file bench.hpp
+ @author pat <pat@fourthbox.com>
+
+ A minimal, header only benchmark harness, writing results in the JSON format of Google Benchmark so that its
+ comparison tools can be used on them.
+ */
+
+#ifndef LIBPMG_BENCH_HPP_
+#define LIBPMG_BENCH_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace libpmg {
+namespace bench {
+
+static const double kMinTime                {0.5};
+static const std::uint64_t kMaxIterations   {1000000000};
+
+/**
+ The state of a running benchmark. Only the code inside the KeepRunning loop is measured, so that the setup before
+ it is not.
+ */
+class State {
+public:
+    State(std::uint64_t iterations) : iterations_ {iterations}, done_ {0}, items_ {0}, elapsed_ {0.0} {}
+
+    /**
+     Advances the loop, starting the clock on the first call and stopping it on the last.
+     @return True while iterations are left
+     */
+    inline bool KeepRunning() {
+        if (done_ == 0)
+            start_ = std::chrono::steady_clock::now();
+
+        if (done_ < iterations_) {
+            done_++;
+            return true;
+        }
+
+        elapsed_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        return false;
+    }
+
+    /**
+     Stops the clock, to exclude work done inside the loop.
+     */
+    inline void PauseTiming() { elapsed_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count(); }
+
+    /**
+     Restarts the clock after PauseTiming.
+     */
+    inline void ResumeTiming() { start_ = std::chrono::steady_clock::now(); }
+
+    /**
+     Sets the number of items processed by every iteration, to report a throughput.
+     @param items The number of items
+     */
+    inline void SetItemsPerIteration(std::uint64_t items) { items_ = items; }
+
+    inline std::uint64_t GetIterations() const { return iterations_; }
+    inline std::uint64_t GetItemsPerIteration() const { return items_; }
+    inline double GetElapsed() const { return elapsed_; }
+
+private:
+    std::uint64_t iterations_;
+    std::uint64_t done_;
+    std::uint64_t items_;
+    double elapsed_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ A registered benchmark.
+ */
+struct Benchmark {
+    std::string name_;
+    std::function<void(State&)> function_;
+};
+
+/**
+ Gets the list of registered benchmarks.
+ */
+inline std::vector<Benchmark> &GetBenchmarks() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+/**
+ Registers a benchmark.
+ @param name The name of the benchmark
+ @param function The function running the benchmark
+ */
+inline void Register(std::string const &name, std::function<void(State&)> const &function) {
+    GetBenchmarks().push_back(Benchmark {name, function});
+}
+
+/**
+ Appends a string to a JSON document, escaping it.
+ */
+inline void AppendJsonString(std::string &json, std::string const &value) {
+    json += '"';
+    for (auto c : value) {
+        if (c == '"' || c == '\\')
+            json += '\\';
+        json += c;
+    }
+    json += '"';
+}
+
+/**
+ Runs the registered benchmarks, growing the iterations of each until it runs for at least kMinTime.
+ Accepts --filter=<substring>, --min_time=<seconds> and --json=<path>.
+ @return The exit code of the program
+ */
+inline int Run(int argc, char **argv, char const *version) {
+    std::string filter;
+    std::string json_path;
+    auto min_time {kMinTime};
+
+    for (auto i {1}; i < argc; i++) {
+        if (std::strncmp(argv[i], "--filter=", 9) == 0) {
+            filter = argv[i] + 9;
+        } else if (std::strncmp(argv[i], "--json=", 7) == 0) {
+            json_path = argv[i] + 7;
+        } else if (std::strncmp(argv[i], "--min_time=", 11) == 0) {
+            min_time = std::atof(argv[i] + 11);
+        } else {
+            std::fprintf(stderr, "Usage: %s [--filter=<substring>] [--min_time=<seconds>] [--json=<path>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    char date[32];
+    auto now {std::time(nullptr)};
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    std::string json {"{\n  \"context\": {\n    \"date\": "};
+    AppendJsonString(json, date);
+    json += ",\n    \"library_version\": ";
+    AppendJsonString(json, version);
+#ifdef NDEBUG
+    json += ",\n    \"library_build_type\": \"release\"\n  },\n  \"benchmarks\": [";
+#else
+    json += ",\n    \"library_build_type\": \"debug\"\n  },\n  \"benchmarks\": [";
+#endif
+
+    std::printf("%-44s %14s %12s %16s\n", "Benchmark", "Time", "Iterations", "Items/s");
+    auto first {true};
+
+    for (auto const &benchmark : GetBenchmarks()) {
+        if (benchmark.name_.find(filter) == std::string::npos)
+            continue;
+
+        // Grow the iterations from the time of the previous run, like Google Benchmark
+        std::uint64_t iterations {1};
+        State state {iterations};
+
+        while (true) {
+            state = State {iterations};
+            benchmark.function_(state);
+
+            if (state.GetElapsed() >= min_time || iterations >= kMaxIterations)
+                break;
+
+            auto scale {state.GetElapsed() > 0.0 ? min_time * 1.4 / state.GetElapsed() : 100.0};
+            iterations = std::min(kMaxIterations, std::max(iterations + 1, static_cast<std::uint64_t>(iterations * std::min(scale, 100.0))));
+        }
+
+        auto time_ns {state.GetElapsed() * 1e9 / state.GetIterations()};
+        auto items_per_second {state.GetItemsPerIteration() * state.GetIterations() / state.GetElapsed()};
+
+        std::printf("%-44s %11.0f ns %12llu", benchmark.name_.c_str(), time_ns, static_cast<unsigned long long>(state.GetIterations()));
+        if (state.GetItemsPerIteration())
+            std::printf(" %16.4g", items_per_second);
+        std::printf("\n");
+
+        char values[160];
+        std::snprintf(values, sizeof(values), ",\n      \"iterations\": %llu,\n      \"real_time\": %.3f,\n      \"time_unit\": \"ns\"",
+                      static_cast<unsigned long long>(state.GetIterations()), time_ns);
+
+        json += first ? "\n    {\n      \"name\": " : ",\n    {\n      \"name\": ";
+        AppendJsonString(json, benchmark.name_);
+        json += values;
+
+        if (state.GetItemsPerIteration()) {
+            std::snprintf(values, sizeof(values), ",\n      \"items_per_second\": %.3f", items_per_second);
+            json += values;
+        }
+
+        json += "\n    }";
+        first = false;
+    }
+
+    json += "\n  ]\n}\n";
+
+    if (!json_path.empty()) {
+        auto file {std::fopen(json_path.c_str(), "w")};
+
+        if (file == nullptr || std::fwrite(json.data(), 1, json.size(), file) != json.size()) {
+            std::fprintf(stderr, "Unable to write %s\n", json_path.c_str());
+            if (file != nullptr)
+                std::fclose(file);
+            return 1;
+        }
+
+        std::fclose(file);
+    }
+
+    return 0;
+}
+
+}
+}
+
+#endif /* LIBPMG_BENCH_HPP_ */
@@ -0,0 +1,387 @@
+/**
+ @file pmg_bench.cpp
+ @author pat <pat@fourthbox.com>
+
+ Benchmarks dungeon and world generation, the path finding algorithms, the path service, fields of view and tag
+ operations.
+ Every map is generated from a fixed seed, so that runs are comparable.
+ Run it with --json=<path> to store the results, and compare them with the tools of Google Benchmark.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+#include "bench.hpp"
+#include "constants.hpp"
+#include "libpmg.hpp"
+
+using namespace libpmg;
+using namespace libpmg::bench;
+
+static const int kBenchSeed {1};
+
+/**
+ Resets the generator of the calling thread to the benchmark seed.
+ */
+static void ResetSeed() {
+    RndManager::seed_ = kBenchSeed;
+    RndManager::GetInstance().ResetInstance();
+}
+
+/**
+ Sets up a dungeon builder, without generating anything.
+ */
+static void SetupDungeon(DungeonBuilder &builder, std::size_t width, std::size_t height, std::size_t rooms) {
+    builder.SetMapSize(width, height);
+    builder.SetMinRoomSize(4, 4);
+    builder.SetMaxRoomSize(12, 12);
+    builder.SetMaxRoomPlacementAttempts(10);
+    builder.SetMaxRooms(rooms);
+    builder.SetMaxUpstairs(2);
+    builder.SetMaxDownstairs(2);
+}
+
+static void RegisterDungeon(std::size_t width, std::size_t height, std::size_t rooms) {
+    auto name {"DungeonBuilder/" + std::to_string(width) + "x" + std::to_string(height) + "/" + std::to_string(rooms)};
+
+    Register(name, [=] (State &state) {
+        state.SetItemsPerIteration(width * height);
+
+        while (state.KeepRunning()) {
+            ResetSeed();
+
+            DungeonBuilder builder;
+            SetupDungeon(builder, width, height, rooms);
+            builder.InitMap();
+            builder.GenerateRooms();
+            builder.GenerateCorridors();
+            builder.GenerateDoors();
+            builder.GenerateWallStairs();
+            builder.GenerateGroundStairs();
+            builder.Build();
+        }
+    });
+}
+
+/**
+ Registers a path finding benchmark, searching between the first and the last room of a fixed dungeon.
+ */
+static void RegisterPath(std::string const &algorithm,
+                         std::size_t width,
+                         std::size_t height,
+                         std::function<void(std::pair<std::size_t, std::size_t>, std::pair<std::size_t, std::size_t>, Map*)> const &search) {
+    Register(algorithm + "/" + std::to_string(width) + "x" + std::to_string(height), [=] (State &state) {
+        ResetSeed();
+
+        DungeonBuilder builder;
+        SetupDungeon(builder, width, height, width * height / 400);
+        builder.InitMap();
+        builder.GenerateRooms();
+        builder.GenerateCorridors();
+
+        auto &map {*builder.Build()};
+        auto &rooms {((DungeonMap&)map).GetRoomList()};
+        std::pair<std::size_t, std::size_t> start {rooms.front()->GetRect().GetX(), rooms.front()->GetRect().GetY()};
+        std::pair<std::size_t, std::size_t> end {rooms.back()->GetRect().GetX(), rooms.back()->GetRect().GetY()};
+
+        state.SetItemsPerIteration(1);
+
+        while (state.KeepRunning())
+            search(start, end, &map);
+    });
+}
+
+/**
+ Registers a weighted path finding benchmark, crossing a fixed world map from corner to corner with diagonal moves.
+ */
+static void RegisterWorldPath(std::size_t width, std::size_t height) {
+    auto size {std::to_string(width) + "x" + std::to_string(height)};
+    auto setup = [=] (WorldBuilder &builder) {
+        ResetSeed();
+        builder.SetMapSize(width, height);
+        builder.InitMap();
+        builder.GenerateHeightMap();
+        builder.ApplyHeightMap();
+    };
+
+    Register("WeightedAstar/TerrainCost/" + size, [=] (State &state) {
+        WorldBuilder builder;
+        setup(builder);
+
+        auto &map {*builder.Build()};
+        TerrainCost cost {(WorldMap&)map};
+        OctileHeuristic heuristic {cost.GetLowestCost()};
+        SearchContext context;
+
+        state.SetItemsPerIteration(1);
+
+        while (state.KeepRunning())
+            Utils::WeightedAstar({0, 0}, {width - 1, height - 1}, &map, MoveDirections::EIGHT_DIRECTIONAL, cost, heuristic,
+                                 std::pmr::get_default_resource(), &context);
+    });
+
+    Register("WeightedAstar/CostLayer/" + size, [=] (State &state) {
+        WorldBuilder builder;
+        setup(builder);
+
+        auto &map {*builder.Build()};
+        auto layer {TerrainCost {(WorldMap&)map}.BuildLayer()};
+        CostLayer cost {layer};
+        OctileHeuristic heuristic {CostLayer::GetLowestCost(layer)};
+        SearchContext context;
+
+        state.SetItemsPerIteration(1);
+
+        while (state.KeepRunning())
+            Utils::WeightedAstar({0, 0}, {width - 1, height - 1}, &map, MoveDirections::EIGHT_DIRECTIONAL, cost, heuristic,
+                                 std::pmr::get_default_resource(), &context);
+    });
+}
+
+/**
+ Registers a search queue benchmark, running a Dijkstra search over every tile of a grid with small random costs.
+ */
+template<typename Queue, typename MakeQueue>
+static void RegisterSearchQueue(std::string const &queue, std::size_t width, std::size_t height, MakeQueue make_queue) {
+    Register("SearchQueue/" + queue + "/" + std::to_string(width) + "x" + std::to_string(height), [=] (State &state) {
+        ResetSeed();
+
+        std::vector<std::uint32_t> costs(width * height);
+        for (auto &cost : costs)
+            cost = static_cast<std::uint32_t>(RndManager::GetInstance().GetRandomUintFromRange(1, 9));
+
+        std::vector<std::uint32_t> distances(width * height);
+        std::pmr::vector<std::uint32_t> positions;
+
+        state.SetItemsPerIteration(costs.size());
+
+        while (state.KeepRunning()) {
+            std::fill(distances.begin(), distances.end(), std::numeric_limits<std::uint32_t>::max());
+
+            Queue frontier {make_queue(positions, costs.size())};
+            distances[0] = 0;
+            frontier.push(0, 0);
+
+            while (!frontier.empty()) {
+                auto index {frontier.pop()};
+                auto x {index % width};
+                auto y {index / width};
+                std::size_t neighbors[4];
+                std::size_t count {0};
+
+                if (x > 0) neighbors[count++] = index - 1;
+                if (x + 1 < width) neighbors[count++] = index + 1;
+                if (y > 0) neighbors[count++] = index - width;
+                if (y + 1 < height) neighbors[count++] = index + width;
+
+                for (std::size_t n {0}; n < count; n++) {
+                    auto nei {neighbors[n]};
+                    if (distances[nei] != std::numeric_limits<std::uint32_t>::max())
+                        continue;
+
+                    distances[nei] = distances[index] + costs[nei];
+                    frontier.push(static_cast<std::uint32_t>(nei), distances[nei]);
+                }
+            }
+        }
+
+        if (distances.back() == std::numeric_limits<std::uint32_t>::max())
+            std::printf("unreachable tile\n");
+    });
+}
+
+/**
+ Registers a field of view benchmark, computing the view of every floor tile of a fixed dungeon.
+ */
+static void RegisterFieldOfView(std::size_t width, std::size_t height, std::size_t radius) {
+    Register("FieldOfView/" + std::to_string(width) + "x" + std::to_string(height) + "/" + std::to_string(radius), [=] (State &state) {
+        ResetSeed();
+
+        DungeonBuilder builder;
+        SetupDungeon(builder, width, height, width * height / 400);
+        builder.InitMap();
+        builder.GenerateRooms();
+        builder.GenerateCorridors();
+
+        FieldOfView fov {*builder.Build()};
+        std::vector<std::pair<std::size_t, std::size_t>> observers;
+
+        for (std::size_t y {0}; y < height; y++) {
+            for (std::size_t x {0}; x < width; x++) {
+                if (!fov.IsOpaque(x, y))
+                    observers.emplace_back(x, y);
+            }
+        }
+
+        TileBitset visible {width, height};
+
+        state.SetItemsPerIteration(observers.size());
+
+        while (state.KeepRunning())
+            fov.ComputeUnion(observers, radius, visible, 1);
+    });
+}
+
+/**
+ Registers a path service benchmark, answering queries from every floor tile of a fixed dungeon to a few rooms.
+ */
+static void RegisterPathService(std::size_t width, std::size_t height, std::size_t goals) {
+    Register("PathService/" + std::to_string(width) + "x" + std::to_string(height) + "/" + std::to_string(goals), [=] (State &state) {
+        ResetSeed();
+
+        DungeonBuilder builder;
+        SetupDungeon(builder, width, height, width * height / 400);
+        builder.InitMap();
+        builder.GenerateRooms();
+        builder.GenerateCorridors();
+
+        auto &map {*builder.Build()};
+        auto &rooms {((DungeonMap&)map).GetRoomList()};
+        auto walls {map.GetTagLayer({TagManager::GetInstance().wall_tag_})};
+        std::vector<std::size_t> starts;
+        std::vector<std::size_t> targets;
+
+        for (std::size_t i {0}; i < walls.size(); i++) {
+            if (walls[i] == 0)
+                starts.push_back(i);
+        }
+
+        for (std::size_t r {0}; r < std::min(goals, rooms.size()); r++)
+            targets.push_back(rooms[r]->GetRect().GetY() * width + rooms[r]->GetRect().GetX());
+
+        PathService service {map, MoveDirections::FOUR_DIRECTIONAL};
+        auto on_result = [] (PathResult const &) {};
+
+        state.SetItemsPerIteration(starts.size());
+
+        while (state.KeepRunning()) {
+            for (std::size_t i {0}; i < starts.size(); i++)
+                service.Submit(starts[i], targets[i % targets.size()], on_result);
+
+            service.WaitIdle();
+        }
+    });
+}
+
+static void RegisterTaggable() {
+    Register("Taggable/AddRemoveTag", [] (State &state) {
+        Tile tile {0, 0, {TagManager::GetInstance().wall_tag_}};
+        auto floor {TagManager::GetInstance().floor_tag_};
+
+        state.SetItemsPerIteration(2);
+
+        while (state.KeepRunning()) {
+            tile.AddTag(floor);
+            tile.RemoveTag(floor);
+        }
+    });
+
+    Register("Taggable/HasTag", [] (State &state) {
+        auto &tag_manager {TagManager::GetInstance()};
+        Tile tile {0, 0, {tag_manager.floor_tag_, tag_manager.door_tag_, tag_manager.upstairs_tag_}};
+        auto wall {tag_manager.wall_tag_};
+        std::size_t found {0};
+
+        state.SetItemsPerIteration(1);
+
+        while (state.KeepRunning())
+            found += tile.HasTag(wall);
+
+        if (found)
+            std::printf("unexpected tag\n");
+    });
+
+    Register("Taggable/UpdateTags", [] (State &state) {
+        auto &tag_manager {TagManager::GetInstance()};
+        Tile tile {0, 0, {tag_manager.wall_tag_}};
+        auto floor {tag_manager.floor_tag_};
+        auto wall {tag_manager.wall_tag_};
+
+        state.SetItemsPerIteration(2);
+
+        while (state.KeepRunning()) {
+            tile.UpdateTags({floor}, {wall});
+            tile.UpdateTags({wall}, {floor});
+        }
+    });
+}
+
+static void RegisterWorld(std::size_t width, std::size_t height) {
+    auto size {std::to_string(width) + "x" + std::to_string(height)};
+
+    Register("WorldBuilder/GenerateHeightMap/" + size, [=] (State &state) {
+        ResetSeed();
+
+        WorldBuilder builder;
+        builder.SetMapSize(width, height);
+        builder.InitMap();
+
+        state.SetItemsPerIteration(width * height);
+
+        while (state.KeepRunning())
+            builder.GenerateHeightMap();
+    });
+
+    Register("WorldBuilder/ApplyHeightMap/" + size, [=] (State &state) {
+        ResetSeed();
+
+        WorldBuilder builder;
+        builder.SetMapSize(width, height);
+        builder.InitMap();
+        builder.GenerateHeightMap();
+
+        state.SetItemsPerIteration(width * height);
+
+        while (state.KeepRunning())
+            builder.ApplyHeightMap();
+    });
+}
+
+int main(int argc, char **argv) {
+    Log::SetLevel(LogLevel::WARNING);
+
+    RegisterDungeon(80, 50, 10);
+    RegisterDungeon(128, 80, 25);
+    RegisterDungeon(160, 100, 40);
+
+    for (auto size : {64, 128}) {
+        RegisterPath("BreadthFirstSearch", size, size, [] (auto start, auto end, Map *map) {
+            Utils::BreadthFirstSearch(start, end, map, false, MoveDirections::FOUR_DIRECTIONAL);
+        });
+        RegisterPath("BidirectionalBreadthFirstSearch", size, size, [] (auto start, auto end, Map *map) {
+            Utils::BidirectionalBreadthFirstSearch(start, end, map, false, MoveDirections::FOUR_DIRECTIONAL);
+        });
+        RegisterPath("Dijkstra", size, size, [] (auto start, auto end, Map *map) {
+            Utils::Dijkstra(start, end, map, MoveDirections::FOUR_DIRECTIONAL);
+        });
+        RegisterPath("Astar", size, size, [] (auto start, auto end, Map *map) {
+            Utils::Astar(start, end, map, MoveDirections::FOUR_DIRECTIONAL);
+        });
+    }
+
+    RegisterWorldPath(256, 256);
+
+    RegisterSearchQueue<PriorityQueue<std::uint32_t, std::uint32_t>>("PriorityQueue", 256, 256, [] (auto &, auto) {
+        return PriorityQueue<std::uint32_t, std::uint32_t> {};
+    });
+    RegisterSearchQueue<BucketQueue<std::uint32_t>>("BucketQueue", 256, 256, [] (auto &, auto) {
+        return BucketQueue<std::uint32_t> {16};
+    });
+    RegisterSearchQueue<QuaternaryHeap<std::uint32_t>>("QuaternaryHeap", 256, 256, [] (auto &positions, auto size) {
+        return QuaternaryHeap<std::uint32_t> {positions, size};
+    });
+
+    RegisterFieldOfView(128, 128, 8);
+    RegisterFieldOfView(128, 128, 0);
+
+    RegisterPathService(128, 128, 8);
+
+    RegisterTaggable();
+
+    RegisterWorld(256, 256);
+    RegisterWorld(1024, 1024);
+
+    return Run(argc, argv, kLibraryVersion);
+}
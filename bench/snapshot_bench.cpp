@@ -0,0 +1,122 @@
+/**
+ @file snapshot_bench.cpp
+ @author pat <pat@fourthbox.com>
+
+ Compares the size and the encoding and decoding throughput of map snapshots against the raw tag layer.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+
+#include "libpmg.hpp"
+#include "map_snapshot.hpp"
+
+using namespace libpmg;
+
+static const std::size_t kRepetitions   {20};
+static const std::size_t kPacketSize    {1400};
+
+/**
+ Runs a function several times.
+ @return The average time of a run, in seconds
+ */
+static double Measure(std::function<void()> const &function) {
+    auto start {std::chrono::steady_clock::now()};
+
+    for (std::size_t r {0}; r < kRepetitions; r++)
+        function();
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / kRepetitions;
+}
+
+/**
+ Encodes and decodes a layer with and without the entropy stage, and prints the results.
+ Decoding is fed one network packet at a time, as a client would.
+ */
+static void Run(char const *name, std::vector<std::uint32_t> const &layer, std::size_t width, std::size_t height, std::vector<std::shared_ptr<Tag>> const &tags) {
+    auto raw_size {layer.size() * sizeof(std::uint32_t)};
+    auto raw_mb {raw_size / 1e6};
+
+    std::printf("%-24s %6zux%-6zu raw %10zu B\n", name, width, height, raw_size);
+
+    for (auto entropy_stage : {false, true}) {
+        std::vector<std::uint8_t> snapshot;
+
+        auto encode {Measure([&] {
+            MapSnapshotEncoder encoder {layer, width, height, tags, entropy_stage};
+            snapshot = encoder.Encode();
+        })};
+
+        auto decode {Measure([&] {
+            MapSnapshotDecoder decoder;
+            for (std::size_t offset {0}; offset < snapshot.size(); offset += kPacketSize)
+                decoder.Feed(&snapshot[offset], std::min(kPacketSize, snapshot.size() - offset));
+        })};
+
+        MapSnapshotDecoder decoder;
+        decoder.Feed(snapshot.data(), snapshot.size());
+
+        std::printf("  %-10s %10zu B  ratio %7.1fx  encode %8.1f MB/s  decode %8.1f MB/s  %s\n",
+                    entropy_stage ? "rle+rice" : "rle",
+                    snapshot.size(),
+                    static_cast<double>(raw_size) / snapshot.size(),
+                    raw_mb / encode,
+                    raw_mb / decode,
+                    decoder.IsComplete() && decoder.GetTagLayer() == layer ? "ok" : "MISMATCH");
+    }
+}
+
+static void RunDungeon(std::size_t width, std::size_t height, std::size_t rooms) {
+    DungeonBuilder builder;
+    builder.SetMapSize(width, height);
+    builder.SetMinRoomSize(4, 4);
+    builder.SetMaxRoomSize(12, 12);
+    builder.SetMaxRoomPlacementAttempts(10);
+    builder.SetMaxRooms(rooms);
+    builder.InitMap();
+    builder.GenerateRooms();
+    builder.GenerateCorridors();
+    builder.GenerateDoors();
+    builder.GenerateGroundStairs();
+
+    auto &map {*builder.Build()};
+    auto tags {map.GetTagTable()};
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "dungeon (%zu rooms)", rooms);
+    Run(name, map.GetTagLayer(tags), width, height, tags);
+}
+
+static void RunWorld(std::size_t width, std::size_t height) {
+    WorldBuilder builder;
+    builder.SetMapSize(width, height);
+    builder.InitMap();
+    builder.GenerateHeightMap();
+    builder.ApplyHeightMap();
+
+    auto &map {*builder.Build()};
+    auto tags {map.GetTagTable()};
+    Run("world (tags)", map.GetTagLayer(tags), width, height, tags);
+
+    // World tiles all share the same tags, so also measure a layer of 16 altitude bands
+    std::vector<std::uint32_t> bands(width * height);
+    for (std::size_t i {0}; i < bands.size(); i++) {
+        auto altitude {((WorldTile*)(*map.GetMap())[i].get())->GetAltitude()};
+        bands[i] = static_cast<std::uint32_t>(std::fmin(15.0f, std::fmax(0.0f, (altitude + 1.0f) * 8.0f)));
+    }
+    Run("world (altitude bands)", bands, width, height, {});
+}
+
+int main(int argc, char **argv) {
+    RndManager::seed_ = 1;
+
+    RunDungeon(100, 45, 10);
+    RunDungeon(256, 256, 60);
+    RunWorld(256, 256);
+    RunWorld(1024, 1024);
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ @file connectivity.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_CONNECTIVITY_HPP_
+#define LIBPMG_CONNECTIVITY_HPP_
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "grid.hpp"
+
+namespace libpmg {
+
+static const std::uint32_t kNoComponent         {0};
+static const std::uint32_t kUnreachableDistance {std::numeric_limits<std::uint32_t>::max()};
+
+/**
+ A struct containing reachability functions over a dense walkable layer.
+ Layers are row major vectors, holding a non zero value for every walkable tile.
+ */
+struct Connectivity {
+    
+    /**
+     Labels the connected components of the walkable tiles, with a two pass union-find scan of the layer.
+     @param walkable The walkable layer
+     @param width The width of the layer
+     @param height The height of the layer
+     @param dir Whether diagonal tiles are connected
+     @param components Set to the number of components found
+     @return A dense vector holding the component of every tile, from 1 to components. Non walkable tiles hold kNoComponent
+     */
+    static std::vector<std::uint32_t> LabelComponents(std::vector<std::uint8_t> const &walkable,
+                                                      std::size_t width,
+                                                      std::size_t height,
+                                                      MoveDirections const &dir,
+                                                      std::size_t &components);
+    
+    /**
+     Repairs the components of a layer after some of its tiles changed, relabelling only the components they touch.
+     Tiles becoming walkable join the components around them, relabelling all but the first one. Tiles becoming
+     unwalkable may split their component, so the parts around them are flooded again, and all but the first one get
+     new labels. Labels stay unique, but are no longer contiguous nor sorted by their first tile.
+     @param walkable The walkable layer, already holding the changes
+     @param width The width of the layer
+     @param height The height of the layer
+     @param dir Whether diagonal tiles are connected
+     @param changed The row major indices of the changed tiles
+     @param labels The labels returned by LabelComponents, repaired in place
+     @param components The highest label in use, updated when new labels are needed
+     */
+    static void RepairComponents(std::vector<std::uint8_t> const &walkable,
+                                 std::size_t width,
+                                 std::size_t height,
+                                 MoveDirections const &dir,
+                                 std::vector<std::size_t> const &changed,
+                                 std::vector<std::uint32_t> &labels,
+                                 std::size_t &components);
+
+    /**
+     Computes the distance of every walkable tile from the closest source, with a single multi-source BFS.
+     @param walkable The walkable layer
+     @param width The width of the layer
+     @param height The height of the layer
+     @param sources The row major indices of the sources
+     @param dir Whether diagonal moves are allowed. Diagonal moves cost 1, like cardinal ones
+     @return A dense vector holding the number of steps from the closest source, or kUnreachableDistance
+     */
+    static std::vector<std::uint32_t> DistanceField(std::vector<std::uint8_t> const &walkable,
+                                                    std::size_t width,
+                                                    std::size_t height,
+                                                    std::vector<std::size_t> const &sources,
+                                                    MoveDirections const &dir);
+};
+
+}
+
+#endif /* LIBPMG_CONNECTIVITY_HPP_ */
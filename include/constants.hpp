@@ -8,11 +8,18 @@
 #ifndef LIBPMG_CONSTANTS_HPP_
 #define LIBPMG_CONSTANTS_HPP_
 
+#include <cstddef>
+
 namespace libpmg {
 
+static const char kLibraryVersion[]                 {"0.3.2"};
+static const unsigned kRndStreamVersion             {3};
+
 static const int kDefaultSeed                       {666};
 static const float kDefaultEmptyTileCost            {0.0f};
 static const float kDefaultWallTileCost             {666.0f};
+static const float kDefaultSlopeCost                {100.0f};
+static const float kDiagonalStepCost                {1.41421356f};
 
 static const char kDefaultEmptyChar                 {'.'};
 static const char kDefaultWallChar                  {'#'};
@@ -25,6 +32,10 @@ static const float kDefaultWallDrawPriority         {0.6f};
 static const float kDefaultDoorDrawPriority         {0.7f};
 static const float kDefaultStairDrawPriority        {0.8f};
 
+static const std::size_t kDefaultPoissonAttempts    {30};
+static const std::size_t kMaxDirtyRegions           {1024};
+static const std::size_t kRoomGridCellSize          {16};
+
 }
 
 #endif /* LIBPMG_CONSTANTS_HPP_ */
@@ -0,0 +1,164 @@
+/**
+ @file dijkstra_map.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_DIJKSTRA_MAP_HPP_
+#define LIBPMG_DIJKSTRA_MAP_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "connectivity.hpp"
+#include "map.hpp"
+
+namespace libpmg {
+
+/**
+ A class holding the distance of every tile of a map from the closest of many sources, also known as a Dijkstra map.
+ Any number of agents can chase the sources by stepping down the field, reading a handful of tiles per move, instead
+ of searching a path each.
+ Tiles have a small integer cost of entry, from 1 to 255, or 0 if they cannot be walked. Diagonal moves cost like
+ cardinal ones. Fields are computed with a bucket queue, one bucket per distance, in time linear in the number of
+ tiles. When a few sources move or a few costs change, only the tiles whose distance depended on them are computed
+ again: they are cleared, as long as no neighbour still supports their distance, and filled again from their border.
+ */
+class DijkstraMap {
+public:
+    /**
+     Builds the field of a map, where the walls cannot be walked and every other tile costs 1.
+     @param map The map
+     @param dir Whether diagonal moves are allowed
+     */
+    DijkstraMap(Map &map, MoveDirections const &dir);
+
+    /**
+     Builds the field of a cost layer.
+     @param costs The row major cost of entering every tile, or 0 if it cannot be walked
+     @param width The width of the layer
+     @param height The height of the layer
+     @param dir Whether diagonal moves are allowed
+     */
+    DijkstraMap(std::vector<std::uint8_t> costs, std::size_t width, std::size_t height, MoveDirections const &dir);
+
+    /**
+     Replaces every source. The field is computed again from scratch by the next call to Update.
+     @param sources The row major indices of the sources
+     */
+    void SetSources(std::vector<std::size_t> const &sources);
+
+    /**
+     Adds a source. Sources out of the layer, on tiles that cannot be walked, or already added are skipped.
+     @param source The row major index of the source
+     */
+    void AddSource(std::size_t source);
+
+    /**
+     Removes a source.
+     @param source The row major index of the source
+     */
+    void RemoveSource(std::size_t source);
+
+    /**
+     Moves a source, for example when the player takes a step.
+     @param from The row major index of the source
+     @param to The row major index to move the source to
+     */
+    void MoveSource(std::size_t from, std::size_t to);
+
+    /**
+     Changes the cost of entering a tile. The field is repaired by the next call to Update.
+     A source on a tile that can no longer be walked is removed.
+     @param index The row major index of the tile
+     @param cost The cost, from 1 to 255, or 0 if the tile cannot be walked
+     */
+    void SetCost(std::size_t index, std::uint8_t cost);
+
+    /**
+     Reads the areas of a map edited since the field was built, or since the last sync, and updates the costs of
+     their tiles. Only fields built from a map can be synced. The field is repaired by the next call to Update.
+     @param map The map the field was built from
+     */
+    void Sync(Map &map);
+
+    /**
+     Applies the changes to the sources and costs made since the last update.
+     Replacing every source computes the whole field.
+     */
+    void Update();
+
+    /**
+     Updates many fields at once, split across threads, for example one for every faction.
+     @param maps The fields to update
+     @param threads The number of threads to use, or 0 to use one for every core
+     */
+    static void UpdateAll(std::vector<DijkstraMap*> const &maps, std::size_t threads = 0);
+
+    /**
+     Gets the tile an agent should step to, the neighbour closest to a source.
+     @param index The row major index of the agent
+     @return The index of the neighbour, or index itself if no neighbour is closer to a source
+     */
+    std::size_t GetNextStep(std::size_t index) const;
+
+    /**
+     Computes the next step of every tile, split across threads by rows, so that agents move by reading a single
+     tile.
+     @param threads The number of threads to use, or 0 to use one for every core
+     @return A dense vector holding the next step of every tile, like GetNextStep
+     */
+    std::vector<std::uint32_t> ComputeFlowField(std::size_t threads = 0) const;
+
+    inline std::uint32_t GetDistance(std::size_t index) const { return distances_[index]; }
+    inline std::vector<std::uint32_t> const &GetDistances() const { return distances_; }
+    inline std::vector<std::size_t> const &GetSources() const { return sources_; }
+    inline std::size_t GetWidth() const { return width_; }
+    inline std::size_t GetHeight() const { return height_; }
+
+private:
+    std::vector<std::uint8_t> costs_;           /**< The cost of entering every tile */
+    std::size_t width_;                         /**< The width of the layer */
+    std::size_t height_;                        /**< The height of the layer */
+    MoveDirections dir_;                        /**< Whether diagonal moves are allowed */
+    std::uint8_t max_cost_;                     /**< The highest cost of the layer */
+
+    std::vector<std::uint32_t> distances_;      /**< The distance of every tile from the closest source */
+    std::vector<std::size_t> sources_;          /**< The sources */
+
+    bool from_map_;                             /**< Whether the costs are made of the walls of a map */
+    std::uint64_t revision_;                    /**< The revision of the map the costs are up to date with */
+
+    bool full_update_;                          /**< Whether the next update computes the whole field */
+    std::vector<std::size_t> added_;            /**< The sources added since the last update */
+    std::vector<std::size_t> removed_;          /**< The sources removed since the last update */
+    std::vector<std::pair<std::uint32_t, std::uint8_t>> changed_;  /**< The tiles whose cost changed since the last update, with their old cost */
+
+    /**
+     Fills the costs with the walls of a map.
+     @param map The map
+     */
+    void ReadCosts(Map &map);
+
+    /**
+     Checks whether a neighbour of a tile still accounts for its distance.
+     @param index The row major index of the tile
+     @return True if a neighbour is one move away, false otherwise
+     */
+    bool IsSupported(std::uint32_t index) const;
+
+    /**
+     Clears a list of tiles, and every tile left without a neighbour accounting for its distance.
+     @param cleared The tiles to clear, receiving every cleared tile
+     */
+    void Invalidate(std::vector<std::uint32_t> &cleared);
+
+    /**
+     Spreads the distances from a list of tiles, lowering the distance of the tiles they can reach.
+     @param seeds The tiles to start from, already holding their distance
+     */
+    void Propagate(std::vector<std::uint32_t> &seeds);
+};
+
+}
+
+#endif /* LIBPMG_DIJKSTRA_MAP_HPP_ */
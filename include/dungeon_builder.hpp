@@ -7,21 +7,44 @@
 #define LIBPMG_DUNGEON_BUILDER_HPP_
 
 #include <memory>
+#include <memory_resource>
 
+#include "connectivity.hpp"
 #include "dungeon_map.hpp"
 #include "map_builder.hpp"
 #include "room.hpp"
+#include "utils.hpp"
 
 namespace libpmg {
    
 /**
- Define 4 different types of path finding algorithm.
+ Define 5 different types of path finding algorithm.
  */
 enum struct PathAlgorithm {
     BREADTH_FIRST_SEARCH,
     DIJKSTRA,
     ASTAR,
-    ASTAR_BFS_MIX
+    ASTAR_BFS_MIX,
+    BIDIRECTIONAL_BREADTH_FIRST_SEARCH
+};
+
+/**
+ Struct that holds the results of the connectivity validation of a dungeon map.
+ */
+struct ConnectivityReport {
+    std::vector<std::uint32_t> components_;                                 /**< The walkable component of every tile. See Connectivity::LabelComponents */
+    std::size_t component_count_;                                           /**< The number of walkable components */
+    std::uint32_t main_component_;                                          /**< The component holding the first upstairs, or the largest one if there are no upstairs */
+    std::vector<std::size_t> unreachable_rooms_;                            /**< The indices of the rooms outside of the main component */
+    std::vector<std::pair<std::size_t, std::size_t>> unreachable_stairs_;   /**< The coordinates of the stairs outside of the main component */
+    std::vector<std::pair<std::size_t, std::size_t>> unreachable_doors_;    /**< The coordinates of the doors outside of the main component */
+    std::vector<std::uint32_t> upstairs_distances_;                         /**< The steps from the closest upstairs for every tile, or kUnreachableDistance */
+    
+    /**
+     Checks whether every room, stair and door is reachable.
+     @return True if nothing is unreachable, false otherwise
+     */
+    inline bool IsConnected() const { return unreachable_rooms_.empty() && unreachable_stairs_.empty() && unreachable_doors_.empty(); }
 };
 
 /**
@@ -55,6 +78,7 @@ public:
     /**
      Generate doors in every elegible tile.
      Tiles are elegible for doors only if they are adjacent of 2 wall tiles and 2 empty tiles, both opposed to each other.
+     Candidates are found with a single scan of the map neighbour masks, regardless of how many rooms there are.
      */
     void GenerateDoors();
     
@@ -68,6 +92,24 @@ public:
      */
     void GenerateGroundStairs();
     
+    /**
+     Check that every room, stair and door of the map is reachable, labelling the walkable components in a single scan.
+     It also computes the distance of every tile from the upstairs, with a single multi-source BFS.
+     @param auto_connect If true, a corridor is dug from every unreachable component to a reachable room
+     @return The report of the validation. If auto_connect is true, it reflects the map after digging the corridors
+     */
+    ConnectivityReport ValidateConnectivity(bool auto_connect = false);
+    
+    /**
+     Dig a 3x3 landing room centered on the specified coordinates, and place a stair tile in its center.
+     The landing room is added to the room list, so corridors will connect it. It should be placed before
+     generating the other rooms, so that they will not collide with it.
+     @param x The X coordinate of the stair. It must be at least 2 tiles away from the map border
+     @param y The Y coordinate of the stair. It must be at least 2 tiles away from the map border
+     @param is_upstairs If set to true, the stair will be upstairs. It will be downstairs otherwise.
+     */
+    void PlaceLandingStairs(std::size_t x, std::size_t y, bool is_upstairs);
+    
     /**
      Place a single room in a map without checking for collisions.
      @param room Pointer to the room to place
@@ -107,6 +149,13 @@ public:
      */
     void SetDiagonalCorridors(bool allow);
     
+    /**
+     Set the most tiles a corridor search may expand. Searches giving up dig a straight L shaped corridor instead.
+     Only the BIDIRECTIONAL_BREADTH_FIRST_SEARCH algorithm is bounded.
+     @param expansions The most tiles to expand, or 0 for no limit
+     */
+    void SetCorridorSearchLimit(std::size_t expansions);
+    
     /**
      Set the size of the map.
      @param width Map width
@@ -156,12 +205,27 @@ public:
      */
     void SetDigStairsOnlyInRooms(bool allow);
     
+    /**
+     Set the resource the scratch structures of every phase are allocated from, like search frontiers and candidate
+     lists. Nothing allocated from it outlives a phase, so a ScratchArena can be released after every build, and
+     reused by the same thread for the next one. A ScratchArena is also rewound after every corridor search and phase,
+     so that it only grows to the largest of them. The resource is not owned, and must outlive its use.
+     @param resource The resource, or nullptr to restore the default one
+     */
+    void SetScratchResource(std::pmr::memory_resource *resource);
+    
     /**
      Build the map and returns a pointer.
      @return A pointer to the built map.
      */
     std::unique_ptr<Map> &Build() override;
     
+    /**
+     Gets the configs set so far. They can be read before initializing the map, for example to compute a MapCache key.
+     @return A reference to the configs
+     */
+    inline DungeonMapConfigs const &GetConfigs() { return (DungeonMapConfigs&)map_->GetConfigs(); }
+    
     /**
      Build the map and returns a pointer.
      @return A pointer to the built map.
@@ -172,6 +236,9 @@ private:
     std::unique_ptr<Map> map_;       /**< The map. */
     PathAlgorithm default_path_algorithm_;  /**< The default path finder algorithm used for generating corridors. */
     bool allow_diagonal_corridors_;         /**< Should the builder generate diagonal corridors? */
+    std::size_t corridor_search_limit_;     /**< The most tiles a corridor search may expand, or 0 */
+    std::pmr::memory_resource *scratch_resource_;   /**< The resource scratch structures are allocated from */
+    SearchContext search_context_;                  /**< The tiles explored by the corridor searches, reused by every search */
     
     /**
      Connect 2 rooms with a corridor using path finding defined rules to avoid collisions.
@@ -180,6 +247,19 @@ private:
      */
     void ConnectRooms(Room const &room1, Room const &room2);
     
+    /**
+     Connect 2 locations with a corridor using path finding defined rules to avoid collisions.
+     @param start The first location
+     @param end The second location
+     */
+    void ConnectLocations(Location *start, Location *end);
+    
+    /**
+     Label the walkable components of the map, and look for unreachable rooms, stairs and doors.
+     @return The connectivity report of the map
+     */
+    ConnectivityReport AnalyzeConnectivity();
+    
     /**
      Add the specified tag to all the tiles in the specified Rect.
      @param rect The rect
@@ -217,13 +297,6 @@ private:
                     std::initializer_list<std::shared_ptr<Tag>> to_insert,
                     std::initializer_list<std::shared_ptr<Tag>> to_remove);
     
-    /**
-     Place a door if the tile is eligible.
-     In order be eligible for a door a tile must be adjacent to no more then two wall tiles, and they must be opposite to eachother.x
-     @param tile A pointer to the tile that will host the door
-     */
-    void PlaceDoor(Tile *tile);
-    
     /**
      Place a stair tile, if eligible.
      In order to be eligible for stairs, a tile must have at least 3 adjacent tiles (in four cardinal directions)
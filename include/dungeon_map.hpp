@@ -6,10 +6,18 @@
 #ifndef LIBPMG_DUNGEON_MAP_HPP_
 #define LIBPMG_DUNGEON_MAP_HPP_
 
+#include <functional>
+#include <limits>
+
 #include "map.hpp"
 #include "room.hpp"
+#include "room_graph.hpp"
 
 namespace libpmg {
+
+static const std::uint32_t kNoRegion        {0};
+static const std::uint32_t kCorridorRegion  {1u << 31};
+static const std::uint32_t kNoCorridor      {std::numeric_limits<std::uint32_t>::max()};
     
 /**
  Struct that holds the DungeonMap configuration values
@@ -32,6 +40,16 @@ struct DungeonMapConfigs : public MapConfigs {
     bool dig_space_around_stairs;
 };
 
+/**
+ Struct that defines a feature, like a chest or a trap, that can be scattered across a DungeonMap.
+ */
+struct Feature {
+    std::shared_ptr<Tag> tag_;                          /**< The tag added to every tile hosting the feature */
+    std::function<bool(std::uint8_t)> predicate_;       /**< Called with the 8-neighbour wall mask of a walkable tile, see NeighborMask. If empty, every walkable tile is eligible */
+    float min_spacing_;                                 /**< The minimum euclidean distance between two features of this kind */
+    std::size_t max_features_;                          /**< The maximum number of features of this kind */
+};
+
 /**
  Class that holds and manages all tile informations for a dungeon map.
  */
@@ -71,10 +89,106 @@ public:
      */
     constexpr std::vector<std::unique_ptr<Room>> &GetRoomList() { return room_list_; }
     
+    /**
+     Adds a room to the map, labelling its tiles in the region layer and indexing it in the room grid.
+     Tiles already held by another room keep their label.
+     @param room The room
+     */
+    void AddRoom(std::unique_ptr<Room> room);
+
+    /**
+     Adds a corridor to the map, labelling its tiles in the region layer.
+     Tiles already held by a room or by another corridor keep their label.
+     @param tiles The row major indices of the tiles of the corridor
+     @return The number of the corridor
+     */
+    std::uint32_t AddCorridor(std::vector<std::size_t> const &tiles);
+
+    /**
+     Gets the room holding a tile, in constant time.
+     @param x The X coordinate
+     @param y The Y coordinate
+     @return The index of the room in the room list, or kNoRoom
+     */
+    inline std::uint32_t GetRoomAt(std::size_t x, std::size_t y) const {
+        auto region {GetRegionAt(x, y)};
+        return region != kNoRegion && !(region & kCorridorRegion) ? region - 1 : kNoRoom;
+    }
+
+    /**
+     Gets the corridor holding a tile, in constant time.
+     @param x The X coordinate
+     @param y The Y coordinate
+     @return The number of the corridor, or kNoCorridor
+     */
+    inline std::uint32_t GetCorridorAt(std::size_t x, std::size_t y) const {
+        auto region {GetRegionAt(x, y)};
+        return region & kCorridorRegion ? (region & ~kCorridorRegion) - 1 : kNoCorridor;
+    }
+
+    /**
+     Gets the rooms intersecting an area, looking up the cells of the room grid it covers.
+     @param rect The area, for example a viewport
+     @return The indices of the rooms, sorted
+     */
+    std::vector<std::uint32_t> GetRoomsInRect(Rect const &rect) const;
+
+    /**
+     Gets the region layer, a dense row major layer holding kNoRegion, the index of the room plus 1, or the number of
+     the corridor plus 1 flagged with kCorridorRegion, for every tile. It is empty until a room or corridor is added.
+     @return A reference to the layer
+     */
+    inline std::vector<std::uint32_t> const &GetRegionLayer() const { return region_layer_; }
+
+    inline std::size_t GetCorridorCount() const { return corridors_; }
+
+    /**
+     Gets the graph of the routes between the rooms, built at the first call, and built again after the map or its
+     rooms change, or with other move directions. It must not be called while the map is being edited elsewhere.
+     @param dir Whether diagonal moves are allowed
+     @return A reference to the graph
+     */
+    RoomGraph const &GetRoomGraph(MoveDirections const &dir = MoveDirections::FOUR_DIRECTIONAL);
+
+    /**
+     Registers a feature, to be placed by PlaceFeatures().
+     @param feature The feature to register
+     */
+    inline void RegisterFeature(Feature const &feature) { feature_list_.push_back(feature); }
+    
+    /**
+     Scatters every registered feature across the walkable tiles of the map, using Poisson-disk sampling.
+     Features are placed in registration order, and a tile can host a single feature. Doors and stairs never host one.
+     @return The number of tiles tagged for every registered feature
+     */
+    std::vector<std::size_t> PlaceFeatures();
+    
 protected:
     std::unique_ptr<std::vector<std::unique_ptr<Tile>>> map_;        /**< All the tiles for this current map */
     std::unique_ptr<DungeonMapConfigs> configs_;    /**< Pointer to the DungeonMapConfigs used to generate this map */
     std::vector<std::unique_ptr<Room>> room_list_;                   /**< A list holding all informations of original generated rooms */
+    std::vector<Feature> feature_list_;                              /**< The features registered for placement */
+    std::vector<std::uint32_t> region_layer_;                        /**< The room or corridor of every tile */
+    std::vector<std::vector<std::uint32_t>> room_grid_;              /**< The rooms intersecting every cell of kRoomGridCellSize tiles */
+    std::size_t corridors_ {0};                                      /**< The number of corridors added */
+    std::unique_ptr<RoomGraph> room_graph_;                          /**< The graph of the routes between the rooms, if built */
+    std::uint64_t room_graph_revision_ {0};                          /**< The revision of the map the graph was built at */
+
+    /**
+     Sizes the region layer and the room grid to the map, if still empty.
+     */
+    void InitRegions();
+
+    /**
+     Gets the region of a tile.
+     @param x The X coordinate
+     @param y The Y coordinate
+     @return The region, or kNoRegion if out of the map
+     */
+    inline std::uint32_t GetRegionAt(std::size_t x, std::size_t y) const {
+        auto width {configs_->map_width_};
+        return x < width && y * width + x < region_layer_.size() ? region_layer_[y * width + x] : kNoRegion;
+    }
     
 };
     
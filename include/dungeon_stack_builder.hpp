@@ -0,0 +1,103 @@
+/**
+ @file dungeon_stack_builder.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_DUNGEON_STACK_BUILDER_HPP_
+#define LIBPMG_DUNGEON_STACK_BUILDER_HPP_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "dungeon_builder.hpp"
+#include "rnd_manager.hpp"
+
+namespace libpmg {
+
+/**
+ A class that generates a stack of dungeon levels, connected by aligned stairs.
+ The downstairs of every level lie on the same coordinates as the upstairs of the next one. Stair coordinates and
+ level seeds are derived from the stack seed alone, so levels do not depend on each other: they are generated in
+ parallel, and any single level can be rebuilt on its own.
+ */
+class DungeonStackBuilder {
+public:
+    DungeonStackBuilder();
+    
+    /**
+     Set the number of levels in the stack.
+     @param levels The number of levels
+     */
+    void SetLevels(std::size_t levels);
+    
+    /**
+     Set the size shared by every level of the stack.
+     @param width Map width
+     @param height Map height
+     */
+    void SetMapSize(std::size_t width, std::size_t height);
+    
+    /**
+     Set the seed every level seed and stair coordinate are derived from.
+     @param seed The stack seed
+     */
+    void SetSeed(int seed);
+    
+    /**
+     Set the number of threads used to generate the levels.
+     @param threads The number of threads. If 0, the hardware concurrency will be used
+     */
+    void SetThreads(std::size_t threads);
+    
+    /**
+     Set a function that configures the builder of every level, before its map is initialized.
+     It can call any DungeonBuilder setter, except SetMapSize. It may be called by multiple threads at once.
+     @param setup The function, called with the builder and the level number
+     */
+    void SetLevelSetup(std::function<void(DungeonBuilder&, std::size_t)> setup);
+    
+    /**
+     Gets the coordinates of the stairs linking a level to the next one.
+     Below the first level, the downstairs are drawn at least 4 tiles away from the upstairs, so maps
+     must be at least 12 tiles wide or tall.
+     @param level The upper level of the link
+     @return A pair containing the coordinates of the downstairs of level, and of the upstairs of level + 1
+     */
+    std::pair<std::size_t, std::size_t> GetStairsCoords(std::size_t level) const;
+    
+    /**
+     Gets the seed used to generate a level.
+     @param level The level
+     @return The seed of the level
+     */
+    inline int GetLevelSeed(std::size_t level) const { return RndManager::DeriveSeed(seed_, 2 * level); }
+    
+    /**
+     Build a single level of the stack.
+     The RndManager of the calling thread will be reseeded with the level seed.
+     @param level The level to build
+     @return A pointer to the built map
+     */
+    std::unique_ptr<Map> BuildLevel(std::size_t level);
+    
+    /**
+     Build every level of the stack.
+     The calling thread builds levels as well: its seed is restored afterwards, and its RndManager reset to it.
+     @return A reference to the list of built maps, sorted by level
+     */
+    std::vector<std::unique_ptr<Map>> &Build();
+    
+private:
+    std::size_t levels_;                /**< The number of levels in the stack */
+    std::size_t map_width_;             /**< The width of every level */
+    std::size_t map_height_;            /**< The height of every level */
+    int seed_;                          /**< The stack seed */
+    std::size_t threads_;               /**< The number of threads used by Build */
+    std::function<void(DungeonBuilder&, std::size_t)> level_setup_;    /**< The function configuring every level builder */
+    std::vector<std::unique_ptr<Map>> level_list_;                      /**< The levels built by Build */
+};
+
+}
+
+#endif /* LIBPMG_DUNGEON_STACK_BUILDER_HPP_ */
@@ -0,0 +1,185 @@
+/**
+ @file field_of_view.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_FIELD_OF_VIEW_HPP_
+#define LIBPMG_FIELD_OF_VIEW_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "map.hpp"
+
+namespace libpmg {
+
+/**
+ A dense set of tiles, holding a bit for every tile of a map, row major, 64 tiles per word.
+ Sets of the same size can be merged a word at a time, for example to accumulate the visible tiles into an
+ explored layer.
+ */
+class TileBitset {
+public:
+    TileBitset() : width_ {0}, height_ {0} {}
+    TileBitset(std::size_t width, std::size_t height) : width_ {width}, height_ {height}, words_((width * height + 63) / 64, 0) {}
+
+    inline bool Get(std::size_t x, std::size_t y) const { return GetIndex(y * width_ + x); }
+    inline bool GetIndex(std::size_t index) const { return words_[index >> 6] >> (index & 63) & 1; }
+    inline void Set(std::size_t x, std::size_t y) { SetIndex(y * width_ + x); }
+    inline void SetIndex(std::size_t index) { words_[index >> 6] |= std::uint64_t {1} << (index & 63); }
+    inline void Reset(std::size_t x, std::size_t y) { words_[(y * width_ + x) >> 6] &= ~(std::uint64_t {1} << ((y * width_ + x) & 63)); }
+
+    /**
+     Removes every tile from the set.
+     */
+    void Clear();
+
+    /**
+     Counts the tiles in the set.
+     @return The number of tiles
+     */
+    std::size_t Count() const;
+
+    /**
+     Adds every tile of another set of the same size.
+     @param other The other set
+     @return A reference to this set
+     */
+    TileBitset &operator|=(TileBitset const &other);
+
+    inline std::size_t GetWidth() const { return width_; }
+    inline std::size_t GetHeight() const { return height_; }
+    inline std::vector<std::uint64_t> &GetWords() { return words_; }
+    inline std::vector<std::uint64_t> const &GetWords() const { return words_; }
+
+private:
+    std::size_t width_;
+    std::size_t height_;
+    std::vector<std::uint64_t> words_;
+};
+
+/**
+ A class that computes fields of view and lines of sight over a bit packed opacity layer.
+ The layer is built once from the tags of a map, and then queried without touching the tiles. Fields of view use
+ recursive shadowcasting, visiting every visible tile once. Opaque tiles in range are visible, like the walls of
+ a room. Queries are const, so any number of threads can run them at once on the same instance.
+ */
+class FieldOfView {
+public:
+    /**
+     Builds the opacity layer of a map, where the walls are opaque.
+     @param map The map
+     */
+    FieldOfView(Map &map);
+
+    /**
+     Builds the opacity layer of a map.
+     @param map The map
+     @param opaque_tags The tags that block the sight, up to 32
+     */
+    FieldOfView(Map &map, std::vector<std::shared_ptr<Tag>> const &opaque_tags);
+
+    /**
+     Uses an existing opacity layer.
+     @param opacity A set holding the opaque tiles
+     */
+    FieldOfView(TileBitset opacity);
+
+    /**
+     Updates the opacity of a tile, for example when a door is opened.
+     It must not be called while queries are running.
+     @param x The X coordinate
+     @param y The Y coordinate
+     @param opaque Whether the tile blocks the sight
+     */
+    void SetOpaque(std::size_t x, std::size_t y, bool opaque);
+
+    /**
+     Reads the areas of a map edited since the layer was built, or since the last sync, and updates the opacity of
+     their tiles. Only layers built from a map can be synced. It must not be called while queries are running.
+     @param map The map the layer was built from
+     */
+    void Sync(Map &map);
+
+    /**
+     Checks whether a tile blocks the sight. Tiles out of the map are opaque.
+     @param x The X coordinate
+     @param y The Y coordinate
+     @return True if the tile is opaque, false otherwise
+     */
+    inline bool IsOpaque(std::size_t x, std::size_t y) const {
+        return x >= opacity_.GetWidth() || y >= opacity_.GetHeight() || opacity_.Get(x, y);
+    }
+
+    /**
+     Computes the tiles visible from a tile, adding them to a set. The tiles already in the set are kept.
+     @param x The X coordinate of the observer
+     @param y The Y coordinate of the observer
+     @param radius The sight radius, or 0 for no limit
+     @param visible The set receiving the visible tiles, as big as the map
+     */
+    void Compute(std::size_t x, std::size_t y, std::size_t radius, TileBitset &visible) const;
+
+    /**
+     Computes the tiles visible from many observers at once, split across threads.
+     @param observers The coordinates of the observers
+     @param radius The sight radius, or 0 for no limit
+     @param threads The number of threads to use, or 0 to use one for every core
+     @return The set of the visible tiles of every observer, in the same order
+     */
+    std::vector<TileBitset> Compute(std::vector<std::pair<std::size_t, std::size_t>> const &observers,
+                                    std::size_t radius,
+                                    std::size_t threads = 0) const;
+
+    /**
+     Computes the tiles visible from any of many observers, split across threads, adding them to a set.
+     @param observers The coordinates of the observers
+     @param radius The sight radius, or 0 for no limit
+     @param visible The set receiving the visible tiles, as big as the map
+     @param threads The number of threads to use, or 0 to use one for every core
+     */
+    void ComputeUnion(std::vector<std::pair<std::size_t, std::size_t>> const &observers,
+                      std::size_t radius,
+                      TileBitset &visible,
+                      std::size_t threads = 0) const;
+
+    /**
+     Checks whether the straight line between two tiles is free, walking it with Bresenham's algorithm.
+     The end tiles themselves may be opaque. The result is symmetric, but may disagree with Compute on the edges
+     of the shadows.
+     @return True if no tile between the two blocks the sight, false otherwise
+     */
+    bool HasLineOfSight(std::size_t x1, std::size_t y1, std::size_t x2, std::size_t y2) const;
+
+    /**
+     Adds the explored tag to every tile of a map in a set, skipping the tiles that already hold it.
+     @param map The map
+     @param visible The set of tiles, as big as the map
+     */
+    static void MarkExplored(Map &map, TileBitset const &visible);
+
+    inline TileBitset const &GetOpacity() const { return opacity_; }
+
+private:
+    TileBitset opacity_;                                /**< The opaque tiles */
+    std::vector<std::shared_ptr<Tag>> opaque_tags_;     /**< The tags that block the sight, if built from a map */
+    std::uint64_t revision_;                            /**< The revision of the map the layer is up to date with */
+
+    /**
+     Fills the opacity layer with the opaque tags of a map.
+     @param map The map
+     */
+    void ReadOpacity(Map &map);
+
+    /**
+     Scans the rows of an octant, recursing on every gap between opaque tiles.
+     */
+    void CastLight(long x, long y, long row, float start, float end, long radius,
+                   long xx, long xy, long yx, long yy, TileBitset &visible) const;
+};
+
+}
+
+#endif /* LIBPMG_FIELD_OF_VIEW_HPP_ */
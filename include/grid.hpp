@@ -38,11 +38,6 @@ public:
      Resets all the costs calculated by the path finding algorithm.
      */
     virtual void ResetLocationCosts() = 0;
-    
-    /**
-     Resets all the flags added by the path finding algorithm.
-     */
-    virtual void ResetPathFlags() = 0;
 
 };
 
@@ -0,0 +1,43 @@
+/**
+ @file hasher.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_HASHER_HPP_
+#define LIBPMG_HASHER_HPP_
+
+#include <cstdint>
+#include <string>
+
+namespace libpmg {
+
+/**
+ A class that computes 64 bit FNV-1a hashes over a sequence of values.
+ Values are hashed through their in memory representation, so hashes of multi byte values depend on the byte order.
+ */
+class Hasher {
+public:
+    Hasher() : hash_ {0xcbf29ce484222325} {}
+
+    inline void Add(void const *data, std::size_t size) {
+        auto bytes {static_cast<std::uint8_t const*>(data)};
+
+        for (std::size_t i {0}; i < size; i++) {
+            hash_ ^= bytes[i];
+            hash_ *= 0x100000001b3;
+        }
+    }
+
+    inline void Add(std::uint64_t value) { Add(&value, sizeof(value)); }
+    inline void Add(float value) { Add(&value, sizeof(value)); }
+    inline void Add(std::string const &value) { Add(value.size()); Add(value.data(), value.size()); }
+
+    inline std::uint64_t GetHash() const { return hash_; }
+
+private:
+    std::uint64_t hash_;
+};
+
+}
+
+#endif /* LIBPMG_HASHER_HPP_ */
@@ -0,0 +1,63 @@
+/**
+ @file index_sampler.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_INDEX_SAMPLER_HPP_
+#define LIBPMG_INDEX_SAMPLER_HPP_
+
+#include <cstddef>
+#include <memory_resource>
+#include <unordered_map>
+
+namespace libpmg {
+
+/**
+ Draws distinct indices in [0, size) in random order, using a lazy partial Fisher–Yates shuffle.
+ Only the swapped slots are stored, so every draw costs O(1) regardless of the range size, and drawing k indices
+ consumes exactly k values from the RndManager.
+ */
+class IndexSampler {
+public:
+    /**
+     Initializes the sampler.
+     @param size The size of the range
+     @param resource The resource the swapped slots are allocated from
+     */
+    IndexSampler(std::size_t size, std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+    
+    /**
+     Draws the next random index.
+     It must not be called when the sampler is empty.
+     @return An index that has never been drawn before
+     */
+    std::size_t Draw();
+    
+    /**
+     Checks whether every index has been drawn.
+     @return True if there are no more indices to draw, false otherwise
+     */
+    inline bool empty() const { return drawn_ == size_; }
+    
+    /**
+     Gets the number of indices that can still be drawn.
+     @return The number of indices left
+     */
+    inline std::size_t size() const { return size_ - drawn_; }
+    
+private:
+    std::size_t size_;                                          /**< The size of the range */
+    std::size_t drawn_;                                         /**< The number of indices drawn so far */
+    std::pmr::unordered_map<std::size_t, std::size_t> swapped_; /**< The slots moved by the shuffle. Slots not in here hold their own index */
+    
+    /**
+     Gets the index currently held by a slot.
+     @param slot The slot
+     @return The index held by the slot
+     */
+    std::size_t GetSlot(std::size_t slot) const;
+};
+
+}
+
+#endif /* LIBPMG_INDEX_SAMPLER_HPP_ */
@@ -6,9 +6,24 @@
 #ifndef LIBPMG_HPP_
 #define LIBPMG_HPP_
 
+#include "dijkstra_map.hpp"
 #include "dungeon_builder.hpp"
+#include "dungeon_stack_builder.hpp"
+#include "field_of_view.hpp"
+#include "log.hpp"
+#include "map_cache.hpp"
+#include "map_digest.hpp"
+#include "map_export.hpp"
+#include "map_file.hpp"
+#include "map_snapshot.hpp"
+#include "parallel.hpp"
+#include "path_service.hpp"
+#include "profiler.hpp"
 #include "world_builder.hpp"
 #include "rnd_manager.hpp"
+#include "room_graph.hpp"
+#include "search_queue.hpp"
+#include "terrain_cost.hpp"
 #include "utils.hpp"
 
 #endif /* LIBPMG_HPP_ */
@@ -19,7 +19,6 @@ public:
     Location(std::size_t x, std::size_t y);
     Location(std::pair<std::size_t, std::size_t> xy);
     
-    bool is_path_explored_;       /**< Whether the tile has been explored or not. Only used for by the path finder. */
     float path_cost_;             /**< The cost used by the path finding algorithm */
     
     inline std::size_t GetX() const { return coords_.first; }
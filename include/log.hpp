@@ -0,0 +1,189 @@
+/**
+ @file log.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_LOG_HPP_
+#define LIBPMG_LOG_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+/**
+ The minimum level compiled in, as an integer LogLevel value. Messages below it are removed at compile time.
+ Release builds set it to 1 for the library and every target linking it, compiling out every debug message.
+ */
+#ifndef LIBPMG_MIN_LOG_LEVEL
+#define LIBPMG_MIN_LOG_LEVEL 0
+#endif
+
+namespace libpmg {
+
+/**
+ Represent the severity of a log message.
+ */
+enum struct LogLevel : int {
+    DEBUG = 0,
+    INFO = 1,
+    WARNING = 2,
+    ERROR = 3,
+    NONE = 4
+};
+
+static constexpr LogLevel kMinLogLevel      {static_cast<LogLevel>(LIBPMG_MIN_LOG_LEVEL)};
+static const LogLevel kDefaultLogLevel      {LogLevel::INFO};
+static const std::size_t kLogContextSize    {32};
+static const std::size_t kLogMessageSize    {224};
+
+/**
+ A pure virtual class that receives the log messages.
+ Sinks are called concurrently by every thread that logs, so they must be thread safe.
+ */
+class LogSink {
+public:
+    virtual ~LogSink() {}
+
+    /**
+     Writes a message.
+     @param level The severity of the message
+     @param context A string indicating the context of the message
+     @param message The message
+     */
+    virtual void Write(LogLevel level, char const *context, std::string const &message) = 0;
+};
+
+/**
+ The default sink, printing every message to stdout.
+ */
+class StdoutLogSink : public LogSink {
+public:
+    void Write(LogLevel level, char const *context, std::string const &message) override;
+};
+
+/**
+ A sink that stores messages in a bounded, lock free ring, to be drained later by a single consumer.
+ Writers never block and never allocate: when the ring is full the message is dropped and counted, and messages
+ longer than the slots are truncated. Generation threads don't serialise on stdout, and a consumer thread, or the
+ caller after a batch, can drain the ring at its own pace.
+ */
+class RingLogSink : public LogSink {
+public:
+    /**
+     Initializes the ring.
+     @param capacity The number of slots, rounded up to a power of two
+     */
+    RingLogSink(std::size_t capacity);
+
+    void Write(LogLevel level, char const *context, std::string const &message) override;
+
+    /**
+     Removes every stored message, in the order they were written. It must be called by one thread at a time.
+     @param consumer The function receiving the messages
+     @return The number of messages drained
+     */
+    std::size_t Drain(std::function<void(LogLevel, char const*, char const*)> const &consumer);
+
+    /**
+     Gets the number of messages dropped because the ring was full.
+     @return The number of dropped messages
+     */
+    inline std::size_t GetDropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    /**
+     A slot of the ring. The sequence tells whether the slot is free for a writer or ready for the consumer.
+     */
+    struct Slot {
+        std::atomic<std::size_t> sequence_;
+        LogLevel level_;
+        char context_[kLogContextSize];
+        char message_[kLogMessageSize];
+    };
+
+    std::unique_ptr<Slot[]> slots_;             /**< The slots of the ring */
+    std::size_t mask_;                          /**< The number of slots, minus one */
+    std::atomic<std::size_t> write_position_;   /**< The next position to write to */
+    std::size_t read_position_;                 /**< The next position to drain */
+    std::atomic<std::size_t> dropped_;          /**< The number of dropped messages */
+};
+
+/**
+ A class that filters log messages by level, and forwards them to the current sink.
+ Messages below the compile time minimum are removed by the compiler, and the lazy overloads build their message
+ only if it is going to be written, so that disabled logging costs a single atomic load.
+ */
+class Log {
+public:
+    /**
+     Sets the minimum level of the messages written, for every thread.
+     Messages below LIBPMG_MIN_LOG_LEVEL are compiled out, and stay hidden whatever the level.
+     @param level The minimum level
+     */
+    static void SetLevel(LogLevel level);
+
+    /**
+     Gets the minimum level of the messages written.
+     @return The minimum level
+     */
+    static LogLevel GetLevel();
+
+    /**
+     Sets the sink receiving the messages, for every thread. The sink is not owned, and must outlive its use.
+     @param sink A pointer to the sink, or nullptr to restore the default StdoutLogSink
+     */
+    static void SetSink(LogSink *sink);
+
+    /**
+     Checks whether messages of a level are written.
+     @param level The level to check
+     @return True if messages of the level are written, false otherwise
+     */
+    static inline bool IsEnabled(LogLevel level) {
+        return level >= kMinLogLevel && static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     Writes a message, if its level is enabled.
+     @param level The severity of the message
+     @param context A string indicating the context of the message
+     @param message The message
+     */
+    static void Write(LogLevel level, char const *context, std::string const &message);
+
+    /**
+     Writes a debug message, built only if debug messages are enabled.
+     @param context A string indicating the context of the message
+     @param message A function returning the message
+     */
+    template <typename F>
+    static inline void Debug(char const *context, F const &message) {
+        if constexpr (LogLevel::DEBUG >= kMinLogLevel) {
+            if (IsEnabled(LogLevel::DEBUG))
+                Write(LogLevel::DEBUG, context, message());
+        }
+    }
+
+    /**
+     Writes an informative message, built only if info messages are enabled.
+     @param context A string indicating the context of the message
+     @param message A function returning the message
+     */
+    template <typename F>
+    static inline void Info(char const *context, F const &message) {
+        if constexpr (LogLevel::INFO >= kMinLogLevel) {
+            if (IsEnabled(LogLevel::INFO))
+                Write(LogLevel::INFO, context, message());
+        }
+    }
+
+private:
+    static std::atomic<int> level_;         /**< The minimum level written */
+    static std::atomic<LogSink*> sink_;     /**< The current sink, or nullptr for the default one */
+};
+
+}
+
+#endif /* LIBPMG_LOG_HPP_ */
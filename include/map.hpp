@@ -6,7 +6,13 @@
 #ifndef LIBPMG_MAP_HPP_
 #define LIBPMG_MAP_HPP_
 
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+
 #include "grid.hpp"
+#include "profiler.hpp"
+#include "rect.hpp"
 #include "tile.hpp"
 
 namespace libpmg {
@@ -28,7 +34,7 @@ public:
     virtual ~Map() = 0;
     
     /**
-     Prints debug informations and a ASCII sketch of the map.
+     Prints debug informations and a ASCII sketch of the map, as a LogLevel::INFO message.
      */
     void Print();
     
@@ -63,6 +69,83 @@ public:
      */
     std::vector<Tile*> GetNeighbors(Tile *location, MoveDirections const &dir = MoveDirections::FOUR_DIRECTIONAL);
 
+    /**
+     Gets the tiles adjacent to the selected location, in the same order of the other overloads, without allocating.
+     @param location The location to get the neighbors from
+     @param dir Whether getting only tiles adjacent on cardinal directions, or diagonal tiles
+     @param neighbors An array of at least 8 pointers, receiving the neighbor tiles
+     @return The number of neighbors
+     */
+    std::size_t GetNeighbors(Location const *location, MoveDirections const &dir, Tile **neighbors);
+
+    /**
+     Builds a dense, row major layer of the specified tags, in a single pass over the map.
+     Bit n of every value is set when the tile holds the n-th tag of the list.
+     @param tags The tags to pack into the layer, up to 32
+     @return A vector holding the packed tags of every tile
+     */
+    std::vector<std::uint32_t> GetTagLayer(std::vector<std::shared_ptr<Tag>> const &tags);
+
+    /**
+     Gets every distinct tag held by the tiles of the map, in order of first appearance.
+     Different instances of the same tag are listed once, since tags are compared by name.
+     @return The list of tags
+     */
+    std::vector<std::shared_ptr<Tag>> GetTagTable();
+
+    /**
+     Builds a dense, row major layer of every tag held by the map, in a single pass.
+     The tags are listed in order of first appearance, like GetTagTable. Tags after the 32nd are ignored.
+     @param tags The vector receiving the tags, in bit order
+     @return A vector holding the packed tags of every tile
+     */
+    std::vector<std::uint32_t> GetFullTagLayer(std::vector<std::shared_ptr<Tag>> &tags);
+
+    /**
+     Adds and removes tags on a tile at runtime, for example when a wall is dug or a door opened, recording the tile
+     as dirty.
+     @param x The X coordinate
+     @param y The Y coordinate
+     @param to_insert The tags to add
+     @param to_remove The tags to remove
+     */
+    void UpdateTileTags(std::size_t x,
+                        std::size_t y,
+                        std::initializer_list<std::shared_ptr<Tag>> to_insert,
+                        std::initializer_list<std::shared_ptr<Tag>> to_remove = {});
+
+    /**
+     Adds and removes tags on every tile of an area at runtime, recording the area as dirty.
+     @param rect The area, clipped to the map
+     @param to_insert The tags to add
+     @param to_remove The tags to remove
+     */
+    void UpdateRectTags(Rect const &rect,
+                        std::initializer_list<std::shared_ptr<Tag>> to_insert,
+                        std::initializer_list<std::shared_ptr<Tag>> to_remove = {});
+
+    /**
+     Records an area as dirty, after changing its tiles directly.
+     Every dirty area bumps the revision of the map, so that the structures built from it can update that area alone.
+     @param rect The area, clipped to the map
+     */
+    void MarkDirty(Rect const &rect);
+
+    /**
+     Gets the dirty areas recorded after a revision.
+     Only the last kMaxDirtyRegions areas are kept, so structures left behind must be built again.
+     @param revision The revision the caller is up to date with
+     @param regions The vector receiving the areas, oldest first
+     @return True if every area after the revision is still recorded, false otherwise
+     */
+    bool GetDirtyRegions(std::uint64_t revision, std::vector<Rect> &regions) const;
+
+    /**
+     Gets the revision of the map, bumped by every dirty area.
+     @return The revision
+     */
+    inline std::uint64_t GetRevision() const { return revision_; }
+
     /**
      Get the map size.
      @return A pair containing map width and height
@@ -73,11 +156,12 @@ public:
      Resets all the costs calculated by the path finding algorithm.
      */
     void ResetLocationCosts() override;
-    
+
     /**
-     Resets all the flags added by the path finding algorithm.
+     Resets the costs calculated by the path finding algorithm inside of an area.
+     @param rect The area, clipped to the map
      */
-    void ResetPathFlags() override;
+    void ResetLocationCosts(Rect const &rect);
     
     /**
      Gets the map.
@@ -90,9 +174,27 @@ public:
      @return A reference to the configuration MapConfigs for this map.
      */
     virtual MapConfigs &GetConfigs() = 0;
+
+    /**
+     Gets the phases recorded while building this map, if the Profiler is enabled.
+     @return A reference to the metrics of this map
+     */
+    inline GenerationMetrics &GetMetrics() { return metrics_; }
     
 protected:    
     std::string map_uuid_;      /**< A unique id for this particular instance. */
+    GenerationMetrics metrics_; /**< The phases recorded while building this map */
+
+    std::uint64_t revision_ {0};                                    /**< The revision, bumped by every dirty area */
+    std::uint64_t dropped_revision_ {0};                            /**< The last revision whose dirty area was dropped */
+    std::deque<std::pair<std::uint64_t, Rect>> dirty_regions_;      /**< The last dirty areas, with their revision */
+
+    /**
+     Clips an area to the map.
+     @param rect The area
+     @return The part of the area inside of the map
+     */
+    Rect ClipRect(Rect const &rect);
     
     /**
      Checks whether the specified coordinates are inside of the map.
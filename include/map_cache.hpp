@@ -0,0 +1,124 @@
+/**
+ @file map_cache.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_MAP_CACHE_HPP_
+#define LIBPMG_MAP_CACHE_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dungeon_map.hpp"
+#include "map_file.hpp"
+#include "world_map.hpp"
+
+namespace libpmg {
+
+/**
+ A class that caches generated maps and their derived artifacts in a local directory.
+ Maps are fully determined by the library version, their configs and the seed, so entries are addressed by a
+ hash of those values, and a miss is served by regenerating the map. A recipe string should be added to the key
+ whenever the generation steps, or the builder settings that are not part of the configs, change.
+ Artifacts are named vectors of values computed from a map, like Connectivity labels and distance fields. Maps and
+ artifacts are stored with a checksum that is verified on every lookup, so opening a cached map reads all of it once.
+ Entries are written to a temporary file and then renamed, so that concurrent processes never read a partial entry.
+ */
+class MapCache {
+public:
+    /**
+     Initializes the cache, creating the directory if needed.
+     @param directory The directory holding the entries
+     */
+    MapCache(std::string const &directory);
+
+    /**
+     Computes the key of a dungeon map.
+     @param configs The configs of the map
+     @param seed The seed used for the generation
+     @param recipe A string identifying the generation steps
+     @return The key of the map
+     */
+    static std::uint64_t GetKey(DungeonMapConfigs const &configs, int seed, std::string const &recipe = "");
+
+    /**
+     Computes the key of a world map.
+     @param configs The configs of the map
+     @param seed The seed used for the generation
+     @param recipe A string identifying the generation steps
+     @return The key of the map
+     */
+    static std::uint64_t GetKey(WorldMapConfigs const &configs, int seed, std::string const &recipe = "");
+
+    /**
+     Gets a map from the cache, generating and storing it on a miss.
+     Before generating, the seed of the calling thread is set and the RndManager instance is reset.
+     @param key The key of the map, as returned by GetKey
+     @param seed The seed used for the generation
+     @param generate A function building the map from scratch, for example by moving the result of a builder
+     @return A pointer to the map, or nullptr if it could not be generated
+     */
+    std::unique_ptr<Map> GetMap(std::uint64_t key, int seed, std::function<std::unique_ptr<Map>()> const &generate);
+
+    /**
+     Opens the file of a cached map, to use its layers in place without building the tiles.
+     @param key The key of the map
+     @param file The file to open
+     @return True if the map is in the cache, valid and its checksum matches, false otherwise
+     */
+    bool OpenMap(std::uint64_t key, MapFile &file);
+
+    /**
+     Checks whether a map is in the cache. The file is not validated.
+     @param key The key of the map
+     @return True if the map is in the cache, false otherwise
+     */
+    bool HasMap(std::uint64_t key);
+
+    /**
+     Gets an artifact from the cache, computing and storing it on a miss or if the stored one is corrupted.
+     @param key The key of the map the artifact is derived from
+     @param name The name of the artifact, made of letters, digits, '-' and '_'
+     @param compute A function computing the artifact
+     @return The artifact
+     */
+    std::vector<std::uint32_t> GetArtifact(std::uint64_t key,
+                                           std::string const &name,
+                                           std::function<std::vector<std::uint32_t>()> const &compute);
+
+    /**
+     Loads an artifact from the cache.
+     @param key The key of the map the artifact is derived from
+     @param name The name of the artifact, made of letters, digits, '-' and '_'
+     @param artifact The vector receiving the artifact
+     @return True if the artifact is in the cache and its checksum matches, false otherwise
+     */
+    bool LoadArtifact(std::uint64_t key, std::string const &name, std::vector<std::uint32_t> &artifact);
+
+    /**
+     Stores an artifact in the cache, replacing any previous one.
+     @param key The key of the map the artifact is derived from
+     @param name The name of the artifact, made of letters, digits, '-' and '_'
+     @param artifact The artifact
+     @return True if the artifact was stored, false otherwise
+     */
+    bool StoreArtifact(std::uint64_t key, std::string const &name, std::vector<std::uint32_t> const &artifact);
+
+private:
+    std::string directory_;     /**< The directory holding the entries */
+
+    /**
+     Gets the path of a file of an entry.
+     @param key The key of the entry
+     @param suffix The suffix appended to the key
+     @return The path of the file
+     */
+    std::string GetPath(std::uint64_t key, std::string const &suffix);
+};
+
+}
+
+#endif /* LIBPMG_MAP_CACHE_HPP_ */
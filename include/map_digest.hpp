@@ -0,0 +1,74 @@
+/**
+ @file map_digest.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_MAP_DIGEST_HPP_
+#define LIBPMG_MAP_DIGEST_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "map.hpp"
+#include "world_map.hpp"
+
+namespace libpmg {
+
+/**
+ A struct containing the functions that compute digests of generated maps, to check that a change to the library
+ leaves the maps generated from a seed bit exact, as promised by the RndManager stream contract.
+ Digests only depend on the content of the layers: tags are identified by name, in any order, and every value is
+ hashed in little endian order, so that digests match across platforms, and across a map and its MapFile or
+ MapSnapshotDecoder layers.
+ */
+struct MapDigest {
+
+    /**
+     Computes the digest of the tags of a map.
+     @param map The map
+     @return The digest of the map size and of the tags of every tile
+     */
+    static std::uint64_t GetTagDigest(Map &map);
+
+    /**
+     Computes the digest of a dense tag layer.
+     @param layer A dense, row major layer, as returned by Map::GetTagLayer
+     @param width The width of the layer
+     @param height The height of the layer
+     @param tags The tags packed into the layer, in bit order
+     @return The digest of the layer size and of the tags of every tile
+     */
+    static std::uint64_t GetTagDigest(std::uint32_t const *layer,
+                                      std::size_t width,
+                                      std::size_t height,
+                                      std::vector<std::shared_ptr<Tag>> const &tags);
+
+    /**
+     Computes the digest of the altitude of a world map.
+     @param map The map
+     @return The digest of the map size and of the exact altitude of every tile
+     */
+    static std::uint64_t GetAltitudeDigest(WorldMap &map);
+
+    /**
+     Computes the digest of a dense altitude layer.
+     @param altitude A dense, row major layer, as returned by MapFile::GetAltitudeLayer
+     @param width The width of the layer
+     @param height The height of the layer
+     @return The digest of the layer size and of the exact altitude of every tile
+     */
+    static std::uint64_t GetAltitudeDigest(float const *altitude, std::size_t width, std::size_t height);
+
+    /**
+     Formats a digest as 16 hexadecimal digits, the form to check in alongside golden outputs.
+     @param digest The digest
+     @return The formatted digest
+     */
+    static std::string ToString(std::uint64_t digest);
+};
+
+}
+
+#endif /* LIBPMG_MAP_DIGEST_HPP_ */
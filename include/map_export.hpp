@@ -0,0 +1,116 @@
+/**
+ @file map_export.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_MAP_EXPORT_HPP_
+#define LIBPMG_MAP_EXPORT_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "map.hpp"
+#include "world_map.hpp"
+
+namespace libpmg {
+
+static const std::size_t kMaxGlyphTableTags {16};
+
+/**
+ A struct containing the functions that export maps as ASCII sketches and images.
+ Every export works on a dense tag layer, turning tag masks into glyphs or colors through a lookup table built once
+ per export, so that tiles are written in a single pass with no per tile allocations. Overloads taking a raw layer
+ can export the layers of a MapFile or of a MapSnapshotDecoder without building the map.
+ */
+struct MapExport {
+
+    /**
+     Gets the size of the buffer needed by an ASCII export, made of a line for every row.
+     @param width The width of the map
+     @param height The height of the map
+     @return The size of the buffer, in bytes
+     */
+    static inline std::size_t GetAsciiSize(std::size_t width, std::size_t height) { return (width + 1) * height; }
+
+    /**
+     Builds the table mapping every tag mask to its glyph: the sprite of the tag with the highest draw priority,
+     or the empty char if no tag has a positive draw priority. Ties are won by the tag coming first in the list.
+     @param tags The tags of the layer, in bit order, up to kMaxGlyphTableTags
+     @return A table with an entry for every possible mask
+     */
+    static std::vector<char> GetGlyphTable(std::vector<std::shared_ptr<Tag>> const &tags);
+
+    /**
+     Writes the ASCII sketch of a map, the same printed by Map::Print, to a buffer.
+     @param map The map to export
+     @param buffer The buffer to write to
+     @param size The size of the buffer, at least GetAsciiSize bytes
+     @return The number of bytes written, or 0 if the buffer is too small
+     */
+    static std::size_t ExportAscii(Map &map, char *buffer, std::size_t size);
+
+    /**
+     Writes the ASCII sketch of a dense tag layer to a buffer.
+     @param layer A dense, row major layer, as returned by Map::GetTagLayer
+     @param width The width of the layer
+     @param height The height of the layer
+     @param tags The tags packed into the layer, in bit order
+     @param buffer The buffer to write to
+     @param size The size of the buffer, at least GetAsciiSize bytes
+     @return The number of bytes written, or 0 if the buffer is too small
+     */
+    static std::size_t ExportAscii(std::uint32_t const *layer,
+                                   std::size_t width,
+                                   std::size_t height,
+                                   std::vector<std::shared_ptr<Tag>> const &tags,
+                                   char *buffer,
+                                   std::size_t size);
+
+    /**
+     Writes a binary PPM image of the tags of a map, with a pixel for every tile.
+     Every tag gets a color hashed from its name, so images are stable across runs and can be diffed.
+     @param map The map to export
+     @param path The path of the image
+     @return True if the image was written, false otherwise
+     */
+    static bool ExportTagsPpm(Map &map, std::string const &path);
+
+    /**
+     Writes a binary PPM image of a dense tag layer, with a pixel for every tile.
+     @param layer A dense, row major layer, as returned by Map::GetTagLayer
+     @param width The width of the layer
+     @param height The height of the layer
+     @param tags The tags packed into the layer, in bit order
+     @param path The path of the image
+     @return True if the image was written, false otherwise
+     */
+    static bool ExportTagsPpm(std::uint32_t const *layer,
+                              std::size_t width,
+                              std::size_t height,
+                              std::vector<std::shared_ptr<Tag>> const &tags,
+                              std::string const &path);
+
+    /**
+     Writes a binary PGM image of the altitude of a world map, scaled from the lowest to the highest altitude.
+     @param map The map to export
+     @param path The path of the image
+     @return True if the image was written, false otherwise
+     */
+    static bool ExportAltitudePgm(WorldMap &map, std::string const &path);
+
+    /**
+     Writes a binary PGM image of a dense altitude layer, scaled from the lowest to the highest altitude.
+     @param altitude A dense, row major layer, as returned by MapFile::GetAltitudeLayer
+     @param width The width of the layer
+     @param height The height of the layer
+     @param path The path of the image
+     @return True if the image was written, false otherwise
+     */
+    static bool ExportAltitudePgm(float const *altitude, std::size_t width, std::size_t height, std::string const &path);
+};
+
+}
+
+#endif /* LIBPMG_MAP_EXPORT_HPP_ */
@@ -0,0 +1,180 @@
+/**
+ @file map_file.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_MAP_FILE_HPP_
+#define LIBPMG_MAP_FILE_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dungeon_map.hpp"
+#include "world_map.hpp"
+
+namespace libpmg {
+
+static const std::uint32_t kMapFileVersion      {2};
+static const std::size_t kMapFileMaxTagName     {55};
+
+/**
+ Represent the kind of map stored in a map file.
+ */
+enum struct MapFileType : std::uint32_t {
+    DUNGEON = 0,
+    WORLD = 1
+};
+
+/**
+ A class that saves maps to a versioned binary format, and loads them back through a read only memory mapping.
+ A map file holds a header, the map configs, the tag table and the room list, followed by raw, 8 bytes aligned,
+ row major layers: tags (one bit per tag table entry), path costs, for dungeon maps the rooms and corridors of
+ DungeonMap::GetRegionLayer, and for world maps altitude and biome.
+ Layers are used in place from the mapping, without copies or per tile allocations. Files are stored in the
+ byte order of the host that wrote them, and are rejected by hosts with a different one.
+ */
+class MapFile {
+public:
+    MapFile();
+    ~MapFile();
+    
+    MapFile(MapFile const&) = delete;
+    void operator=(MapFile const&) = delete;
+    
+    /**
+     Saves a dungeon map to a file.
+     @param map The map to save
+     @param path The path of the file
+     @return True if the map was saved, false otherwise
+     */
+    static bool Save(DungeonMap &map, std::string const &path);
+    
+    /**
+     Saves a world map to a file.
+     @param map The map to save
+     @param path The path of the file
+     @return True if the map was saved, false otherwise
+     */
+    static bool Save(WorldMap &map, std::string const &path);
+    
+    /**
+     Maps a map file in memory, and validates its header.
+     Any file previously opened is closed first.
+     @param path The path of the file
+     @return True if the file is a valid map file, false otherwise
+     */
+    bool Open(std::string const &path);
+    
+    /**
+     Unmaps the file. Every layer pointer obtained so far becomes invalid.
+     */
+    void Close();
+    
+    /**
+     Checks whether a valid file is mapped.
+     @return True if a file is mapped, false otherwise
+     */
+    inline bool IsOpen() const { return data_ != nullptr; }
+    
+    /**
+     Computes the checksum of the whole mapped file, reading every byte of it.
+     @return The 64 bit FNV-1a hash of the file
+     */
+    std::uint64_t GetChecksum() const;
+    
+    /**
+     Gets the kind of map held by the file.
+     @return The map type
+     */
+    MapFileType GetType() const;
+    
+    /**
+     Get the map size.
+     @return A pair containing map width and height
+     */
+    std::pair<std::size_t, std::size_t> GetMapSize() const;
+    
+    /**
+     Gets the tags of the tag table, in bit order. Unknown tags are created, using the stored sprite and draw priority.
+     @return The list of tags
+     */
+    std::vector<std::shared_ptr<Tag>> GetTagTable() const;
+    
+    /**
+     Gets the rooms of a dungeon map.
+     @return The list of room rects. It is empty for world maps
+     */
+    std::vector<Rect> GetRooms() const;
+    
+    /**
+     Gets the number of corridors of a dungeon map.
+     @return The number of corridors. It is 0 for world maps
+     */
+    std::size_t GetCorridorCount() const;
+    
+    /**
+     Gets the region layer of a dungeon map, in the format returned by DungeonMap::GetRegionLayer.
+     @return A pointer to width * height values, valid until the file is closed, or nullptr if the map has no rooms
+     and no corridors
+     */
+    std::uint32_t const *GetRegionLayer() const;
+    
+    /**
+     Gets the configs of a dungeon map.
+     @return The configs. Only valid if the file holds a dungeon map
+     */
+    DungeonMapConfigs GetDungeonConfigs() const;
+    
+    /**
+     Gets the configs of a world map.
+     @return The configs. Only valid if the file holds a world map
+     */
+    WorldMapConfigs GetWorldConfigs() const;
+    
+    /**
+     Gets the tag layer. Bit n of every value is set when the tile holds the n-th tag of the tag table.
+     @return A pointer to width * height values, valid until the file is closed
+     */
+    std::uint32_t const *GetTagLayer() const;
+    
+    /**
+     Gets the path cost layer.
+     @return A pointer to width * height values, valid until the file is closed
+     */
+    float const *GetCostLayer() const;
+    
+    /**
+     Gets the altitude layer.
+     @return A pointer to width * height values, valid until the file is closed, or nullptr for dungeon maps
+     */
+    float const *GetAltitudeLayer() const;
+    
+    /**
+     Gets the biome layer, holding BiomeType values.
+     @return A pointer to width * height values, valid until the file is closed, or nullptr for dungeon maps
+     */
+    std::uint8_t const *GetBiomeLayer() const;
+    
+    /**
+     Builds a full map, with a Tile for every location, out of the mapped file.
+     @return A pointer to the new map, either a DungeonMap or a WorldMap
+     */
+    std::unique_ptr<Map> ToMap() const;
+    
+private:
+    void *data_;                /**< The start of the mapping */
+    std::size_t size_;          /**< The size of the mapping */
+    
+    /**
+     Gets a pointer to an offset of the mapping.
+     @param offset The offset, in bytes
+     @return A pointer to the data at the offset, or nullptr if the offset is 0
+     */
+    void const *At(std::uint64_t offset) const;
+};
+
+}
+
+#endif /* LIBPMG_MAP_FILE_HPP_ */
@@ -0,0 +1,179 @@
+/**
+ @file map_snapshot.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_MAP_SNAPSHOT_HPP_
+#define LIBPMG_MAP_SNAPSHOT_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "map.hpp"
+
+namespace libpmg {
+
+static const std::uint8_t kMapSnapshotVersion   {1};
+static const std::size_t kMaxSnapshotTiles      {1 << 24};
+
+/**
+ A class that encodes the tag layer of a map into a compact snapshot, meant to be sent over the network.
+ A snapshot is a sequence of chunks, each one prefixed by its length: a header holding the map size, the tag
+ table and the palette of the distinct tag combinations, followed by one chunk for every row of the map.
+ Every row is run length encoded, packing the palette index of every run together with its length. The optional
+ entropy stage further codes the runs as a bit stream, with Rice codes for the lengths that adapt to their
+ running mean, so rows must be decoded in order.
+ Rows are encoded on demand, so that the first chunks can be sent before the whole map is encoded.
+ */
+class MapSnapshotEncoder {
+public:
+    /**
+     Prepares the encoding of the tag layer of a map.
+     @param map The map to encode
+     @param entropy_stage Whether to add the entropy stage, trading encoding speed for size
+     */
+    MapSnapshotEncoder(Map &map, bool entropy_stage = false);
+
+    /**
+     Prepares the encoding of a dense tag layer.
+     @param layer A dense, row major layer, as returned by Map::GetTagLayer
+     @param width The width of the layer
+     @param height The height of the layer
+     @param tags The tags packed into the layer, in bit order
+     @param entropy_stage Whether to add the entropy stage, trading encoding speed for size
+     */
+    MapSnapshotEncoder(std::vector<std::uint32_t> layer,
+                       std::size_t width,
+                       std::size_t height,
+                       std::vector<std::shared_ptr<Tag>> tags,
+                       bool entropy_stage = false);
+
+    /**
+     Appends the header chunk, starting the snapshot from the first row.
+     @param out The buffer to append the chunk to
+     */
+    void EncodeHeader(std::vector<std::uint8_t> &out);
+
+    /**
+     Appends the chunk of the next row not yet encoded. The header must be encoded first.
+     @param out The buffer to append the chunk to
+     @return True if a row was encoded, false if every row was already encoded
+     */
+    bool EncodeRow(std::vector<std::uint8_t> &out);
+
+    /**
+     Encodes the whole snapshot at once.
+     @return The header chunk followed by the chunks of every row
+     */
+    std::vector<std::uint8_t> Encode();
+
+    /**
+     Checks whether every row was encoded.
+     @return True if every row was encoded, false otherwise
+     */
+    inline bool IsComplete() const { return next_row_ == height_; }
+
+private:
+    std::vector<std::uint32_t> layer_;                              /**< The layer to encode */
+    std::size_t width_, height_;                                    /**< The size of the layer */
+    std::vector<std::shared_ptr<Tag>> tags_;                        /**< The tags packed into the layer */
+    std::vector<std::uint32_t> palette_;                            /**< The distinct values of the layer */
+    std::unordered_map<std::uint32_t, std::uint32_t> palette_map_;  /**< The palette index of every value */
+    bool entropy_stage_;                                            /**< Whether rows are entropy coded */
+    std::size_t next_row_;                                          /**< The next row to encode */
+    std::uint64_t rice_sum_, rice_count_;                           /**< The state of the run length codes, carried across rows */
+    std::vector<std::uint8_t> row_buffer_;                          /**< Scratch buffer for the row being encoded */
+
+    /**
+     Builds the palette of the layer.
+     */
+    void BuildPalette();
+};
+
+/**
+ A class that decodes a snapshot produced by MapSnapshotEncoder.
+ Data can be fed in chunks of any size, as it is received: rows are decoded as soon as they are complete.
+ */
+class MapSnapshotDecoder {
+public:
+    /**
+     Prepares the decoding of a snapshot.
+     @param max_tiles The largest number of tiles accepted, bounding the memory a header can make the decoder allocate
+     */
+    MapSnapshotDecoder(std::size_t max_tiles = kMaxSnapshotTiles);
+
+    /**
+     Feeds received data to the decoder, and decodes every complete chunk.
+     @param data A pointer to the data
+     @param size The size of the data, in bytes
+     @return False if the snapshot is malformed, true otherwise
+     */
+    bool Feed(void const *data, std::size_t size);
+
+    /**
+     Checks whether the header was decoded.
+     @return True if the header was decoded, false otherwise
+     */
+    inline bool HasHeader() const { return has_header_; }
+
+    /**
+     Checks whether every row was decoded.
+     @return True if the whole snapshot was decoded, false otherwise
+     */
+    inline bool IsComplete() const { return has_header_ && decoded_rows_ == height_; }
+
+    /**
+     Gets the number of rows decoded so far. Rows are decoded from the top of the map.
+     @return The number of decoded rows
+     */
+    inline std::size_t GetDecodedRows() const { return decoded_rows_; }
+
+    /**
+     Get the map size. Only valid once the header was decoded.
+     @return A pair containing map width and height
+     */
+    inline std::pair<std::size_t, std::size_t> GetMapSize() const { return std::make_pair(width_, height_); }
+
+    /**
+     Gets the tags packed in the layer, in bit order. Unknown tags are created, using the sent sprite and draw priority.
+     @return The list of tags
+     */
+    inline std::vector<std::shared_ptr<Tag>> const &GetTagTable() const { return tags_; }
+
+    /**
+     Gets the decoded layer. Rows not decoded yet are zero.
+     @return A dense, row major layer, in the format returned by Map::GetTagLayer
+     */
+    inline std::vector<std::uint32_t> const &GetTagLayer() const { return layer_; }
+
+private:
+    std::size_t max_tiles_;                     /**< The largest number of tiles accepted */
+    std::vector<std::uint8_t> buffer_;          /**< Data received, but not decoded yet */
+    bool has_header_;                           /**< Whether the header was decoded */
+    bool failed_;                               /**< Whether malformed data was received */
+    bool entropy_stage_;                        /**< Whether rows are entropy coded */
+    std::size_t width_, height_;                /**< The size of the layer */
+    std::size_t decoded_rows_;                  /**< The number of rows decoded */
+    std::uint64_t rice_sum_, rice_count_;       /**< The state of the run length codes, carried across rows */
+    std::vector<std::shared_ptr<Tag>> tags_;    /**< The tags packed into the layer */
+    std::vector<std::uint32_t> palette_;        /**< The distinct values of the layer */
+    std::vector<std::uint32_t> layer_;          /**< The decoded layer */
+
+    /**
+     Decodes the header chunk.
+     @return False if the header is malformed, true otherwise
+     */
+    bool DecodeHeader(std::uint8_t const *data, std::size_t size);
+
+    /**
+     Decodes the chunk of the next row.
+     @return False if the row is malformed, true otherwise
+     */
+    bool DecodeRow(std::uint8_t const *data, std::size_t size);
+};
+
+}
+
+#endif /* LIBPMG_MAP_SNAPSHOT_HPP_ */
@@ -0,0 +1,100 @@
+/**
+ @file neighbor_mask.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_NEIGHBOR_MASK_HPP_
+#define LIBPMG_NEIGHBOR_MASK_HPP_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace libpmg {
+
+/**
+ The bits of a neighbour mask.
+ The cardinal bits follow the order used by Map::GetNeighbors, and fill the lower nibble of the mask.
+ */
+enum NeighborBit : std::uint8_t {
+    kNeighborNorth      = 1 << 0,
+    kNeighborEast       = 1 << 1,
+    kNeighborSouth      = 1 << 2,
+    kNeighborWest       = 1 << 3,
+    kNeighborNorthWest  = 1 << 4,
+    kNeighborSouthEast  = 1 << 5,
+    kNeighborSouthWest  = 1 << 6,
+    kNeighborNorthEast  = 1 << 7
+};
+
+static const std::uint8_t kCardinalNeighbors    {0x0F};
+static const std::uint8_t kDiagonalNeighbors    {0xF0};
+
+/**
+ The X and Y offsets of the neighbours, in NeighborBit order, so that the first four are the cardinal ones.
+ Negative coordinates wrap around once added to an unsigned one, and fail the bounds check of the map as well.
+ */
+static const int kNeighborOffsets[8][2] {{0, -1}, {1, 0}, {0, 1}, {-1, 0}, {-1, -1}, {1, 1}, {-1, 1}, {1, -1}};
+
+/**
+ A struct containing the functions that compute and query neighbour bitmasks over a dense layer.
+ */
+struct NeighborMask {
+
+    /**
+     Computes the 8-neighbour mask of every tile in a single pass over a dense layer.
+     Bit n of a mask is set when the neighbour in direction n has any of the specified bits set in the layer.
+     Neighbours outside of the map are never set, and tiles on the map border get no mask at all.
+     @param layer A dense, row major layer, as returned by Map::GetTagLayer
+     @param width The width of the layer
+     @param height The height of the layer
+     @param bits The layer bits to test
+     @return A dense, row major vector holding the mask of every tile
+     */
+    static std::vector<std::uint8_t> Compute(std::vector<std::uint32_t> const &layer,
+                                             std::size_t width,
+                                             std::size_t height,
+                                             std::uint32_t bits);
+
+    /**
+     Checks whether a wall mask is eligible for a door.
+     A door needs exactly two cardinal walls, opposite to eachother.
+     @param wall_mask The neighbour mask of the wall layer
+     @return True if the mask is eligible for a door, false otherwise
+     */
+    static inline bool IsDoorMask(std::uint8_t wall_mask) { return kDoorTable[wall_mask & kCardinalNeighbors]; }
+
+    /**
+     Checks whether a wall mask is eligible for a wall embedded stair.
+     A wall stair needs exactly three cardinal walls.
+     @param wall_mask The neighbour mask of the wall layer
+     @return True if the mask is eligible for a wall stair, false otherwise
+     */
+    static inline bool IsWallStairMask(std::uint8_t wall_mask) { return kWallStairTable[wall_mask & kCardinalNeighbors]; }
+
+    /**
+     Counts the neighbours set in a mask.
+     @param mask The neighbour mask
+     @return The number of bits set
+     */
+    static inline std::size_t Count(std::uint8_t mask) { return kCountTable[mask & kCardinalNeighbors] + kCountTable[mask >> 4]; }
+
+private:
+    static constexpr std::array<bool, 16> kDoorTable {
+        false, false, false, false, false, true, false, false,
+        false, false, true, false, false, false, false, false
+    };
+
+    static constexpr std::array<bool, 16> kWallStairTable {
+        false, false, false, false, false, false, false, true,
+        false, false, false, true, false, true, true, false
+    };
+
+    static constexpr std::array<std::uint8_t, 16> kCountTable {
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+    };
+};
+
+}
+
+#endif /* LIBPMG_NEIGHBOR_MASK_HPP_ */
@@ -0,0 +1,42 @@
+/**
+ @file parallel.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_PARALLEL_HPP_
+#define LIBPMG_PARALLEL_HPP_
+
+#include <cstddef>
+#include <functional>
+
+namespace libpmg {
+
+/**
+ A struct containing the functions that split work across threads.
+ */
+struct Parallel {
+    
+    /**
+     Gets the number of threads to use for some work items.
+     @param threads The number of threads requested. If 0, the hardware concurrency will be used
+     @param count The number of work items
+     @return The number of threads, never more than the work items and at least 1
+     */
+    static std::size_t GetThreads(std::size_t threads, std::size_t count);
+    
+    /**
+     Calls a function for every index from 0 to count, split across threads.
+     Every worker keeps pulling the next index, until there are none left, so indices are run in no particular order.
+     The calling thread is one of the workers.
+     @param count The number of indices
+     @param threads The number of threads, as taken by GetThreads
+     @param function The function, called with the index and the number of the worker, from 0 to GetThreads
+     */
+    static void ForEachIndex(std::size_t count,
+                             std::size_t threads,
+                             std::function<void(std::size_t, std::size_t)> const &function);
+};
+
+}
+
+#endif /* LIBPMG_PARALLEL_HPP_ */
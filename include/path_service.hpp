@@ -0,0 +1,159 @@
+/**
+ @file path_service.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_PATH_SERVICE_HPP_
+#define LIBPMG_PATH_SERVICE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "map.hpp"
+
+namespace libpmg {
+
+/**
+ A struct holding the result of a path query.
+ */
+struct PathResult {
+    bool found_;                        /**< Whether the goal can be reached */
+    std::vector<std::size_t> path_;     /**< The row major indices of the tiles from the start to the goal, both included */
+};
+
+/**
+ A struct holding the throughput of a PathService.
+ */
+struct PathServiceStats {
+    std::uint64_t queries_;             /**< The queries answered */
+    std::uint64_t searches_;            /**< The searches run, one for every batch of queries with the same goal */
+    double seconds_;                    /**< The time from the first query submitted to the last one answered */
+    double queries_per_second_;         /**< The queries answered every second */
+};
+
+/**
+ A class answering path queries asynchronously, on a pool of worker threads.
+ The service reads a snapshot of the walls of a map, taken when it is created, so the map can be edited or destroyed
+ while queries run. Queries waiting for the same goal are answered together, by a single breadth first search
+ starting from the goal and stopping once every start is reached. Every worker keeps its own scratch buffers, stamped
+ at every search instead of being cleared.
+ */
+class PathService {
+public:
+    /**
+     Takes a snapshot of a map, and starts the workers.
+     @param map The map, where walls cannot be walked
+     @param dir Whether diagonal moves are allowed
+     @param threads The number of workers, or 0 to use one for every core
+     */
+    PathService(Map &map, MoveDirections const &dir, std::size_t threads = 0);
+
+    /**
+     Answers the queries still waiting, and stops the workers.
+     */
+    ~PathService();
+
+    PathService(PathService const&) = delete;
+    void operator=(PathService const&) = delete;
+
+    /**
+     Submits a query.
+     @param start The row major index of the start
+     @param goal The row major index of the goal
+     @return A future receiving the result
+     */
+    std::future<PathResult> Submit(std::size_t start, std::size_t goal);
+
+    /**
+     Submits a query, calling a function with the result. The function runs on a worker thread.
+     @param start The row major index of the start
+     @param goal The row major index of the goal
+     @param callback The function receiving the result
+     */
+    void Submit(std::size_t start, std::size_t goal, std::function<void(PathResult const&)> const &callback);
+
+    /**
+     Blocks until every query submitted so far is answered.
+     */
+    void WaitIdle();
+
+    /**
+     Gets the throughput since the service was created, or since the last reset.
+     @return The stats
+     */
+    PathServiceStats GetStats() const;
+
+    /**
+     Resets the stats.
+     */
+    void ResetStats();
+
+private:
+    /**
+     A struct holding a query waiting for an answer.
+     */
+    struct PendingQuery {
+        std::size_t start_;
+        std::promise<PathResult> promise_;
+        std::function<void(PathResult const&)> callback_;
+    };
+
+    /**
+     A struct holding the buffers of a worker, reused by every search.
+     */
+    struct Scratch {
+        std::uint32_t stamp_ {0};
+        std::vector<std::uint32_t> visited_;        /**< The stamp of the last search that reached every tile */
+        std::vector<std::uint32_t> targets_;        /**< The stamp of the last search that had every tile as a start */
+        std::vector<std::uint32_t> parents_;        /**< The next tile towards the goal */
+        std::vector<std::uint32_t> frontier_;
+    };
+
+    std::size_t width_;                             /**< The width of the map */
+    std::size_t height_;                            /**< The height of the map */
+    MoveDirections dir_;                            /**< Whether diagonal moves are allowed */
+    std::vector<std::uint8_t> walkable_;            /**< The snapshot of the walkable tiles */
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_ready_;            /**< Signalled when a query is submitted, or on shutdown */
+    std::condition_variable idle_;                  /**< Signalled when the last query is answered */
+    std::unordered_map<std::size_t, std::vector<PendingQuery>> pending_;    /**< The queries waiting, by goal */
+    std::deque<std::size_t> goals_;                 /**< The goals waiting, in order of arrival */
+    std::size_t running_ {0};                       /**< The queries being answered */
+    bool stopping_ {false};
+    std::vector<std::thread> workers_;
+
+    std::atomic<std::uint64_t> queries_ {0};
+    std::atomic<std::uint64_t> searches_ {0};
+    std::chrono::steady_clock::time_point first_submit_;
+    std::chrono::steady_clock::time_point last_answer_;
+    bool has_submitted_ {false};
+
+    /**
+     Queues a query.
+     */
+    void Enqueue(std::size_t goal, PendingQuery query);
+
+    /**
+     Takes the queries of a goal at a time, until the service stops.
+     */
+    void WorkerLoop();
+
+    /**
+     Answers every query of a goal with a single search.
+     */
+    void Answer(std::size_t goal, std::vector<PendingQuery> &queries, Scratch &scratch);
+};
+
+}
+
+#endif /* LIBPMG_PATH_SERVICE_HPP_ */
@@ -0,0 +1,76 @@
+/**
+ @file poisson_disk_sampler.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_POISSON_DISK_SAMPLER_HPP_
+#define LIBPMG_POISSON_DISK_SAMPLER_HPP_
+
+#include <functional>
+#include <vector>
+
+#include "constants.hpp"
+
+namespace libpmg {
+
+/**
+ A class that scatters points across a grid of tiles, using Bridson's Poisson-disk sampling.
+ A background grid, with cells small enough to hold one point at most, makes every spacing check O(1), so
+ the cost of sampling grows linearly with the number of points.
+ */
+class PoissonDiskSampler {
+public:
+    
+    /**
+     @param width The width of the grid
+     @param height The height of the grid
+     @param min_distance The minimum euclidean distance between two points. Values lower than 1 are treated as 1
+     @param max_attempts How many candidates are tried around an active point before retiring it
+     */
+    PoissonDiskSampler(std::size_t width,
+                       std::size_t height,
+                       float min_distance,
+                       std::size_t max_attempts = kDefaultPoissonAttempts);
+    
+    /**
+     Scatters points across the grid.
+     When the active list runs out, sampling restarts from a seed drawn at random from the candidates, so that
+     areas that are not reachable by the annulus of any point, like isolated rooms, are covered too.
+     @param candidates The row major indices of the tiles that may be used as seeds
+     @param is_eligible Checks whether a row major index can host a point
+     @param max_points The maximum number of points to place
+     @return The row major indices of the placed points
+     */
+    std::vector<std::size_t> Sample(std::vector<std::size_t> const &candidates,
+                                    std::function<bool(std::size_t)> const &is_eligible,
+                                    std::size_t max_points);
+    
+private:
+    std::size_t width_, height_;
+    float min_distance_;
+    std::size_t max_attempts_;
+    float cell_size_;                       /**< The side of a background grid cell, min_distance_ / sqrt(2) */
+    std::size_t grid_width_, grid_height_;
+    std::vector<std::size_t> grid_;         /**< The point held by every background grid cell, or npos */
+    
+    /**
+     Checks whether a tile is far enough from every point placed so far.
+     @param x The X coordinate
+     @param y The Y coordinate
+     @param points The points placed so far
+     @return True if the tile respects the minimum distance, false otherwise
+     */
+    bool IsFarEnough(std::size_t x, std::size_t y, std::vector<std::size_t> const &points) const;
+    
+    /**
+     Gets the background grid cell holding a tile.
+     @param x The X coordinate
+     @param y The Y coordinate
+     @return The row major index of the cell
+     */
+    std::size_t GetCell(std::size_t x, std::size_t y) const;
+};
+
+}
+
+#endif /* LIBPMG_POISSON_DISK_SAMPLER_HPP_ */
@@ -0,0 +1,188 @@
+/**
+ @file profiler.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_PROFILER_HPP_
+#define LIBPMG_PROFILER_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ Define it to remove the profiler at compile time, so that every phase costs nothing.
+ */
+#ifdef LIBPMG_DISABLE_PROFILER
+#define LIBPMG_PROFILER_COMPILED false
+#else
+#define LIBPMG_PROFILER_COMPILED true
+#endif
+
+namespace libpmg {
+
+static constexpr bool kProfilerCompiled {LIBPMG_PROFILER_COMPILED};
+
+/**
+ A struct containing the measures of a single run of a generation phase.
+ */
+struct PhaseMetrics {
+    std::string name_;                  /**< The name of the phase */
+    std::uint64_t start_ns_;            /**< The start time, on the steady clock */
+    std::uint64_t duration_ns_;         /**< The wall time spent in the phase */
+    std::uint64_t allocations_;         /**< The allocations reported through Profiler::CountAllocation */
+    std::uint64_t allocated_bytes_;     /**< The bytes reported through Profiler::CountAllocation */
+    std::uint32_t thread_;              /**< A small id of the thread that ran the phase */
+    std::vector<std::pair<std::string, std::uint64_t>> counters_;  /**< The item counters, in order of first use */
+
+    /**
+     Gets the value of a counter.
+     @param name The name of the counter
+     @return The value of the counter, or 0 if it was never counted
+     */
+    std::uint64_t GetCounter(std::string const &name) const;
+};
+
+/**
+ A struct containing the phases recorded while building a map, in the order they started.
+ A phase run multiple times, like stairs generation, is recorded once per run.
+ */
+struct GenerationMetrics {
+    std::vector<PhaseMetrics> phases_;
+
+    /**
+     Gets the first run of a phase.
+     @param name The name of the phase
+     @return A pointer to the phase, or nullptr if it was not recorded
+     */
+    PhaseMetrics const *GetPhase(std::string const &name) const;
+
+    /**
+     Gets the total wall time of every run of a phase.
+     @param name The name of the phase
+     @return The wall time, in nanoseconds
+     */
+    std::uint64_t GetDuration(std::string const &name) const;
+
+    /**
+     Gets the total of a counter over every phase.
+     @param name The name of the counter
+     @return The total of the counter
+     */
+    std::uint64_t GetCounter(std::string const &name) const;
+
+    /**
+     Removes every recorded phase.
+     */
+    inline void Clear() { phases_.clear(); }
+
+    /**
+     Writes the phases as a Chrome trace, to be opened by chrome://tracing or Perfetto.
+     @param path The path of the trace
+     @return True if the trace was written, false otherwise
+     */
+    bool WriteChromeTrace(std::string const &path) const;
+
+    /**
+     Writes the phases of multiple maps as a single Chrome trace, for example the levels of a DungeonStackBuilder.
+     @param metrics The metrics of the maps
+     @param path The path of the trace
+     @return True if the trace was written, false otherwise
+     */
+    static bool WriteChromeTrace(std::vector<GenerationMetrics const*> const &metrics, std::string const &path);
+};
+
+/**
+ A class that controls the recording of generation phases.
+ The profiler is disabled by default. When disabled, a phase costs a single atomic load and counters cost a thread
+ local load, so it can be left enabled in production to alert on regressions.
+ The library doesn't replace the global operator new: to measure allocations, the application calls CountAllocation
+ from its own replacement, and every phase records the allocations made by its thread while it runs.
+ */
+class Profiler {
+public:
+    /**
+     Enables or disables the recording of phases, for every thread.
+     @param enabled True to record phases
+     */
+    static inline void SetEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+
+    /**
+     Checks whether phases are recorded.
+     @return True if phases are recorded, false otherwise
+     */
+    static inline bool IsEnabled() { return kProfilerCompiled && enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     Adds to a counter of the phase running on the calling thread. Nothing is counted outside of a phase.
+     @param name The name of the counter
+     @param value The value to add
+     */
+    static inline void Count(char const *name, std::uint64_t value = 1) {
+        if (kProfilerCompiled && current_metrics_ != nullptr)
+            AddToCurrent(name, value);
+    }
+
+    /**
+     Reports an allocation made by the calling thread.
+     @param bytes The size of the allocation
+     */
+    static inline void CountAllocation(std::size_t bytes) {
+        allocations_++;
+        allocated_bytes_ += bytes;
+    }
+
+private:
+    friend class ScopedPhase;
+
+    static std::atomic<bool> enabled_;                          /**< Whether phases are recorded */
+    static thread_local GenerationMetrics *current_metrics_;    /**< The metrics of the running phase, if any */
+    static thread_local std::size_t current_phase_;             /**< The index of the running phase */
+    static thread_local std::uint64_t allocations_;             /**< The allocations of the thread */
+    static thread_local std::uint64_t allocated_bytes_;         /**< The bytes allocated by the thread */
+
+    static void AddToCurrent(char const *name, std::uint64_t value);
+};
+
+/**
+ A class that records a phase from its construction to its destruction, if the profiler is enabled.
+ Phases can be nested, and counters go to the innermost one.
+ */
+class ScopedPhase {
+public:
+    /**
+     Starts a phase.
+     @param metrics The metrics receiving the phase
+     @param name The name of the phase
+     */
+    ScopedPhase(GenerationMetrics &metrics, char const *name);
+    ~ScopedPhase();
+
+    ScopedPhase(ScopedPhase const&) = delete;
+    ScopedPhase &operator=(ScopedPhase const&) = delete;
+
+private:
+    GenerationMetrics *metrics_;                /**< The metrics receiving the phase, or nullptr if not recorded */
+    std::size_t phase_;                         /**< The index of the phase */
+    GenerationMetrics *previous_metrics_;       /**< The metrics of the enclosing phase */
+    std::size_t previous_phase_;                /**< The index of the enclosing phase */
+
+    void Start(GenerationMetrics &metrics, char const *name);
+    void Stop();
+};
+
+inline ScopedPhase::ScopedPhase(GenerationMetrics &metrics, char const *name) : metrics_ {nullptr} {
+    if (Profiler::IsEnabled())
+        Start(metrics, name);
+}
+
+inline ScopedPhase::~ScopedPhase() {
+    if (metrics_ != nullptr)
+        Stop();
+}
+
+}
+
+#endif /* LIBPMG_PROFILER_HPP_ */
@@ -100,7 +100,7 @@ public:
     bool IsAdjacentTile(std::size_t x, std::size_t y);
     
     /**
-     Prints the debug informations for this Rect
+     Prints the debug informations for this Rect, as a LogLevel::DEBUG message.
      */
     void Print();
     
@@ -4,55 +4,200 @@
  */
 
 #ifndef LIBPMG_GAME_SETTINGS_HPP_
-#define LIBPMG_GAME_SETTINGS_HPP_ 
+#define LIBPMG_GAME_SETTINGS_HPP_
 
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <random>
 
 namespace libpmg {
 
+/**
+ A pure virtual class that represent a generator of random 32 bit words.
+ Engines are selected for every thread by RndManager::SetEngineFactory, and must produce the same words for the same
+ seed and stream on every platform.
+ */
+class RandomEngine {
+public:
+    virtual ~RandomEngine() {}
+
+    /**
+     Restarts the engine at the beginning of a stream.
+     @param seed The seed
+     @param stream The stream number. Different streams of the same seed must be independent
+     */
+    virtual void Seed(std::uint64_t seed, std::uint64_t stream) = 0;
+
+    /**
+     Gets the next word of the stream.
+     @return A uniformly distributed 32 bit word
+     */
+    virtual std::uint32_t Next() = 0;
+};
+
+/**
+ The default engine, the counter based Philox4x32-10 generator.
+ Every block of four words is a keyed hash of its position: the seed is the key, and the stream and block index are
+ the counter, so the state is 32 bytes, seeding is free, and any stream can be split off without drawing.
+ */
+class PhiloxEngine : public RandomEngine {
+public:
+    PhiloxEngine();
+
+    void Seed(std::uint64_t seed, std::uint64_t stream) override;
+    std::uint32_t Next() override;
+
+    /**
+     Computes a block of four words, running the ten rounds of Philox4x32-10 on a counter.
+     Word n of a stream is word n % 4 of the block whose counter holds n / 4 in its low 64 bits and the stream
+     number in its high ones, keyed with the seed.
+     @param counter The counter, least significant word first
+     @param key The key, least significant word first
+     @return The block
+     */
+    static std::array<std::uint32_t, 4> GetBlock(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key);
+
+private:
+    std::array<std::uint32_t, 2> key_;          /**< The key, made of the seed */
+    std::array<std::uint32_t, 4> counter_;      /**< The block index, followed by the stream number */
+    std::array<std::uint32_t, 4> block_;        /**< The words of the current block */
+    std::size_t position_;                      /**< The next word of the block to return */
+};
+
+/**
+ An engine wrapping std::mt19937, whose output is fully specified by the standard.
+ Stream 0 of a seed yields the same words as std::mt19937 seeded with it. Other streams are seeded with
+ RndManager::DeriveSeed.
+ */
+class Mt19937Engine : public RandomEngine {
+public:
+    void Seed(std::uint64_t seed, std::uint64_t stream) override;
+    inline std::uint32_t Next() override { return static_cast<std::uint32_t>(generator_()); }
+
+private:
+    std::mt19937 generator_;    /**< The generator */
+};
+
+/**
+ A class that represent an independent stream of random values, derived from a seed and a stream number.
+ A stream only depends on its seed and number, so work split into numbered tasks, like rooms, corridors or levels,
+ draws the same values whichever thread runs it and in whichever order.
+ */
+class RndStream {
+public:
+    /**
+     Initializes the stream, with an engine from the current engine factory.
+     @param seed The seed
+     @param stream The stream number
+     */
+    RndStream(int seed, std::uint64_t stream);
+
+    /**
+     Gets a random unsigned int from a range, without bias, through the same steps on every platform.
+     Ranges up to 2^32 values consume one word or more of the engine, with Lemire's multiply and reject method.
+     Wider ranges consume two words or more, high word first, masked and rejected until in range.
+     @param min The min value (inclusive)
+     @param max Tha max value (inclusive)
+     @return A random unsigned integer bigger or equal than min and smaller or equal to max, or min if max < min
+     */
+    std::size_t GetRandomUintFromRange(std::size_t min, std::size_t max);
+
+    /**
+     Return the engine of this stream.
+     @return The engine
+     */
+    inline RandomEngine &GetEngine() { return *engine_; }
+
+private:
+    std::unique_ptr<RandomEngine> engine_;      /**< The engine, seeded at the start of the stream */
+};
+
 /**
  This singletone class manages the random generator.
+ Every thread owns its own instance and seed, so that maps can be generated in parallel and stay deterministic.
+
+ The stream contract: a map built from a seed, with the same configs and builder calls, is bit exact on every
+ platform and across library releases with the same kRndStreamVersion. To keep it:
+ - The generator is stream 0 of the seed_ of the calling thread, restarted by ResetInstance, on the engine made by the
+   engine factory, PhiloxEngine by default. Engines must produce the same words on every platform.
+ - Values are only drawn through GetRandomUintFromRange, whose algorithm is part of the contract. Standard
+   distributions are implementation defined, and must not be used on the engine.
+ - The builders draw in a fixed order. Any change to what is drawn, or in which order, must bump kRndStreamVersion,
+   which is part of the MapCache keys, and regenerate the golden digests in tests/golden_digests.txt.
  */
 class RndManager {
 public:
-    
+
     /**
      Use this to access the class.
      @return A singleton reference to this class
      */
     static RndManager& GetInstance() {
-        static RndManager instance;
+        static thread_local RndManager instance;
         return instance;
     }
-    static int seed_;    /**< The seed used for generation. Instance must be reset after changing the seed */
-    
+    static thread_local int seed_;    /**< The seed used for generation by the calling thread. Instance must be reset after changing the seed */
+
+    /**
+     Derives an independent seed from a base seed and a stream number, mixing them with the SplitMix64 finalizer.
+     The result only depends on the arguments, so any stream can be regenerated alone.
+     @param seed The base seed
+     @param stream The stream number
+     @return The derived seed
+     */
+    static int DeriveSeed(int seed, std::uint64_t stream);
+
     /**
-     Gets a random unsigned int from a range.
+     Sets the function creating the engines of every thread and stream. Instances already created keep their engine
+     until ResetInstance is called. Changing engine changes every generated map.
+     @param factory A function returning a new engine, or nullptr to restore PhiloxEngine
+     */
+    static void SetEngineFactory(std::function<std::unique_ptr<RandomEngine>()> const &factory);
+
+    /**
+     Creates an engine through the current engine factory.
+     @return A new, unseeded engine
+     */
+    static std::unique_ptr<RandomEngine> CreateEngine();
+
+    /**
+     Gets a random unsigned int from a range, drawn from the stream of the calling thread.
+     See RndStream::GetRandomUintFromRange for the algorithm.
      @param min The min value (inclusive)
      @param max Tha max value (inclusive)
-     @return A random unsigned integer bigger or equal than min and smaller or equal to max
+     @return A random unsigned integer bigger or equal than min and smaller or equal to max, or min if max < min
      */
-    std::size_t GetRandomUintFromRange(std::size_t min, std::size_t max);
-    
+    inline std::size_t GetRandomUintFromRange(std::size_t min, std::size_t max) { return stream_->GetRandomUintFromRange(min, max); }
+
     /**
-     Return the rng.
-     @return The Random Number Generator
+     Gets a stream derived from the seed of the calling thread, independent of the values drawn so far.
+     Stream 0 is the stream of the instance itself.
+     @param stream The stream number
+     @return The stream
      */
-    inline std::mt19937 &GetGenerator() { return *random_generator_; }
-    
+    inline RndStream GetStream(std::uint64_t stream) const { return RndStream {seed_, stream}; }
+
+    /**
+     Return the engine of the stream of the calling thread.
+     @return The engine
+     */
+    inline RandomEngine &GetEngine() { return stream_->GetEngine(); }
+
     /**
      Reset the instance and applies the seed.
      */
     void ResetInstance();
-    
+
 private:
     RndManager();
-    
+
     RndManager(RndManager const&) = delete;
     void operator=(RndManager const&) = delete;
-    
-    std::unique_ptr<std::mt19937> random_generator_;
+
+    std::unique_ptr<RndStream> stream_;     /**< The stream of the calling thread */
 };
-    
+
 }
 #endif /* LIBPMG_GAME_SETTINGS_HPP_ */
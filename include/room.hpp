@@ -18,7 +18,7 @@ public:
     Room(Rect rect) : Area(rect) {}
 
     /**
-     Prints debug information about this Room.
+     Prints debug information about this Room, as a LogLevel::DEBUG message.
      */
     void Print();
 };
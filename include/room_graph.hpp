@@ -0,0 +1,107 @@
+/**
+ @file room_graph.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_ROOM_GRAPH_HPP_
+#define LIBPMG_ROOM_GRAPH_HPP_
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "connectivity.hpp"
+#include "map.hpp"
+#include "room.hpp"
+
+namespace libpmg {
+
+static const std::uint32_t kNoRoom {std::numeric_limits<std::uint32_t>::max()};
+
+/**
+ A struct that defines a corridor between two rooms, not crossing any other room.
+ */
+struct RoomLink {
+    std::uint32_t room_;                /**< The room reached by the corridor */
+    std::uint32_t length_;              /**< The steps from the closest tile of the first room to the tile reached in the other one */
+    std::vector<std::size_t> path_;     /**< The row major indices of the tiles between the two rooms, in walking order */
+};
+
+/**
+ A class holding the routes between the rooms of a map, so that room level queries never search the tiles.
+ Every room is flooded once when the graph is built: distances are exact, counting the steps between the closest
+ tiles of two rooms, across corridors, doors and any room in between. Rooms are numbered like the room list, and a
+ tile in more than a room belongs to the first one.
+ */
+class RoomGraph {
+public:
+    /**
+     Builds the graph of a map.
+     @param map The map
+     @param rooms The rooms of the map
+     @param dir Whether diagonal moves are allowed
+     */
+    RoomGraph(Map &map, std::vector<std::unique_ptr<Room>> const &rooms, MoveDirections const &dir);
+
+    /**
+     Gets the steps between the closest tiles of two rooms.
+     @param from The first room
+     @param to The other room
+     @return The number of steps, 0 for the same room, or kUnreachableDistance
+     */
+    inline std::uint32_t GetDistance(std::size_t from, std::size_t to) const { return distances_[from * rooms_ + to]; }
+
+    /**
+     Gets the first room entered on the shortest way between two rooms.
+     @param from The first room
+     @param to The other room
+     @return The next room, to if no room is in between, or kNoRoom if to cannot be reached
+     */
+    inline std::uint32_t GetNextRoom(std::size_t from, std::size_t to) const { return next_rooms_[from * rooms_ + to]; }
+
+    /**
+     Gets the rooms crossed on the way between two rooms, following GetNextRoom.
+     @param from The first room
+     @param to The other room
+     @return The rooms, from the first one to the other one included, or an empty vector if to cannot be reached
+     */
+    std::vector<std::uint32_t> GetRoute(std::size_t from, std::size_t to) const;
+
+    /**
+     Gets the corridors leaving a room, at most one for every room they reach, the shortest one.
+     @param room The room
+     @return The corridors, ordered by room
+     */
+    inline std::vector<RoomLink> const &GetLinks(std::size_t room) const { return links_[room]; }
+
+    /**
+     Gets the shortest corridor between two rooms, not crossing any other room.
+     @param from The first room
+     @param to The other room
+     @return A pointer to the corridor, or nullptr if the rooms are not linked directly
+     */
+    RoomLink const *GetLink(std::size_t from, std::size_t to) const;
+
+    /**
+     Gets the room holding a tile.
+     @param index The row major index of the tile
+     @return The room, or kNoRoom
+     */
+    inline std::uint32_t GetRoomAt(std::size_t index) const { return room_layer_[index]; }
+
+    inline std::size_t GetRoomCount() const { return rooms_; }
+    inline MoveDirections GetDirections() const { return dir_; }
+
+private:
+    std::size_t rooms_;                             /**< The number of rooms */
+    MoveDirections dir_;                            /**< Whether diagonal moves are allowed */
+    std::vector<std::uint32_t> room_layer_;         /**< The room of every tile */
+    std::vector<std::uint32_t> distances_;          /**< The distance between every pair of rooms */
+    std::vector<std::uint32_t> next_rooms_;         /**< The next room between every pair of rooms */
+    std::vector<std::vector<RoomLink>> links_;      /**< The corridors leaving every room */
+};
+
+}
+
+#endif /* LIBPMG_ROOM_GRAPH_HPP_ */
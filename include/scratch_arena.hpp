@@ -0,0 +1,153 @@
+/**
+ @file scratch_arena.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_SCRATCH_ARENA_HPP_
+#define LIBPMG_SCRATCH_ARENA_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace libpmg {
+
+static const std::size_t kDefaultScratchArenaSize {1 << 20};
+
+/**
+ A monotonic memory resource for the scratch structures of a build, like search frontiers and candidate lists.
+ Allocations bump a pointer into a single buffer and deallocations do nothing, until Release frees everything at
+ once, or Rewind frees everything allocated after a mark. Requests that don't fit in the buffer go to the upstream
+ resource, and Release grows the buffer to the peak usage, so that an arena reused by a worker thread across builds
+ soon serves every request from its buffer, with no calls to malloc.
+ Short lived work, like a single path search, should run in a ScratchScope, so that the arena is rewound as soon as
+ it ends, instead of growing until the next release.
+ The arena is not thread safe: every thread should own its own.
+ */
+class ScratchArena : public std::pmr::memory_resource {
+public:
+    /**
+     A struct holding the state of an arena, to rewind it to.
+     */
+    struct Mark {
+        std::size_t used_;              /**< The bytes of the buffer in use */
+        std::size_t overflow_count_;    /**< The number of blocks served by the upstream resource */
+        std::size_t overflow_bytes_;    /**< The bytes served by the upstream resource */
+    };
+
+    /**
+     Initializes the arena.
+     @param size The initial size of the buffer, in bytes
+     @param upstream The resource used for the buffer and for the requests that don't fit in it
+     */
+    ScratchArena(std::size_t size = kDefaultScratchArenaSize,
+                 std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+    ~ScratchArena();
+
+    ScratchArena(ScratchArena const&) = delete;
+    ScratchArena &operator=(ScratchArena const&) = delete;
+
+    /**
+     Frees every allocation at once, and grows the buffer if the peak usage since the last release didn't fit in it.
+     Nothing allocated from the arena may be used afterwards.
+     */
+    void Release();
+
+    /**
+     Gets the current state of the arena, to rewind it to later.
+     @return The mark
+     */
+    inline Mark GetMark() const { return Mark {used_, overflows_.size(), overflow_bytes_}; }
+
+    /**
+     Frees every allocation made after a mark. Marks must be rewound in the reverse order they were taken, and a mark
+     taken before the last release must not be used.
+     Nothing allocated from the arena after the mark may be used afterwards.
+     @param mark The mark
+     */
+    void Rewind(Mark const &mark);
+
+    /**
+     Gets the size of the buffer.
+     @return The size of the buffer, in bytes
+     */
+    inline std::size_t GetCapacity() const { return capacity_; }
+
+    /**
+     Gets the bytes allocated since the last release, including those served by the upstream resource.
+     @return The allocated bytes
+     */
+    inline std::size_t GetUsed() const { return used_ + overflow_bytes_; }
+
+    /**
+     Gets the most bytes in use at once since the last release, including those served by the upstream resource.
+     @return The peak usage, in bytes
+     */
+    inline std::size_t GetPeak() const { return peak_; }
+
+    /**
+     Gets the number of requests served by the upstream resource since the arena was created.
+     @return The number of upstream requests
+     */
+    inline std::size_t GetUpstreamAllocations() const { return upstream_allocations_; }
+
+private:
+    /**
+     A block allocated from the upstream resource, because it did not fit in the buffer.
+     */
+    struct Overflow {
+        void *data_;
+        std::size_t size_;
+        std::size_t alignment_;
+    };
+
+    std::pmr::memory_resource *upstream_;       /**< The resource backing the arena */
+    std::byte *buffer_;                         /**< The buffer */
+    std::size_t capacity_;                      /**< The size of the buffer */
+    std::size_t used_;                          /**< The bytes of the buffer in use */
+    std::size_t overflow_bytes_;                /**< The bytes served by the upstream resource since the last release */
+    std::size_t peak_;                          /**< The most bytes in use at once since the last release */
+    std::size_t upstream_allocations_;          /**< The requests served by the upstream resource */
+    std::vector<Overflow> overflows_;           /**< The blocks served by the upstream resource */
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    inline void do_deallocate(void*, std::size_t, std::size_t) override {}
+    inline bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override { return this == &other; }
+};
+
+/**
+ A scope rewinding a ScratchArena to the mark it was created at, when it goes out of scope.
+ It does nothing if the resource is not a ScratchArena, since other resources free their memory on their own.
+ Everything allocated in the scope must be freed before it ends.
+ */
+class ScratchScope {
+public:
+    /**
+     Initializes the scope.
+     @param resource The resource, rewound only if it's a ScratchArena
+     */
+    ScratchScope(std::pmr::memory_resource *resource)
+    : arena_ {dynamic_cast<ScratchArena*>(resource)},
+    mark_ {}
+    {
+        if (arena_ != nullptr)
+            mark_ = arena_->GetMark();
+    }
+
+    ~ScratchScope() {
+        if (arena_ != nullptr)
+            arena_->Rewind(mark_);
+    }
+
+    ScratchScope(ScratchScope const&) = delete;
+    ScratchScope &operator=(ScratchScope const&) = delete;
+
+private:
+    ScratchArena *arena_;           /**< The arena, or nullptr */
+    ScratchArena::Mark mark_;       /**< The mark to rewind to */
+};
+
+}
+
+#endif /* LIBPMG_SCRATCH_ARENA_HPP_ */
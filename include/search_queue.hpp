@@ -0,0 +1,244 @@
+/**
+ @file search_queue.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_SEARCH_QUEUE_HPP_
+#define LIBPMG_SEARCH_QUEUE_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory_resource>
+#include <vector>
+
+namespace libpmg {
+
+/**
+ A monotone bucket queue, also known as Dial's queue, for searches with small integer costs.
+ Every priority has a bucket, in a ring holding the priorities between the last one popped and the highest one
+ pushed, that grows when a push doesn't fit. Priorities pushed must not be lower than the last one popped, which
+ holds for Dijkstra with costs of at least 0. Items of the same priority are popped from the lowest, like
+ PriorityQueue, so that both queues give the same order.
+ */
+template<typename T>
+class BucketQueue {
+public:
+    typedef std::uint32_t priority_type;
+
+    /**
+     Initializes the queue.
+     @param buckets The initial size of the ring, a power of 2 higher than the highest cost of a step
+     @param resource The resource the buckets are allocated from
+     */
+    BucketQueue(std::size_t buckets = 1024, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+    : buckets_(std::max<std::size_t>(buckets, 1), resource),
+    current_ {std::numeric_limits<priority_type>::max()},
+    size_ {0}
+    {
+        assert((buckets_.size() & (buckets_.size() - 1)) == 0);
+    }
+
+    inline bool empty() const { return size_ == 0; }
+    inline std::size_t size() const { return size_; }
+
+    inline void push(T item, priority_type priority) {
+        // The last priority popped stays the lowest one, until the first push
+        if (size_ == 0 && priority < current_)
+            current_ = priority;
+
+        assert(priority >= current_);
+
+        if (priority - current_ >= buckets_.size())
+            Grow(priority - current_);
+
+        auto &bucket {buckets_[priority & (buckets_.size() - 1)]};
+        bucket.push_back(item);
+        std::push_heap(bucket.begin(), bucket.end(), std::greater<T> {});
+        size_++;
+    }
+
+    inline T pop() {
+        assert(size_ > 0);
+
+        while (buckets_[current_ & (buckets_.size() - 1)].empty())
+            current_++;
+
+        auto &bucket {buckets_[current_ & (buckets_.size() - 1)]};
+        std::pop_heap(bucket.begin(), bucket.end(), std::greater<T> {});
+
+        auto item {bucket.back()};
+        bucket.pop_back();
+        size_--;
+
+        return item;
+    }
+
+private:
+    std::pmr::vector<std::pmr::vector<T>> buckets_;     /**< The items of every priority, as heaps */
+    priority_type current_;                             /**< The lowest priority that may hold items */
+    std::size_t size_;                                  /**< The number of items */
+
+    /**
+     Grows the ring, moving every bucket to the position of its priority.
+     @param span The distance between the lowest and the highest priority to hold
+     */
+    void Grow(std::size_t span) {
+        auto size {buckets_.size()};
+        while (size <= span)
+            size *= 2;
+
+        std::pmr::vector<std::pmr::vector<T>> buckets(size, buckets_.get_allocator());
+        for (std::size_t offset {0}; offset < buckets_.size(); offset++) {
+            auto priority {static_cast<priority_type>(current_ + offset)};
+            buckets[priority & (size - 1)].swap(buckets_[priority & (buckets_.size() - 1)]);
+        }
+
+        buckets_.swap(buckets);
+    }
+};
+
+/**
+ A 4-ary heap of row major tile indices, for searches with any cost, supporting decrease-key.
+ Being shallower than a binary heap, it moves fewer nodes on every push, and the four children of a node share a
+ cache line. The position of every item is kept in an array provided by the caller, that is never cleared: positions
+ are checked against the heap before being used, so the array can be reused by any number of searches.
+ Items of the same priority are popped from the lowest, like PriorityQueue.
+ */
+template<typename priority_t>
+class QuaternaryHeap {
+public:
+    typedef priority_t priority_type;
+
+    /**
+     Initializes the heap.
+     @param positions The array holding the position of every item, grown to the capacity if needed
+     @param capacity The number of items, one more than the highest item
+     @param resource The resource the heap is allocated from
+     */
+    QuaternaryHeap(std::pmr::vector<std::uint32_t> &positions,
+                   std::size_t capacity,
+                   std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+    : positions_ {positions},
+    nodes_ {resource}
+    {
+        if (positions_.size() < capacity)
+            positions_.resize(capacity);
+    }
+
+    inline bool empty() const { return nodes_.empty(); }
+    inline std::size_t size() const { return nodes_.size(); }
+
+    /**
+     Checks whether an item is in the heap.
+     @param item The item
+     @return True if the item is in the heap, false otherwise
+     */
+    inline bool Contains(std::uint32_t item) const {
+        auto position {positions_[item]};
+        return position < nodes_.size() && nodes_[position].item_ == item;
+    }
+
+    /**
+     Pushes an item, or lowers its priority if it's already in the heap with a higher one.
+     @param item The item
+     @param priority The priority
+     */
+    inline void push(std::uint32_t item, priority_t priority) {
+        std::size_t position;
+
+        if (Contains(item)) {
+            position = positions_[item];
+            if (!(priority < nodes_[position].priority_))
+                return;
+
+            nodes_[position].priority_ = priority;
+        } else {
+            position = nodes_.size();
+            nodes_.push_back({priority, item});
+        }
+
+        SiftUp(position);
+    }
+
+    inline std::uint32_t pop() {
+        assert(!nodes_.empty());
+
+        auto item {nodes_.front().item_};
+        auto last {nodes_.back()};
+        nodes_.pop_back();
+
+        if (!nodes_.empty()) {
+            nodes_.front() = last;
+            SiftDown(0);
+        }
+
+        return item;
+    }
+
+private:
+    /**
+     A struct holding an item and its priority.
+     */
+    struct Node {
+        priority_t priority_;
+        std::uint32_t item_;
+
+        inline bool operator<(Node const &other) const {
+            return priority_ < other.priority_ || (!(other.priority_ < priority_) && item_ < other.item_);
+        }
+    };
+
+    std::pmr::vector<std::uint32_t> &positions_;    /**< The position of every item in the heap */
+    std::pmr::vector<Node> nodes_;                  /**< The heap */
+
+    inline void Place(std::size_t position, Node const &node) {
+        nodes_[position] = node;
+        positions_[node.item_] = static_cast<std::uint32_t>(position);
+    }
+
+    inline void SiftUp(std::size_t position) {
+        auto node {nodes_[position]};
+
+        while (position > 0) {
+            auto parent {(position - 1) / 4};
+            if (!(node < nodes_[parent]))
+                break;
+
+            Place(position, nodes_[parent]);
+            position = parent;
+        }
+
+        Place(position, node);
+    }
+
+    inline void SiftDown(std::size_t position) {
+        auto node {nodes_[position]};
+
+        while (true) {
+            auto first {position * 4 + 1};
+            if (first >= nodes_.size())
+                break;
+
+            auto best {first};
+            for (auto child {first + 1}; child < std::min(first + 4, nodes_.size()); child++) {
+                if (nodes_[child] < nodes_[best])
+                    best = child;
+            }
+
+            if (!(nodes_[best] < node))
+                break;
+
+            Place(position, nodes_[best]);
+            position = best;
+        }
+
+        Place(position, node);
+    }
+};
+
+}
+
+#endif /* LIBPMG_SEARCH_QUEUE_HPP_ */
@@ -6,8 +6,10 @@
 #ifndef LIBPMG_TAG_MANAGER_HPP_
 #define LIBPMG_TAG_MANAGER_HPP_
 
+#include <mutex>
+#include <string>
 #include <unordered_map>
-#include <vector>
+#include <unordered_set>
 
 #include "tag.hpp"
 #include "taggable.hpp"
@@ -16,7 +18,8 @@ namespace libpmg {
     
     /**
      A singleton class that manager the definition of every tag, and which tiles they are assigned to.
-     It holds an unordered map with a list of Taggable objects for every existing Tag.
+     It holds an unordered map with a set of Taggable objects for every existing Tag.
+     The lists are guarded by a mutex, since maps can be generated by multiple threads at once.
      */
     class TagManager {
         
@@ -49,6 +52,13 @@ namespace libpmg {
          */
         void RemoveTaggable(Taggable *taggable, std::shared_ptr<Tag> tag);
         
+        /**
+         Looks for a tag by name, among the default tags and the tags assigned to any Taggable object.
+         @param name The name of the tag
+         @return A pointer to the tag, or nullptr if no tag has that name
+         */
+        std::shared_ptr<Tag> GetTag(std::string const &name);
+        
         std::shared_ptr<Tag> floor_tag_;     /**< A tag indicating the tile has a floor */
         std::shared_ptr<Tag> wall_tag_;      /**< A tag indicating the tile has a wall */
         std::shared_ptr<Tag> door_tag_;      /**< A tag indicating the tile has a door */
@@ -59,7 +69,8 @@ namespace libpmg {
     private:
         TagManager();
         
-        std::unordered_map<std::shared_ptr<Tag>, std::vector<Taggable*>> tag_map_;      /**< An unordered map with a list of Taggable objects */
+        std::unordered_map<std::shared_ptr<Tag>, std::unordered_set<Taggable*>> tag_map_;   /**< An unordered map with a set of Taggable objects */
+        std::mutex tag_map_mutex_;                                                      /**< Guards tag_map_ */
     };
     
 }
@@ -0,0 +1,151 @@
+/**
+ @file terrain_cost.hpp
+ @author pat <pat@fourthbox.com>
+ */
+
+#ifndef LIBPMG_TERRAIN_COST_HPP_
+#define LIBPMG_TERRAIN_COST_HPP_
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "constants.hpp"
+#include "world_map.hpp"
+#include "world_tile.hpp"
+
+namespace libpmg {
+
+static const std::uint32_t kImpassableCost {std::numeric_limits<std::uint32_t>::max()};
+static const std::uint32_t kTerrainCostUnit {100};
+static const std::size_t kBiomeCount {static_cast<std::size_t>(BiomeType::SNOW) + 1};
+
+/**
+ A struct holding the weights of the terrain of a world map.
+ */
+struct TerrainCostParams {
+    std::array<float, kBiomeCount> biome_costs_;    /**< The cost of entering a tile of every biome, or infinity */
+    float slope_cost_;                              /**< The cost of every unit of altitude between two tiles */
+    float water_level_;                             /**< The altitude under which tiles cannot be entered */
+
+    TerrainCostParams()
+    : slope_cost_ {kDefaultSlopeCost},
+    water_level_ {0.0f}
+    {
+        biome_costs_.fill(1.0f);
+    }
+};
+
+/**
+ A cost function for Utils::WeightedAstar, computing the cost of a move out of the altitude and biome layers of a
+ world map: the cost of entering the biome of the tile, sqrt(2) times as much for diagonal moves, plus the slope
+ between the two tiles. Tiles under the water level cannot be entered.
+ The layers are copied, so the map can be edited or destroyed while the function is in use.
+ */
+class TerrainCost {
+public:
+    /**
+     Reads the layers of a world map.
+     @param map The map
+     @param params The weights of the terrain
+     */
+    TerrainCost(WorldMap &map, TerrainCostParams const &params = {});
+
+    /**
+     Reads dense layers, like the ones of a MapFile.
+     @param altitude The row major altitude of every tile
+     @param biomes The row major BiomeType of every tile
+     @param width The width of the layers
+     @param height The height of the layers
+     @param params The weights of the terrain
+     */
+    TerrainCost(float const *altitude,
+                std::uint8_t const *biomes,
+                std::size_t width,
+                std::size_t height,
+                TerrainCostParams const &params = {});
+
+    /**
+     Computes the cost of a move.
+     @param from The row major index of the tile left
+     @param to The row major index of the tile entered
+     @param diagonal Whether the move is diagonal
+     @return The cost, or infinity if the tile cannot be entered
+     */
+    inline float operator()(std::size_t from, std::size_t to, bool diagonal) const {
+        auto slope {altitude_[to] > altitude_[from] ? altitude_[to] - altitude_[from] : altitude_[from] - altitude_[to]};
+
+        return entry_costs_[to] * (diagonal ? kDiagonalStepCost : 1.0f) + params_.slope_cost_ * slope;
+    }
+
+    /**
+     Builds a layer with the cost of entering every tile, leaving the slope out, for the common case of maps whose
+     slopes don't matter. Being made of integers, the layer can be stored as a MapCache artifact.
+     @return A dense vector holding the cost of entering every tile in hundredths, or kImpassableCost
+     */
+    std::vector<std::uint32_t> BuildLayer() const;
+
+    /**
+     Gets the lowest cost of entering a tile, to scale the heuristic of a search.
+     @return The lowest cost, or 0 if no tile can be entered
+     */
+    float GetLowestCost() const;
+
+    inline std::size_t GetWidth() const { return width_; }
+    inline std::size_t GetHeight() const { return height_; }
+
+private:
+    std::size_t width_;                 /**< The width of the layers */
+    std::size_t height_;                /**< The height of the layers */
+    TerrainCostParams params_;          /**< The weights of the terrain */
+    std::vector<float> altitude_;       /**< The altitude of every tile */
+    std::vector<float> entry_costs_;    /**< The cost of entering every tile, out of its biome and the water level */
+
+    /**
+     Computes the cost of entering every tile.
+     @param biomes The row major BiomeType of every tile
+     */
+    void ComputeEntryCosts(std::uint8_t const *biomes);
+};
+
+/**
+ A cost function for Utils::WeightedAstar, reading a precomputed layer with the cost of entering every tile, like
+ the one built by TerrainCost::BuildLayer. Diagonal moves cost sqrt(2) times as much.
+ The layer is not copied, and must outlive the function.
+ */
+class CostLayer {
+public:
+    /**
+     Reads a layer.
+     @param layer The row major cost of entering every tile in hundredths, or kImpassableCost
+     */
+    CostLayer(std::vector<std::uint32_t> const &layer) : layer_ {layer.data()} {}
+
+    /**
+     Computes the cost of a move.
+     @param to The row major index of the tile entered
+     @param diagonal Whether the move is diagonal
+     @return The cost, or infinity if the tile cannot be entered. It doesn't depend on the tile left
+     */
+    inline float operator()(std::size_t, std::size_t to, bool diagonal) const {
+        if (layer_[to] == kImpassableCost)
+            return std::numeric_limits<float>::infinity();
+
+        return static_cast<float>(layer_[to]) / kTerrainCostUnit * (diagonal ? kDiagonalStepCost : 1.0f);
+    }
+
+    /**
+     Gets the lowest cost of entering a tile of a layer, to scale the heuristic of a search.
+     @param layer The layer
+     @return The lowest cost, or 0 if no tile can be entered
+     */
+    static float GetLowestCost(std::vector<std::uint32_t> const &layer);
+
+private:
+    std::uint32_t const *layer_;        /**< The cost of entering every tile */
+};
+
+}
+
+#endif /* LIBPMG_TERRAIN_COST_HPP_ */
@@ -6,14 +6,25 @@
 #ifndef LIBPMG_UTILS_HPP_
 #define LIBPMG_UTILS_HPP_
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
 #include <queue>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
+#include "constants.hpp"
+#include "log.hpp"
 #include "map.hpp"
+#include "profiler.hpp"
+#include "search_queue.hpp"
 
 namespace libpmg {
 
@@ -23,9 +34,12 @@ namespace libpmg {
 template<typename T, typename priority_t>
 struct PriorityQueue {
     typedef std::pair<priority_t, T> PQElement;
-    std::priority_queue<PQElement, std::vector<PQElement>,
+    std::priority_queue<PQElement, std::pmr::vector<PQElement>,
     std::greater<PQElement>> elements;
     
+    PriorityQueue(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+    : elements {std::greater<PQElement> {}, std::pmr::vector<PQElement> {resource}} {}
+    
     inline bool empty() const { return elements.empty(); }
     
     inline void push(T item, priority_t priority) {
@@ -46,48 +60,125 @@ struct PriorityQueue {
     }
 };
 
+/**
+ A map from every location reached by a search to the location it was reached from.
+ */
+typedef std::pmr::unordered_map<Location*, Location*> LocationMap;
+
+/**
+ A struct holding the tiles explored by a search and its buffers, so that searches only read the map they run on, and
+ any number of them can run on the same map at once, one context per thread.
+ Tiles are marked with the stamp of the search instead of a flag, so that forgetting a search doesn't clear the whole
+ context. Bidirectional searches mark the tiles reached from the end with a stamp of their own.
+ */
+struct SearchContext {
+    std::pmr::vector<std::uint32_t> explored_;  /**< The stamp of the last search that explored every tile */
+    std::pmr::vector<std::uint32_t> parents_;   /**< The tile every explored tile was reached from, for the searches that need it */
+    std::pmr::vector<float> costs_;             /**< The cost of reaching every explored tile, for the searches that need it */
+    std::pmr::vector<std::uint32_t> heap_positions_;   /**< The positions of the tiles in a QuaternaryHeap */
+    std::uint32_t stamp_ {0};                   /**< The stamp of the current search */
+
+    SearchContext(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+    : explored_ {resource},
+    parents_ {resource},
+    costs_ {resource},
+    heap_positions_ {resource} {}
+
+    /**
+     Forgets every tile explored so far.
+     @param size The number of tiles of the map
+     */
+    inline void Reset(std::size_t size) {
+        // Every search takes two stamps, one for the tiles reached from each end
+        if (explored_.size() != size || stamp_ >= std::numeric_limits<std::uint32_t>::max() - 2) {
+            explored_.assign(size, 0);
+            stamp_ = 1;
+        } else {
+            stamp_ += 2;
+        }
+    }
+
+    inline bool IsExplored(std::size_t index, bool backward = false) const { return explored_[index] == stamp_ + backward; }
+    inline void MarkExplored(std::size_t index, bool backward = false) { explored_[index] = stamp_ + backward; }
+};
+
+/**
+ A heuristic estimating the cost between two tiles as the number of cardinal steps between them.
+ It is consistent, never overestimating the cost, when moves are cardinal only and every step costs at least scale_.
+ */
+struct ManhattanHeuristic {
+    float scale_ {1.0f};        /**< The lowest cost of a step */
+
+    inline float operator()(std::size_t dx, std::size_t dy) const { return scale_ * static_cast<float>(dx + dy); }
+};
+
+/**
+ A heuristic estimating the cost between two tiles as the cost of the straight and diagonal steps between them.
+ It is consistent, never overestimating the cost, when diagonal moves are allowed, every cardinal step costs at
+ least scale_ and every diagonal step at least sqrt(2) times as much.
+ */
+struct OctileHeuristic {
+    float scale_ {1.0f};        /**< The lowest cost of a cardinal step */
+
+    inline float operator()(std::size_t dx, std::size_t dy) const {
+        auto low {static_cast<float>(std::min(dx, dy))};
+        auto high {static_cast<float>(std::max(dx, dy))};
+
+        return scale_ * (high + (kDiagonalStepCost - 1.0f) * low);
+    }
+};
+
+/**
+ A heuristic estimating the cost between two tiles as OctileHeuristic when diagonal moves are allowed, and as
+ ManhattanHeuristic otherwise. It is the default of Utils::WeightedAstar, which sets diagonal_ from its move directions.
+ */
+struct DirectionalHeuristic {
+    float scale_ {1.0f};        /**< The lowest cost of a cardinal step */
+    bool diagonal_ {false};     /**< Whether diagonal moves are allowed */
+
+    inline float operator()(std::size_t dx, std::size_t dy) const {
+        return diagonal_ ? OctileHeuristic {scale_}(dx, dy) : ManhattanHeuristic {scale_}(dx, dy);
+    }
+};
+
 /**
  A struct containing utility functions
  */
 struct Utils {
     
     /**
-     Prints debug log informations.
+     Writes a debug message through Log. Prefer Log::Debug where building the message is not free.
      @param message The message to be printed
      */
     static inline void LogDebug(std::string const &message) {
-        
-        printf("%s\n", message.c_str());
+        Log::Write(LogLevel::DEBUG, "", message);
     }
     
     /**
-     Prints debug log informations.
+     Writes a debug message through Log. Prefer Log::Debug where building the message is not free.
      @param context A string indicating the context for better describing the message
      @param message The message to be printed
      */
     static inline void LogDebug(std::string const &context, std::string const &message) {
-        
-        printf("%s:: %s\n", context.c_str(), message.c_str());
+        Log::Write(LogLevel::DEBUG, context.c_str(), message);
     }
     
     /**
-     Prints debug log informations with a warning sign.
+     Writes a warning message through Log.
      @param context A string indicating the context for better describing the message
      @param message The message to be printed
      */
     static inline void LogWarning(std::string const &context, std::string const &message) {
-        
-        printf("[WARNING] %s:: %s\n", context.c_str(), message.c_str());
+        Log::Write(LogLevel::WARNING, context.c_str(), message);
     }
 
     /**
-     Prints debug log informations with an error sign.
+     Writes an error message through Log.
      @param context A string indicating the context for better describing the message
      @param message The message to be printed
      */
     static inline void LogError(std::string const &context, std::string const &message) {
-        
-        printf("[ERROR] %s:: %s\n", context.c_str(), message.c_str());
+        Log::Write(LogLevel::ERROR, context.c_str(), message);
     }
     
     /**
@@ -97,16 +188,62 @@ struct Utils {
      @param map A pointer to the Map where the search is happening
      @param diagonals Whether diagonal paths should be used (compatible with FOUR_DIRECTIONAL, creating a "stair" effect)
      @param dir Whether locations can be connected diagonally
-     @param reset_path_flags Whether path flags should be reset before running the algorithm
+     @param reset_path_flags Whether the tiles explored by the previous search on the same context should be forgotten
+     @param resource The resource the search structures and the returned map are allocated from
+     @param context The context of the search, or nullptr to use a new one. The map is only read, so searches with
+     different contexts can run on the same map at once
      @return A pointer to an unordered map of locations. The key is the location "connected" to the value on the generated path
      */
-    static std::unique_ptr<std::unordered_map<Location*, Location*>>
+    static std::unique_ptr<LocationMap>
     BreadthFirstSearch(std::pair<std::size_t, std::size_t> start_coor,
                        std::pair<std::size_t, std::size_t> end_coor,
                        Map *map,
                        bool diagonals,
                        MoveDirections const &dir,
-                       bool reset_path_flags = true);
+                       bool reset_path_flags = true,
+                       std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+                       SearchContext *context = nullptr);
+    
+    /**
+     A function that uses a bidirectional BFS to find the shortest path between 2 Location on a Map, growing a frontier
+     from both ends, a layer at a time, until they meet. On open maps it expands about half the tiles of
+     BreadthFirstSearch.
+     @param start_coor A pair of coordinats representing the start location
+     @param end_coor A pair of coordinats representing the end location
+     @param map A pointer to the Map where the search is happening
+     @param diagonals Whether diagonal paths should be used (compatible with FOUR_DIRECTIONAL, creating a "stair" effect)
+     @param dir Whether locations can be connected diagonally
+     @param max_expansions The most tiles to expand before giving up, or 0 for no limit
+     @param resource The resource the search structures and the returned map are allocated from
+     @param context The context of the search, or nullptr to use a new one
+     @return A pointer to an unordered map of locations, holding the generated path only. The key is the location
+     "connected" to the value on the path. It is nullptr if the search gives up, in which case LShapedPath can be used
+     instead
+     */
+    static std::unique_ptr<LocationMap>
+    BidirectionalBreadthFirstSearch(std::pair<std::size_t, std::size_t> start_coor,
+                                    std::pair<std::size_t, std::size_t> end_coor,
+                                    Map *map,
+                                    bool diagonals,
+                                    MoveDirections const &dir,
+                                    std::size_t max_expansions = 0,
+                                    std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+                                    SearchContext *context = nullptr);
+    
+    /**
+     A function that builds a straight L shaped path between 2 Location on a Map, moving along the X axis first and
+     along the Y axis then, without searching.
+     @param start_coor A pair of coordinats representing the start location
+     @param end_coor A pair of coordinats representing the end location
+     @param map A pointer to the Map where the path is built
+     @param resource The resource the returned map is allocated from
+     @return A pointer to an unordered map of locations, like the searches, or nullptr if a location is out of the map
+     */
+    static std::unique_ptr<LocationMap>
+    LShapedPath(std::pair<std::size_t, std::size_t> start_coor,
+                std::pair<std::size_t, std::size_t> end_coor,
+                Map *map,
+                std::pmr::memory_resource *resource = std::pmr::get_default_resource());
     
     /**
      A function that uses the Dijkstra algorithm to find the shortest path between 2 Location on a Map.
@@ -114,15 +251,20 @@ struct Utils {
      @param end_coor A pair of coordinats representing the end location
      @param map A pointer to the Map where the search is happening
      @param dir Whether locations can be connected diagonally
-     @param reset_path_flags Whether path flags should be reset before running the algorithm
+     @param reset_path_flags Whether the tiles explored by the previous search on the same context should be forgotten
+     @param resource The resource the search structures and the returned map are allocated from
+     @param context The context of the search, or nullptr to use a new one. The map is only read, so searches with
+     different contexts can run on the same map at once
      @return A pointer to an unordered map of locations. The key is the location "connected" to the value on the generated path
      */
-    static std::unique_ptr<std::unordered_map<Location*, Location*>>
+    static std::unique_ptr<LocationMap>
     Dijkstra(std::pair<std::size_t, std::size_t> start_coor,
              std::pair<std::size_t, std::size_t> end_coor,
              Map *map,
              MoveDirections const &dir,
-             bool reset_path_flags = true);
+             bool reset_path_flags = true,
+             std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+             SearchContext *context = nullptr);
     
     /**
      A function that uses the Astar algorithm to find the shortest path between 2 Location on a Map.
@@ -130,15 +272,50 @@ struct Utils {
      @param end_coor A pair of coordinats representing the end location
      @param map A pointer to the Map where the search is happening
      @param dir Whether locations can be connected diagonally
-     @param reset_path_flags Whether path flags should be reset before running the algorithm
+     @param reset_path_flags Whether the tiles explored by the previous search on the same context should be forgotten
+     @param resource The resource the search structures and the returned map are allocated from
+     @param context The context of the search, or nullptr to use a new one. The map is only read, so searches with
+     different contexts can run on the same map at once
      @return A pointer to an unordered map of locations. The key is the location "connected" to the value on the generated path
      */
-    static std::unique_ptr<std::unordered_map<Location*, Location*>>
+    static std::unique_ptr<LocationMap>
     Astar(std::pair<std::size_t, std::size_t> start_coor,
           std::pair<std::size_t, std::size_t> end_coor,
           Map *map,
           MoveDirections const &dir,
-          bool reset_path_flags = true);
+          bool reset_path_flags = true,
+          std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+          SearchContext *context = nullptr);
+    
+    /**
+     A function that uses the Astar algorithm to find the cheapest path between 2 Location on a Map, with the cost of
+     every move computed by a function instead of read from the tiles.
+     Tiles are closed when they are expanded and never reopened, so the path is the cheapest one only if the heuristic
+     is consistent: the estimate from a tile never exceeds the cost of a move plus the estimate from the next tile.
+     ManhattanHeuristic and OctileHeuristic are, as long as their scale is not higher than the lowest cost of a step,
+     but ManhattanHeuristic only with cardinal moves. The default DirectionalHeuristic picks the one matching dir.
+     @param start_coor A pair of coordinats representing the start location
+     @param end_coor A pair of coordinats representing the end location
+     @param map A pointer to the Map where the search is happening
+     @param dir Whether locations can be connected diagonally
+     @param cost A function returning the cost of a move, given the row major indices of the two tiles and whether
+     the move is diagonal, or infinity if it cannot be made. It is called directly, so that it can be inlined
+     @param heuristic A function estimating the cost between two tiles, given their distance on both axes. The
+     diagonal_ flag of a DirectionalHeuristic is ignored, and taken from dir instead
+     @param resource The resource the search structures and the returned map are allocated from
+     @param context The context of the search, or nullptr to use a new one
+     @return A pointer to an unordered map of locations. The key is the location "connected" to the value on the generated path
+     */
+    template<typename CostFunction, typename Heuristic = DirectionalHeuristic>
+    static std::unique_ptr<LocationMap>
+    WeightedAstar(std::pair<std::size_t, std::size_t> start_coor,
+                  std::pair<std::size_t, std::size_t> end_coor,
+                  Map *map,
+                  MoveDirections const &dir,
+                  CostFunction const &cost,
+                  Heuristic const &heuristic = {},
+                  std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+                  SearchContext *context = nullptr);
     
     /**
      Generates a random unique id.
@@ -147,6 +324,96 @@ struct Utils {
     static std::string GenerateUUID() { return boost::uuids::to_string(boost::uuids::random_generator()()); }
 };
 
+template<typename CostFunction, typename Heuristic>
+std::unique_ptr<LocationMap> Utils::WeightedAstar(std::pair<std::size_t, std::size_t> start_coor,
+                                                  std::pair<std::size_t, std::size_t> end_coor,
+                                                  Map *map,
+                                                  MoveDirections const &dir,
+                                                  CostFunction const &cost,
+                                                  Heuristic const &heuristic,
+                                                  std::pmr::memory_resource *resource,
+                                                  SearchContext *context) {
+    auto start_tile {map->GetTile(start_coor)};
+    auto end_tile {map->GetTile(end_coor)};
+
+    if (start_tile == nullptr || end_tile == nullptr)
+        return nullptr;
+
+    auto &tiles {*map->GetMap()};
+    SearchContext local_context {resource};
+    auto &closed {context != nullptr ? *context : local_context};
+    closed.Reset(tiles.size());
+
+    auto width {map->GetConfigs().map_width_};
+    auto index_of = [=] (Location const *loc) -> std::size_t { return loc->GetY() * width + loc->GetX(); };
+    auto distance = [] (std::size_t a, std::size_t b) { return a > b ? a - b : b - a; };
+
+    // Manhattan distances overestimate diagonal paths, so the search would miss the cheapest one
+    assert(!(std::is_same_v<Heuristic, ManhattanHeuristic> && dir == MoveDirections::EIGHT_DIRECTIONAL));
+
+    DirectionalHeuristic directional {};
+    if constexpr (std::is_same_v<Heuristic, DirectionalHeuristic>)
+        directional = {heuristic.scale_, dir == MoveDirections::EIGHT_DIRECTIONAL};
+
+    auto estimate = [&] (Location const *loc) -> float {
+        auto dx {distance(loc->GetX(), end_tile->GetX())};
+        auto dy {distance(loc->GetY(), end_tile->GetY())};
+
+        if constexpr (std::is_same_v<Heuristic, DirectionalHeuristic>)
+            return directional(dx, dy);
+        else
+            return heuristic(dx, dy);
+    };
+
+    // Costs are only read for the tiles in the frontier or closed by this search, so they are never cleared
+    auto &costs {closed.costs_};
+    costs.resize(tiles.size());
+
+    QuaternaryHeap<float> frontier {closed.heap_positions_, tiles.size(), resource};
+    auto came_from {std::make_unique<LocationMap>(resource)};
+    Tile *neighbors[8];
+
+    costs[index_of(start_tile)] = 0.0f;
+    frontier.push(static_cast<std::uint32_t>(index_of(start_tile)), estimate(start_tile));
+
+    std::uint64_t expanded {0};
+
+    while (!frontier.empty()) {
+        auto index {frontier.pop()};
+        closed.MarkExplored(index);
+        expanded++;
+
+        Location *current {tiles[index].get()};
+        if (current == end_tile) {
+            Profiler::Count("nodes_expanded", expanded);
+            return came_from;
+        }
+
+        for (std::size_t n {0}, count {map->GetNeighbors(current, dir, neighbors)}; n < count; n++) {
+            Location *nei {neighbors[n]};
+            auto nei_index {static_cast<std::uint32_t>(index_of(nei))};
+
+            if (closed.IsExplored(nei_index))
+                continue;
+
+            auto diagonal {nei->GetX() != current->GetX() && nei->GetY() != current->GetY()};
+            auto new_cost {costs[index] + cost(index, nei_index, diagonal)};
+
+            // Moves that cannot be made cost infinity. Tiles already in the frontier are moved up when a cheaper way
+            // is found
+            if (new_cost < std::numeric_limits<float>::infinity() &&
+                (!frontier.Contains(nei_index) || new_cost < costs[nei_index])) {
+                costs[nei_index] = new_cost;
+                (*came_from)[nei] = current;
+                frontier.push(nei_index, new_cost + estimate(nei));
+            }
+        }
+    }
+
+    Profiler::Count("nodes_expanded", expanded);
+    return nullptr;
+}
+
 }
 
 #endif /* LIBPMG_UTILS_HPP_ */
@@ -108,6 +108,12 @@ public:
      */
     std::unique_ptr<Map> &Build() override;
     
+    /**
+     Gets the configs set so far. They can be read before initializing the map, for example to compute a MapCache key.
+     @return A reference to the configs
+     */
+    inline WorldMapConfigs const &GetConfigs() { return (WorldMapConfigs&)map_->GetConfigs(); }
+    
 private:
     std::unique_ptr<Map> map_;
     std::unique_ptr<std::unique_ptr<float[]>[]> height_map_;
@@ -43,8 +43,14 @@ public:
 class WorldMap : public Map {
 
 public:
-    WorldMap() {}
+    WorldMap();
     WorldMap(std::shared_ptr<WorldMap> other);
+    
+    /**
+     Initializes the WorldMap and setup new configs
+     @param configs The config file to copy
+     */
+    WorldMap(MapConfigs &configs);
     ~WorldMap() {}
     
     /**
@@ -32,10 +32,12 @@ class WorldTile : public Tile {
     
 public:
     friend class WorldBuilder;
+    friend class MapFile;
     
-    WorldTile (std::size_t x, std::size_t y) : Tile (x, y) {}
+    WorldTile (std::size_t x, std::size_t y) : Tile (x, y), altitude_ {0.0f}, temperature_ {0.0f}, biome_ {BiomeType::DEEP_SEA} {}
     
     inline float GetAltitude() { return altitude_; }
+    inline BiomeType GetBiome() { return biome_; }
     
 private:
     float altitude_, temperature_;
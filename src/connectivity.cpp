@@ -0,0 +1,247 @@
+#include "connectivity.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "neighbor_mask.hpp"
+
+namespace libpmg {
+
+std::vector<std::uint32_t> Connectivity::LabelComponents(std::vector<std::uint8_t> const &walkable,
+                                                         std::size_t width,
+                                                         std::size_t height,
+                                                         MoveDirections const &dir,
+                                                         std::size_t &components) {
+    std::vector<std::uint32_t> labels(width * height, kNoComponent);
+    
+    // The union-find forest of the provisional labels. Label 0 is kNoComponent
+    std::vector<std::uint32_t> parent {kNoComponent};
+    
+    auto find = [&] (std::uint32_t label) -> std::uint32_t {
+        while (parent[label] != label) {
+            parent[label] = parent[parent[label]];
+            label = parent[label];
+        }
+        return label;
+    };
+    
+    auto merge = [&] (std::uint32_t label, std::uint32_t other) -> std::uint32_t {
+        if (other == kNoComponent)
+            return label;
+        if (label == kNoComponent)
+            return find(other);
+        
+        auto root {find(label)};
+        auto other_root {find(other)};
+        
+        // Keep the smallest root, so that labels end up sorted by their first tile
+        if (other_root < root)
+            std::swap(root, other_root);
+        parent[other_root] = root;
+        
+        return root;
+    };
+    
+    // First pass: assign a provisional label to every tile, looking only at the neighbours already visited
+    for (std::size_t y {0}; y < height; y++) {
+        for (std::size_t x {0}; x < width; x++) {
+            auto i {y * width + x};
+            
+            if (!walkable[i])
+                continue;
+            
+            std::uint32_t label {kNoComponent};
+            
+            if (x > 0)
+                label = merge(label, labels[i - 1]);
+            if (y > 0)
+                label = merge(label, labels[i - width]);
+            
+            if (dir == MoveDirections::EIGHT_DIRECTIONAL && y > 0) {
+                if (x > 0)
+                    label = merge(label, labels[i - width - 1]);
+                if (x + 1 < width)
+                    label = merge(label, labels[i - width + 1]);
+            }
+            
+            if (label == kNoComponent) {
+                label = static_cast<std::uint32_t>(parent.size());
+                parent.push_back(label);
+            }
+            
+            labels[i] = label;
+        }
+    }
+    
+    // Second pass: replace every provisional label with a compact component number
+    std::vector<std::uint32_t> compact(parent.size(), kNoComponent);
+    components = 0;
+    
+    for (auto &label : labels) {
+        if (label == kNoComponent)
+            continue;
+        
+        auto root {find(label)};
+        if (compact[root] == kNoComponent)
+            compact[root] = static_cast<std::uint32_t>(++components);
+        
+        label = compact[root];
+    }
+    
+    return labels;
+}
+
+void Connectivity::RepairComponents(std::vector<std::uint8_t> const &walkable,
+                                    std::size_t width,
+                                    std::size_t height,
+                                    MoveDirections const &dir,
+                                    std::vector<std::size_t> const &changed,
+                                    std::vector<std::uint32_t> &labels,
+                                    std::size_t &components) {
+    auto neighbours {dir == MoveDirections::EIGHT_DIRECTIONAL ? 8 : 4};
+
+    auto for_each_neighbour = [&] (std::size_t index, auto const &function) {
+        auto x {index % width};
+        auto y {index / width};
+
+        for (auto n {0}; n < neighbours; n++) {
+            auto nx {x + kNeighborOffsets[n][0]};
+            auto ny {y + kNeighborOffsets[n][1]};
+
+            if (nx < width && ny < height)
+                function(ny * width + nx);
+        }
+    };
+
+    // Floods the walkable tiles connected to a tile, calling a function on each of them
+    std::vector<std::size_t> frontier;
+    auto flood = [&] (std::size_t start, auto const &accept, auto const &function) {
+        frontier.assign(1, start);
+        function(start);
+
+        for (std::size_t head {0}; head < frontier.size(); head++) {
+            for_each_neighbour(frontier[head], [&] (std::size_t nei) {
+                if (walkable[nei] && accept(nei)) {
+                    function(nei);
+                    frontier.push_back(nei);
+                }
+            });
+        }
+    };
+
+    // Removed tiles: flood the parts of their components again, from the tiles around them
+    std::vector<std::size_t> seeds;
+
+    for (auto index : changed) {
+        if (walkable[index] || labels[index] == kNoComponent)
+            continue;
+
+        labels[index] = kNoComponent;
+        for_each_neighbour(index, [&] (std::size_t nei) {
+            if (walkable[nei] && labels[nei] != kNoComponent)
+                seeds.push_back(nei);
+        });
+    }
+
+    if (!seeds.empty()) {
+        std::unordered_set<std::size_t> visited;
+        std::unordered_set<std::uint32_t> claimed;
+        std::vector<std::size_t> part;
+
+        for (auto seed : seeds) {
+            if (visited.count(seed))
+                continue;
+
+            part.clear();
+            flood(seed,
+                  [&] (std::size_t nei) { return visited.insert(nei).second; },
+                  [&] (std::size_t tile) { visited.insert(tile); part.push_back(tile); });
+
+            // The first part of every component keeps its label
+            auto label {kNoComponent};
+            for (auto tile : part) {
+                if (labels[tile] != kNoComponent && !claimed.count(labels[tile])) {
+                    label = labels[tile];
+                    break;
+                }
+            }
+
+            if (label == kNoComponent)
+                label = static_cast<std::uint32_t>(++components);
+
+            claimed.insert(label);
+            for (auto tile : part)
+                labels[tile] = label;
+        }
+    }
+
+    // Added tiles: join the components around them
+    for (auto index : changed) {
+        if (!walkable[index] || labels[index] != kNoComponent)
+            continue;
+
+        auto label {kNoComponent};
+        for_each_neighbour(index, [&] (std::size_t nei) {
+            if (!walkable[nei] || labels[nei] == kNoComponent || labels[nei] == label)
+                return;
+
+            if (label == kNoComponent) {
+                label = labels[nei];
+                return;
+            }
+
+            auto merged {labels[nei]};
+            flood(nei,
+                  [&] (std::size_t tile) { return labels[tile] == merged; },
+                  [&] (std::size_t tile) { labels[tile] = label; });
+        });
+
+        labels[index] = label != kNoComponent ? label : static_cast<std::uint32_t>(++components);
+    }
+}
+
+std::vector<std::uint32_t> Connectivity::DistanceField(std::vector<std::uint8_t> const &walkable,
+                                                       std::size_t width,
+                                                       std::size_t height,
+                                                       std::vector<std::size_t> const &sources,
+                                                       MoveDirections const &dir) {
+    std::vector<std::uint32_t> distances(width * height, kUnreachableDistance);
+    
+    // Every tile is pushed once at most, so a flat vector works as the BFS queue
+    std::vector<std::size_t> frontier;
+    frontier.reserve(width * height);
+    
+    for (auto const &source : sources) {
+        if (source < distances.size() && walkable[source] && distances[source] != 0) {
+            distances[source] = 0;
+            frontier.push_back(source);
+        }
+    }
+    
+    auto neighbours {dir == MoveDirections::EIGHT_DIRECTIONAL ? 8 : 4};
+    
+    for (std::size_t head {0}; head < frontier.size(); head++) {
+        auto current {frontier[head]};
+        auto x {current % width};
+        auto y {current / width};
+        
+        for (auto n {0}; n < neighbours; n++) {
+            auto nx {x + kNeighborOffsets[n][0]};
+            auto ny {y + kNeighborOffsets[n][1]};
+            
+            if (nx >= width || ny >= height)
+                continue;
+            
+            auto nei {ny * width + nx};
+            if (!walkable[nei] || distances[nei] != kUnreachableDistance)
+                continue;
+            
+            distances[nei] = distances[current] + 1;
+            frontier.push_back(nei);
+        }
+    }
+    
+    return distances;
+}
+
+}
@@ -0,0 +1,377 @@
+#include "dijkstra_map.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+#include "neighbor_mask.hpp"
+#include "parallel.hpp"
+#include "tag_manager.hpp"
+#include "utils.hpp"
+
+namespace libpmg {
+
+DijkstraMap::DijkstraMap(Map &map, MoveDirections const &dir)
+: DijkstraMap({}, map.GetConfigs().map_width_, map.GetConfigs().map_height_, dir)
+{
+    ReadCosts(map);
+
+    from_map_ = true;
+    revision_ = map.GetRevision();
+}
+
+DijkstraMap::DijkstraMap(std::vector<std::uint8_t> costs, std::size_t width, std::size_t height, MoveDirections const &dir)
+: costs_ {std::move(costs)},
+width_ {width},
+height_ {height},
+dir_ {dir},
+max_cost_ {1},
+distances_(width * height, kUnreachableDistance),
+from_map_ {false},
+revision_ {0},
+full_update_ {true}
+{
+    // The map constructor fills the costs later
+    if (costs_.empty())
+        costs_.resize(width * height, 0);
+
+    assert(costs_.size() == width * height);
+
+    for (auto cost : costs_)
+        max_cost_ = std::max(max_cost_, cost);
+}
+
+void DijkstraMap::SetSources(std::vector<std::size_t> const &sources) {
+    sources_.clear();
+    added_.clear();
+    removed_.clear();
+
+    for (auto source : sources)
+        AddSource(source);
+
+    full_update_ = true;
+}
+
+void DijkstraMap::AddSource(std::size_t source) {
+    if (source >= costs_.size() || costs_[source] == 0) {
+        Utils::LogWarning("DijkstraMap::AddSource", "The source cannot be walked. Skipping...");
+        return;
+    }
+
+    if (std::find(sources_.begin(), sources_.end(), source) != sources_.end())
+        return;
+
+    sources_.push_back(source);
+    added_.push_back(source);
+}
+
+void DijkstraMap::RemoveSource(std::size_t source) {
+    auto it {std::find(sources_.begin(), sources_.end(), source)};
+
+    if (it == sources_.end()) {
+        Utils::LogWarning("DijkstraMap::RemoveSource", "The source does not exist. Skipping...");
+        return;
+    }
+
+    sources_.erase(it);
+
+    // A source added since the last update has not spread yet, so there is nothing to clear
+    auto added {std::find(added_.begin(), added_.end(), source)};
+    if (added != added_.end())
+        added_.erase(added);
+    else
+        removed_.push_back(source);
+}
+
+void DijkstraMap::MoveSource(std::size_t from, std::size_t to) {
+    RemoveSource(from);
+    AddSource(to);
+}
+
+void DijkstraMap::SetCost(std::size_t index, std::uint8_t cost) {
+    assert(index < costs_.size());
+
+    if (costs_[index] == cost)
+        return;
+
+    if (cost == 0 && std::find(sources_.begin(), sources_.end(), index) != sources_.end())
+        RemoveSource(index);
+
+    changed_.emplace_back(static_cast<std::uint32_t>(index), costs_[index]);
+    costs_[index] = cost;
+    max_cost_ = std::max(max_cost_, cost);
+}
+
+void DijkstraMap::Sync(Map &map) {
+    if (!from_map_) {
+        Utils::LogWarning("DijkstraMap::Sync", "The field was not built from a map. Skipping...");
+        return;
+    }
+
+    std::vector<Rect> regions;
+
+    // The map dropped some of the areas, so read every tile again
+    if (!map.GetDirtyRegions(revision_, regions)) {
+        ReadCosts(map);
+        changed_.clear();
+        full_update_ = true;
+        revision_ = map.GetRevision();
+        return;
+    }
+
+    auto wall {TagManager::GetInstance().wall_tag_};
+
+    for (auto const &rect : regions) {
+        for (auto y {rect.GetY()}; y < rect.GetY() + rect.GetHeight(); y++) {
+            for (auto x {rect.GetX()}; x < rect.GetX() + rect.GetWidth(); x++)
+                SetCost(y * width_ + x, map.GetTile(x, y)->HasTag(wall) ? 0 : 1);
+        }
+    }
+
+    revision_ = map.GetRevision();
+}
+
+void DijkstraMap::Update() {
+    if (full_update_) {
+        std::fill(distances_.begin(), distances_.end(), kUnreachableDistance);
+
+        added_ = sources_;
+        removed_.clear();
+        changed_.clear();
+        full_update_ = false;
+    }
+
+    if (added_.empty() && removed_.empty() && changed_.empty())
+        return;
+
+    // Removed sources, and tiles that got more expensive, lose their distance together with the tiles depending on them
+    std::vector<std::uint32_t> cleared;
+    std::vector<std::uint32_t> cheaper;
+
+    for (auto source : removed_) {
+        if (distances_[source] == 0)
+            cleared.push_back(static_cast<std::uint32_t>(source));
+    }
+
+    for (auto const &change : changed_) {
+        auto old_cost {change.second};
+        auto new_cost {costs_[change.first]};
+
+        if (old_cost != 0 && (new_cost == 0 || new_cost > old_cost)) {
+            if (distances_[change.first] != 0 && distances_[change.first] != kUnreachableDistance)
+                cleared.push_back(change.first);
+        } else {
+            cheaper.push_back(change.first);
+        }
+    }
+
+    Invalidate(cleared);
+
+    // The tiles around the cleared and cheaper ones keep their distance, and spread it again
+    auto neighbours {dir_ == MoveDirections::EIGHT_DIRECTIONAL ? 8 : 4};
+    std::vector<std::uint32_t> seeds;
+
+    for (auto const &list : {&cleared, &cheaper}) {
+        for (auto current : *list) {
+            auto x {current % width_};
+            auto y {current / width_};
+
+            for (auto n {0}; n < neighbours; n++) {
+                auto nx {x + kNeighborOffsets[n][0]};
+                auto ny {y + kNeighborOffsets[n][1]};
+
+                if (nx >= width_ || ny >= height_)
+                    continue;
+
+                auto nei {static_cast<std::uint32_t>(ny * width_ + nx)};
+                if (distances_[nei] != kUnreachableDistance)
+                    seeds.push_back(nei);
+            }
+        }
+    }
+
+    for (auto source : added_) {
+        distances_[source] = 0;
+        seeds.push_back(static_cast<std::uint32_t>(source));
+    }
+
+    added_.clear();
+    removed_.clear();
+    changed_.clear();
+
+    Propagate(seeds);
+}
+
+void DijkstraMap::UpdateAll(std::vector<DijkstraMap*> const &maps, std::size_t threads) {
+    Parallel::ForEachIndex(maps.size(), threads, [&] (std::size_t map, std::size_t) {
+        maps[map]->Update();
+    });
+}
+
+std::size_t DijkstraMap::GetNextStep(std::size_t index) const {
+    auto x {index % width_};
+    auto y {index / width_};
+    auto neighbours {dir_ == MoveDirections::EIGHT_DIRECTIONAL ? 8 : 4};
+    auto next {index};
+
+    for (auto n {0}; n < neighbours; n++) {
+        auto nx {x + kNeighborOffsets[n][0]};
+        auto ny {y + kNeighborOffsets[n][1]};
+
+        if (nx >= width_ || ny >= height_)
+            continue;
+
+        auto nei {ny * width_ + nx};
+        if (distances_[nei] < distances_[next])
+            next = nei;
+    }
+
+    return next;
+}
+
+std::vector<std::uint32_t> DijkstraMap::ComputeFlowField(std::size_t threads) const {
+    std::vector<std::uint32_t> flow(distances_.size());
+
+    threads = Parallel::GetThreads(threads, height_);
+
+    // Every thread takes a band of rows, since every tile only reads the field
+    Parallel::ForEachIndex(threads, threads, [&] (std::size_t band, std::size_t) {
+        auto first_row {height_ * band / threads};
+        auto last_row {height_ * (band + 1) / threads};
+
+        for (auto i {first_row * width_}; i < last_row * width_; i++)
+            flow[i] = static_cast<std::uint32_t>(GetNextStep(i));
+    });
+
+    return flow;
+}
+
+void DijkstraMap::ReadCosts(Map &map) {
+    auto layer {map.GetTagLayer({TagManager::GetInstance().wall_tag_})};
+
+    for (std::size_t i {0}; i < layer.size(); i++)
+        costs_[i] = layer[i] == 0 ? 1 : 0;
+
+    max_cost_ = 1;
+}
+
+bool DijkstraMap::IsSupported(std::uint32_t index) const {
+    auto x {index % width_};
+    auto y {index / width_};
+    auto neighbours {dir_ == MoveDirections::EIGHT_DIRECTIONAL ? 8 : 4};
+
+    for (auto n {0}; n < neighbours; n++) {
+        auto nx {x + kNeighborOffsets[n][0]};
+        auto ny {y + kNeighborOffsets[n][1]};
+
+        if (nx >= width_ || ny >= height_)
+            continue;
+
+        auto nei {ny * width_ + nx};
+        if (distances_[nei] != kUnreachableDistance && distances_[nei] + costs_[index] == distances_[index])
+            return true;
+    }
+
+    return false;
+}
+
+void DijkstraMap::Invalidate(std::vector<std::uint32_t> &cleared) {
+    auto neighbours {dir_ == MoveDirections::EIGHT_DIRECTIONAL ? 8 : 4};
+
+    for (auto current : cleared)
+        distances_[current] = kUnreachableDistance;
+
+    // Every time a tile is cleared, its neighbours may have lost the last tile accounting for their distance.
+    // Distances strictly grow along a move, so the chains of support always end in a source
+    for (std::size_t head {0}; head < cleared.size(); head++) {
+        auto x {cleared[head] % width_};
+        auto y {cleared[head] / width_};
+
+        for (auto n {0}; n < neighbours; n++) {
+            auto nx {x + kNeighborOffsets[n][0]};
+            auto ny {y + kNeighborOffsets[n][1]};
+
+            if (nx >= width_ || ny >= height_)
+                continue;
+
+            auto nei {static_cast<std::uint32_t>(ny * width_ + nx)};
+            if (distances_[nei] == kUnreachableDistance || distances_[nei] == 0 || IsSupported(nei))
+                continue;
+
+            distances_[nei] = kUnreachableDistance;
+            cleared.push_back(nei);
+        }
+    }
+}
+
+void DijkstraMap::Propagate(std::vector<std::uint32_t> &seeds) {
+    // Seeds are injected in order of distance, as the queue reaches them
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> pending_seeds;
+    pending_seeds.reserve(seeds.size());
+
+    for (auto seed : seeds)
+        pending_seeds.emplace_back(distances_[seed], seed);
+
+    std::sort(pending_seeds.begin(), pending_seeds.end());
+
+    if (pending_seeds.empty())
+        return;
+
+    // Every move costs max_cost_ at most, so the pending tiles always fit in max_cost_ + 1 buckets, reused in a ring
+    std::vector<std::vector<std::uint32_t>> buckets(max_cost_ + 1);
+    auto neighbours {dir_ == MoveDirections::EIGHT_DIRECTIONAL ? 8 : 4};
+    auto distance {pending_seeds.front().first};
+    std::size_t next_seed {0};
+    std::size_t pending {0};
+
+    while (true) {
+        for (; next_seed < pending_seeds.size() && pending_seeds[next_seed].first <= distance; next_seed++) {
+            buckets[distance % buckets.size()].push_back(pending_seeds[next_seed].second);
+            pending++;
+        }
+
+        auto &bucket {buckets[distance % buckets.size()]};
+
+        for (std::size_t i {0}; i < bucket.size(); i++) {
+            auto current {bucket[i]};
+            pending--;
+
+            // Tiles are pushed again every time their distance drops, so skip the stale entries
+            if (distances_[current] != distance)
+                continue;
+
+            auto x {current % width_};
+            auto y {current / width_};
+
+            for (auto n {0}; n < neighbours; n++) {
+                auto nx {x + kNeighborOffsets[n][0]};
+                auto ny {y + kNeighborOffsets[n][1]};
+
+                if (nx >= width_ || ny >= height_)
+                    continue;
+
+                auto nei {ny * width_ + nx};
+                if (costs_[nei] == 0)
+                    continue;
+
+                auto new_distance {distance + costs_[nei]};
+                if (new_distance < distances_[nei]) {
+                    distances_[nei] = new_distance;
+                    buckets[new_distance % buckets.size()].push_back(static_cast<std::uint32_t>(nei));
+                    pending++;
+                }
+            }
+        }
+
+        bucket.clear();
+
+        if (pending > 0)
+            distance++;
+        else if (next_seed < pending_seeds.size())
+            distance = pending_seeds[next_seed].first;
+        else
+            break;
+    }
+}
+
+}
@@ -1,5 +1,6 @@
 #include "dungeon_builder.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <queue>
 
@@ -9,19 +10,55 @@
 #define UPSTAIRS_TAG_ TagManager::GetInstance().upstairs_tag_
 #define DOWNSTAIRS_TAG_ TagManager::GetInstance().downstairs_tag_
 
+#include "connectivity.hpp"
 #include "constants.hpp"
 #include "dungeon_map.hpp"
+#include "index_sampler.hpp"
+#include "neighbor_mask.hpp"
+#include "profiler.hpp"
 #include "rnd_manager.hpp"
+#include "scratch_arena.hpp"
 #include "utils.hpp"
 
 namespace libpmg {
     
 typedef std::shared_ptr<Tag> Tag_p;
-typedef std::unique_ptr<std::unordered_map<Location*, Location*>> LocationMap_up;
+typedef std::unique_ptr<LocationMap> LocationMap_up;
+
+/**
+ The bits of the dense layer scanned while placing doors and stairs.
+ */
+enum ScanBit : std::uint32_t {
+    kScanFloor      = 1 << 0,
+    kScanWall       = 1 << 1,
+    kScanDoor       = 1 << 2,
+    kScanUpstairs   = 1 << 3,
+    kScanDownstairs = 1 << 4,
+    kScanRoom       = 1 << 5
+};
+
+/**
+ Packs the floor, wall, door and stair tags of a dungeon map into a dense layer, and flags every room tile.
+ @param map The dungeon map
+ @return A dense, row major layer of ScanBit values
+ */
+static std::vector<std::uint32_t> GetScanLayer(DungeonMap *map) {
+    auto layer {map->GetTagLayer({FLOOR_TAG_, WALL_TAG_, DOOR_TAG_, UPSTAIRS_TAG_, DOWNSTAIRS_TAG_})};
+    auto const &regions {map->GetRegionLayer()};
+    
+    for (std::size_t i {0}; i < regions.size(); i++) {
+        if (regions[i] != kNoRegion && !(regions[i] & kCorridorRegion))
+            layer[i] |= kScanRoom;
+    }
+    
+    return layer;
+}
     
 DungeonBuilder::DungeonBuilder()
 : default_path_algorithm_ {PathAlgorithm::ASTAR_BFS_MIX},
-allow_diagonal_corridors_ {true} {
+allow_diagonal_corridors_ {true},
+corridor_search_limit_ {0},
+scratch_resource_ {std::pmr::get_default_resource()} {
     map_ = std::make_unique<DungeonMap>();
     
     assert(map_->GetMap()->empty());
@@ -48,6 +85,16 @@ void DungeonBuilder::SetDiagonalCorridors(bool allow) {
     allow_diagonal_corridors_ = allow;
 }
 
+void DungeonBuilder::SetCorridorSearchLimit(std::size_t expansions) {
+    assert (map_->GetMap()->empty());
+
+    corridor_search_limit_ = expansions;
+}
+
+void DungeonBuilder::SetScratchResource(std::pmr::memory_resource *resource) {
+    scratch_resource_ = resource != nullptr ? resource : std::pmr::get_default_resource();
+}
+
 void DungeonBuilder::SetMapSize(size_t width, size_t height) {
     assert (map_->GetMap()->empty());
 
@@ -108,6 +155,15 @@ void DungeonBuilder::ConnectRooms(Room const &room1, Room const &room2) {
     Location *start {map_->GetTile(room1.GetRndCoords())};
     Location *end {map_->GetTile(room2.GetRndCoords())};
     
+    ConnectLocations(start, end);
+}
+
+void DungeonBuilder::ConnectLocations(Location *start, Location *end) {
+    Profiler::Count("searches");
+    
+    // The search structures are freed as soon as the corridor is dug, so that an arena doesn't grow with every search
+    ScratchScope scope {scratch_resource_};
+    
     LocationMap_up path {nullptr};
     switch (default_path_algorithm_) {
         case PathAlgorithm::BREADTH_FIRST_SEARCH:
@@ -116,21 +172,46 @@ void DungeonBuilder::ConnectRooms(Room const &room1, Room const &room2) {
                                              end->GetXY(),
                                              map_.get(),
                                              IsDiagonalCorridor(),
-                                             MoveDirections::FOUR_DIRECTIONAL);
+                                             MoveDirections::FOUR_DIRECTIONAL,
+                                             true,
+                                             scratch_resource_,
+                                             &search_context_);
             break;
         case PathAlgorithm::DIJKSTRA:
             path = Utils::Dijkstra(
                                    start->GetXY(),
                                    end->GetXY(),
                                    map_.get(),
-                                   MoveDirections::FOUR_DIRECTIONAL);
+                                   MoveDirections::FOUR_DIRECTIONAL,
+                                   true,
+                                   scratch_resource_,
+                                   &search_context_);
             break;
         case PathAlgorithm::ASTAR:
             path = Utils::Astar(
                                 start->GetXY(),
                                 end->GetXY(),
                                 map_.get(),
-                                MoveDirections::FOUR_DIRECTIONAL);
+                                MoveDirections::FOUR_DIRECTIONAL,
+                                true,
+                                scratch_resource_,
+                                &search_context_);
+            break;
+        case PathAlgorithm::BIDIRECTIONAL_BREADTH_FIRST_SEARCH:
+            path = Utils::BidirectionalBreadthFirstSearch(
+                                                          start->GetXY(),
+                                                          end->GetXY(),
+                                                          map_.get(),
+                                                          IsDiagonalCorridor(),
+                                                          MoveDirections::FOUR_DIRECTIONAL,
+                                                          corridor_search_limit_,
+                                                          scratch_resource_,
+                                                          &search_context_);
+            
+            if (path == nullptr) {
+                Profiler::Count("search_fallbacks");
+                path = Utils::LShapedPath(start->GetXY(), end->GetXY(), map_.get(), scratch_resource_);
+            }
             break;
         case PathAlgorithm::ASTAR_BFS_MIX:
         default:
@@ -139,14 +220,20 @@ void DungeonBuilder::ConnectRooms(Room const &room1, Room const &room2) {
                                     start->GetXY(),
                                     end->GetXY(),
                                     map_.get(),
-                                    MoveDirections::FOUR_DIRECTIONAL);
+                                    MoveDirections::FOUR_DIRECTIONAL,
+                                    true,
+                                    scratch_resource_,
+                                    &search_context_);
             else
                 path = Utils::BreadthFirstSearch(
                                                  start->GetXY(),
                                                  end->GetXY(),
                                                  map_.get(),
                                                  IsDiagonalCorridor(),
-                                                 MoveDirections::FOUR_DIRECTIONAL);
+                                                 MoveDirections::FOUR_DIRECTIONAL,
+                                                 true,
+                                                 scratch_resource_,
+                                                 &search_context_);
             break;
     }
     
@@ -154,33 +241,37 @@ void DungeonBuilder::ConnectRooms(Room const &room1, Room const &room2) {
     
     // Returns the Location from which coords it come from
     auto calculate_from_where = [=] (Location *coords, LocationMap_up &came_from) -> Location* {
-        for (auto const &kv : *came_from) {
-            if (kv.first == coords)
-                return kv.second;
-        }
+        if (auto from {came_from->find(coords)}; from != came_from->end())
+            return from->second;
         
         Utils::LogError("Astar", "Broken path");
         abort();
     };
     
-    // Flags the generated corridor with the proper tags
+    // Flags the generated corridor with the proper tags, and labels it in the region layer
+    std::vector<std::size_t> corridor;
     while (end != start) {
         map_->GetTile(end->GetXY())->UpdateTags({FLOOR_TAG_}, {WALL_TAG_});
+        corridor.push_back(end->GetY() * map_->GetConfigs().map_width_ + end->GetX());
         end = calculate_from_where(end, path);
     }
     
+    ((DungeonMap*)map_.get())->AddCorridor(corridor);
+    
     // Applies a cost to every tile in a room or a corridor, and to their neighbors, in order to
     // avoid corridors intersecating too much
+    Tile *neighbors[8];
     for (auto const &tile : *map_->GetMap()){
         if (tile->Taggable::HasTag(FLOOR_TAG_)) {
             tile->path_cost_ = kDefaultWallTileCost;
-            for (auto const &nei : map_->GetNeighbors(tile.get(), MoveDirections::EIGHT_DIRECTIONAL))
-                nei->path_cost_ = kDefaultWallTileCost;
+            for (std::size_t n {0}, count {map_->GetNeighbors(tile.get(), MoveDirections::EIGHT_DIRECTIONAL, neighbors)}; n < count; n++)
+                neighbors[n]->path_cost_ = kDefaultWallTileCost;
         }
     }
 }
 
 void DungeonBuilder::GenerateCorridors() {
+    ScopedPhase phase {map_->GetMetrics(), "GenerateCorridors"};
     auto dungeon_map {(DungeonMap*)map_.get()};
     
     if (dungeon_map->GetRoomList().empty() || map_->GetMap()->empty()) {
@@ -192,13 +283,133 @@ void DungeonBuilder::GenerateCorridors() {
         ConnectRooms(*dungeon_map->GetRoomList().at(i), *dungeon_map->GetRoomList().at(i + 1));
     
     // In case of odd rooms
-    if (dungeon_map->GetRoomList().size()%2 != 0)
+    if (dungeon_map->GetRoomList().size()%2 != 0 && dungeon_map->GetRoomList().size() > 1)
         ConnectRooms(
                      *dungeon_map->GetRoomList().at(dungeon_map->GetRoomList().size()-2),
                      *dungeon_map->GetRoomList().at(dungeon_map->GetRoomList().size()-1));
 }
     
+ConnectivityReport DungeonBuilder::AnalyzeConnectivity() {
+    auto dungeon_map {(DungeonMap*)map_.get()};
+    auto width {map_->GetConfigs().map_width_};
+    auto height {map_->GetConfigs().map_height_};
+    
+    ConnectivityReport report;
+    
+    // Every tile without walls is walkable
+    auto layer {GetScanLayer(dungeon_map)};
+    std::vector<std::uint8_t> walkable(layer.size());
+    std::vector<std::size_t> upstairs;
+    
+    for (std::size_t i {0}; i < layer.size(); i++) {
+        walkable[i] = !(layer[i] & kScanWall);
+        
+        if (layer[i] & kScanUpstairs)
+            upstairs.push_back(i);
+    }
+    
+    report.components_ = Connectivity::LabelComponents(walkable,
+                                                       width,
+                                                       height,
+                                                       MoveDirections::FOUR_DIRECTIONAL,
+                                                       report.component_count_);
+    
+    // The main component is the one holding the first upstairs, or the largest one
+    report.main_component_ = kNoComponent;
+    
+    if (!upstairs.empty()) {
+        report.main_component_ = report.components_[upstairs.front()];
+    } else if (report.component_count_ > 0) {
+        std::vector<std::size_t> sizes(report.component_count_ + 1, 0);
+        for (auto const &component : report.components_)
+            sizes[component]++;
+        
+        sizes[kNoComponent] = 0;
+        report.main_component_ = static_cast<std::uint32_t>(std::max_element(sizes.begin(), sizes.end()) - sizes.begin());
+    }
+    
+    for (std::size_t r {0}; r < dungeon_map->GetRoomList().size(); r++) {
+        auto &rect {dungeon_map->GetRoomList()[r]->GetRect()};
+        
+        if (report.components_[rect.GetY() * width + rect.GetX()] != report.main_component_)
+            report.unreachable_rooms_.push_back(r);
+    }
+    
+    for (std::size_t i {0}; i < layer.size(); i++) {
+        if (report.components_[i] == report.main_component_)
+            continue;
+        
+        if (layer[i] & (kScanUpstairs | kScanDownstairs))
+            report.unreachable_stairs_.push_back(std::make_pair(i % width, i / width));
+        else if (layer[i] & kScanDoor)
+            report.unreachable_doors_.push_back(std::make_pair(i % width, i / width));
+    }
+    
+    report.upstairs_distances_ = Connectivity::DistanceField(walkable,
+                                                             width,
+                                                             height,
+                                                             upstairs,
+                                                             MoveDirections::FOUR_DIRECTIONAL);
+    
+    return report;
+}
+
+ConnectivityReport DungeonBuilder::ValidateConnectivity(bool auto_connect) {
+    ScopedPhase phase {map_->GetMetrics(), "ValidateConnectivity"};
+    ScratchScope scope {scratch_resource_};
+    auto dungeon_map {(DungeonMap*)map_.get()};
+    
+    if (dungeon_map->GetRoomList().empty() || map_->GetMap()->empty()) {
+        Utils::LogWarning("DungeonBuilder::ValidateConnectivity", "There are no rooms, or no free space. Skipping validation...");
+        return ConnectivityReport {};
+    }
+    
+    auto report {AnalyzeConnectivity()};
+    
+    if (!auto_connect || report.IsConnected())
+        return report;
+    
+    // Pick the rooms that can be used as corridor targets
+    std::pmr::vector<Room*> main_rooms {scratch_resource_};
+    for (auto const &room : dungeon_map->GetRoomList()) {
+        if (report.components_[room->GetRect().GetY() * map_->GetConfigs().map_width_ + room->GetRect().GetX()] == report.main_component_)
+            main_rooms.push_back(room.get());
+    }
+    
+    if (main_rooms.empty()) {
+        Utils::LogWarning("DungeonBuilder::ValidateConnectivity", "No room is reachable. Skipping auto connection...");
+        return report;
+    }
+    
+    // Dig a single corridor from every unreachable component, starting from any of its tiles
+    std::vector<bool> connected(report.component_count_ + 1, false);
+    auto connect = [&] (std::size_t x, std::size_t y) {
+        auto component {report.components_[y * map_->GetConfigs().map_width_ + x]};
+        
+        if (connected[component])
+            return;
+        
+        auto target {main_rooms[RndManager::GetInstance().GetRandomUintFromRange(0, main_rooms.size() - 1)]};
+        ConnectLocations(map_->GetTile(x, y), map_->GetTile(target->GetRndCoords()));
+        connected[component] = true;
+    };
+    
+    for (auto const &r : report.unreachable_rooms_)
+        connect(dungeon_map->GetRoomList()[r]->GetRect().GetX(), dungeon_map->GetRoomList()[r]->GetRect().GetY());
+    
+    for (auto const &xy : report.unreachable_stairs_)
+        connect(xy.first, xy.second);
+    
+    for (auto const &xy : report.unreachable_doors_)
+        connect(xy.first, xy.second);
+    
+    return AnalyzeConnectivity();
+}
+
 void DungeonBuilder::InitMap() {
+    ScopedPhase phase {map_->GetMetrics(), "InitMap"};
+    Profiler::Count("tiles", map_->GetConfigs().map_width_ * map_->GetConfigs().map_height_);
+    
     for (auto i {0}; i < map_->GetConfigs().map_height_; i++) {
         for (auto j {0}; j < map_->GetConfigs().map_width_; j++){
             std::initializer_list<std::shared_ptr<Tag>> tags = {WALL_TAG_};
@@ -219,7 +430,10 @@ void DungeonBuilder::GenerateRooms() {
         InitMap();
     }
     
+    ScopedPhase phase {map_->GetMetrics(), "GenerateRooms"};
     DungeonMapConfigs *dungeon_configs {&(DungeonMapConfigs&)map_->GetConfigs()};
+    std::uint64_t attempts {0};
+    std::uint64_t rooms {0};
 
     //  Generate each room.
     for (auto i {0}; i < dungeon_configs->rooms_; i++) {
@@ -230,54 +444,25 @@ void DungeonBuilder::GenerateRooms() {
                                            1, dungeon_configs->map_height_-1,
                                            dungeon_configs->min_room_width_, dungeon_configs->max_room_width_,
                                            dungeon_configs->min_room_height_, dungeon_configs->max_room_height_)};
+            attempts++;
             
             if (CanPlaceRect(++rndRect, {FLOOR_TAG_})) {
                 auto new_room {std::make_unique<Room> (--rndRect)};
                 PlaceRoom(new_room);
+                rooms++;
                 break;
             }
             
             if (j == dungeon_configs->max_room_placement_attempts_ - 1)
-                Utils::LogDebug( "DungeonBuilder", "Last room placement attempt failed. Moving on...");
+                Log::Debug("DungeonBuilder", [] { return "Last room placement attempt failed. Moving on..."; });
         }
     }
-}
-
-void DungeonBuilder::PlaceDoor(Tile *tile) {
-    assert (tile != nullptr);
-    
-    if (!tile->HasTag(FLOOR_TAG_))
-        return;
-    
-    //    Get the four neighbours
-    auto neis {map_->GetNeighbors(tile, MoveDirections::FOUR_DIRECTIONAL)};
-    
-    if (neis.size() < 4)
-        return;
-    
-    auto wall_count {0};
-    for (auto const &nei : neis) {
-        // If one neighbour has a door, exit
-        if (nei->HasTag(DOOR_TAG_))
-            return;
-        
-        // Count how many neighbours has walls
-        if (nei->HasTag(WALL_TAG_))
-            wall_count++;
-    }
-    
-    // If more then 2 neighbours has doors, there can't be two opposing wall tiles, therefore no place for a door
-    if (wall_count >= 3)
-        return;
     
-    // Checks if the 2 neighbouring wall tiles are opposed to eachother
-    if ((map_->GetTile(tile->GetX(), tile->GetY()-1)->HasTag(WALL_TAG_)
-         && map_->GetTile(tile->GetX(), tile->GetY()+1)->HasTag(WALL_TAG_))
-        || (map_->GetTile(tile->GetX()-1, tile->GetY())->HasTag(WALL_TAG_)
-            && map_->GetTile(tile->GetX()+1, tile->GetY())->HasTag(WALL_TAG_)))
-        tile->AddTag(DOOR_TAG_);
+    Profiler::Count("attempts", attempts);
+    Profiler::Count("rejections", attempts - rooms);
+    Profiler::Count("rooms", rooms);
 }
-    
+
 void DungeonBuilder::PlaceStairs(Tile *tile, bool is_upstairs) {
     assert (tile != nullptr);
     
@@ -288,6 +473,7 @@ void DungeonBuilder::PlaceStairs(Tile *tile, bool is_upstairs) {
 }
 
 void DungeonBuilder::GenerateDoors() {
+    ScopedPhase phase {map_->GetMetrics(), "GenerateDoors"};
     auto dungeon_map {(DungeonMap*)map_.get()};
     
     if (dungeon_map->GetRoomList().empty() || map_->GetMap()->empty()) {
@@ -295,30 +481,41 @@ void DungeonBuilder::GenerateDoors() {
         return;
     }
     
-    // Scan the borders fo the rooms form tiles eligible for doors
-    for (auto const &room : dungeon_map->GetRoomList()) {
-        Rect rect {room->Area::GetRect()};
-        rect++;
-
-        for (auto w {0}; w < rect.GetWidth(); w++) {
-            auto tile {map_->GetTile(rect.GetX() + w, rect.GetY())};
-            PlaceDoor(tile);
+    auto width {map_->GetConfigs().map_width_};
+    auto height {map_->GetConfigs().map_height_};
+    
+    // Compute the neighbour masks of walls and rooms in a single pass over the map
+    auto layer {GetScanLayer(dungeon_map)};
+    auto wall_masks {NeighborMask::Compute(layer, width, height, kScanWall)};
+    auto room_masks {NeighborMask::Compute(layer, width, height, kScanRoom)};
+    
+    // Border tiles are skipped, since a door needs four neighbours
+    for (std::size_t y {1}; y + 1 < height; y++) {
+        for (std::size_t x {1}; x + 1 < width; x++) {
+            auto i {y * width + x};
             
-            tile = map_->GetTile(rect.GetX() + w, rect.GetY() + rect.GetHeight()-1);
-            PlaceDoor(tile);
-        }
-        
-        for (auto h {0}; h < rect.GetHeight(); h++) {
-            auto tile {map_->GetTile(rect.GetX(), rect.GetY() + h)};
-            PlaceDoor(tile);
+            // Tiles eligible for doors are floor tiles on the border of a room: outside of it, yet adjacent to it
+            if (!(layer[i] & kScanFloor) || (layer[i] & kScanRoom) || room_masks[i] == 0)
+                continue;
+            
+            // Door tiles must be adjacent to two opposing walls only
+            if (!NeighborMask::IsDoorMask(wall_masks[i]))
+                continue;
             
-            tile = map_->GetTile(rect.GetX() + rect.GetWidth()-1, rect.GetY() + h);
-            PlaceDoor(tile);
+            // If one neighbour has a door, skip
+            if ((layer[i - width] | layer[i + 1] | layer[i + width] | layer[i - 1]) & kScanDoor)
+                continue;
+            
+            (*map_->GetMap())[i]->AddTag(DOOR_TAG_);
+            layer[i] |= kScanDoor;
+            Profiler::Count("doors");
         }
     }
 }
     
 void DungeonBuilder::GenerateWallStairs() {
+    ScopedPhase phase {map_->GetMetrics(), "GenerateWallStairs"};
+    ScratchScope scope {scratch_resource_};
     auto dungeon_map {(DungeonMap*)map_.get()};
 
     if (dungeon_map->GetRoomList().empty() || map_->GetMap()->empty()) {
@@ -326,77 +523,46 @@ void DungeonBuilder::GenerateWallStairs() {
         return;
     }
     
-    std::vector<Tile*> eligeble_tiles;
-
-    // Scan the borders fo the rooms form tiles eligible for stairs
-    for (auto const &room : dungeon_map->GetRoomList()) {
-        Rect rect {room->Area::GetRect()};
-        rect++;
-
-        for (auto w {1}; w < rect.GetWidth()-1; w++) {
-            eligeble_tiles.push_back(map_->GetTile(rect.GetX() + w, rect.GetY()));
-
-            eligeble_tiles.push_back(map_->GetTile(rect.GetX() + w, rect.GetY() + rect.GetHeight()-1));
-        }
-        
-        for (auto h {1}; h < rect.GetHeight()-1; h++) {
-            eligeble_tiles.push_back(map_->GetTile(rect.GetX(), rect.GetY() + h));
-
-            eligeble_tiles.push_back(map_->GetTile(rect.GetX() + rect.GetWidth()-1, rect.GetY() + h));
-        }
-    }
+    auto width {map_->GetConfigs().map_width_};
+    auto height {map_->GetConfigs().map_height_};
     
-    // Shuffle the vector
-    std::shuffle(std::begin(eligeble_tiles), std::end(eligeble_tiles), RndManager::GetInstance().GetGenerator());
+    // Compute the neighbour masks of walls and rooms in a single pass over the map
+    auto layer {GetScanLayer(dungeon_map)};
+    auto wall_masks {NeighborMask::Compute(layer, width, height, kScanWall)};
+    auto room_masks {NeighborMask::Compute(layer, width, height, kScanRoom)};
     
-    auto can_place_stairs = [&] (Tile* tile) -> bool {
-        assert (tile != nullptr);
-        
-        // Door and floor tiles are not eligible
-        if (tile->HasTag(DOOR_TAG_) || !tile->HasTag(WALL_TAG_))
-            return false;
-        
-        //    Get the four neighbours
-        auto neis {map_->GetNeighbors(tile, MoveDirections::FOUR_DIRECTIONAL)};
-        
-        // Discard any near the border location
-        if (neis.size() != 4)
-            return false;
-        
-        auto wall_count {0};
-        for (auto const &nei : neis) {
-            
-            // Neighboring tiles cannot have stairs
-            if (nei->HasTag(UPSTAIRS_TAG_) || nei->HasTag(DOWNSTAIRS_TAG_))
-                return false;
+    std::pmr::vector<std::size_t> eligeble_tiles {scratch_resource_};
+    
+    // Scan the sides of the rooms for wall tiles eligible for stairs. Wall embedded stairs can only be
+    // placed into tiles adjacent to 3 walls, four directionally. Door and floor tiles are not eligible
+    for (std::size_t y {1}; y + 1 < height; y++) {
+        for (std::size_t x {1}; x + 1 < width; x++) {
+            auto i {y * width + x};
             
-            // Count how many neighbours has walls
-            if (nei->HasTag(WALL_TAG_))
-                wall_count++;
+            if ((layer[i] & (kScanWall | kScanDoor)) == kScanWall
+                && (room_masks[i] & kCardinalNeighbors)
+                && NeighborMask::IsWallStairMask(wall_masks[i]))
+                eligeble_tiles.push_back(i);
         }
-        
-        // Wall embedded staris can only be placed into tiles adjacent to 3 walls, four directionally
-        if (wall_count == 3)
-            return true;
-        
-        return false;
-    };
+    }
+    
+    // Candidates are drawn in random order, without shuffling the whole vector
+    IndexSampler sampler {eligeble_tiles.size(), scratch_resource_};
+    Profiler::Count("candidates", eligeble_tiles.size());
     
     auto iterate_and_place = [&] (size_t amount, bool is_upstair) {
-        if (amount == 0)
-            return;
-        
-        for (auto i {0}; i < amount; i++) {
-            if (eligeble_tiles.size() == 0)
-                break;
+        for (size_t placed {0}; placed < amount && !sampler.empty();) {
+            auto index {eligeble_tiles[sampler.Draw()]};
             
-            if (auto tile {eligeble_tiles.back()}; can_place_stairs(tile)) {
-                PlaceStairs(tile, is_upstair);
-            }
-            else
-                i--;
+            // Neighboring tiles cannot have stairs
+            if ((layer[index - width] | layer[index + 1] | layer[index + width] | layer[index - 1])
+                & (kScanUpstairs | kScanDownstairs))
+                continue;
             
-            eligeble_tiles.pop_back();
+            PlaceStairs((*map_->GetMap())[index].get(), is_upstair);
+            layer[index] = (layer[index] & ~kScanWall) | (is_upstair ? kScanUpstairs : kScanDownstairs);
+            placed++;
+            Profiler::Count("stairs");
         }
     };
     
@@ -412,6 +578,8 @@ void DungeonBuilder::GenerateWallStairs() {
 }
     
 void DungeonBuilder::GenerateGroundStairs() {
+    ScopedPhase phase {map_->GetMetrics(), "GenerateGroundStairs"};
+    ScratchScope scope {scratch_resource_};
     auto dungeon_map {(DungeonMap*)map_.get()};
 
     if (dungeon_map->GetRoomList().empty() || map_->GetMap()->empty()) {
@@ -421,64 +589,74 @@ void DungeonBuilder::GenerateGroundStairs() {
     
     // Get the dungeon congifs
     DungeonMapConfigs *dungeon_configs {&(DungeonMapConfigs&)map_->GetConfigs()};
-
-    std::vector<Tile*> eligeble_tiles;
+    
+    // Candidates are drawn lazily by index, either from the whole map or from the concatenated room areas,
+    // so that no list of walkable tiles has to be built or shuffled
+    std::pmr::vector<std::size_t> room_offsets {scratch_resource_};
+    std::size_t candidates {map_->GetMap()->size()};
     
     if (dungeon_configs->build_stairs_only_in_rooms_) {
+        candidates = 0;
+        
         for (auto const &room : dungeon_map->GetRoomList()) {
-            // Scan the rooms and adds tiles
-            for (auto w {room->GetRect().GetX()}; w < room->GetRect().GetX() + room->GetRect().GetWidth(); w++) {
-                for (auto h {room->GetRect().GetY()}; h < room->GetRect().GetY() + room->GetRect().GetHeight(); h++) {
-                    if (auto tile {map_->GetTile(w, h)}; !tile->HasAnyTag({DOWNSTAIRS_TAG_, UPSTAIRS_TAG_, DOOR_TAG_, WALL_TAG_}))
-                        eligeble_tiles.push_back(tile);
-                }
-            }
-        }
-    } else {
-        // Scan for walkable tiles
-        for (auto const &tile : *map_->GetMap()) {
-            if (!tile->HasAnyTag({DOWNSTAIRS_TAG_, UPSTAIRS_TAG_, DOOR_TAG_, WALL_TAG_})) {
-                eligeble_tiles.push_back(tile.get());
-            }
+            room_offsets.push_back(candidates);
+            candidates += room->GetRect().GetWidth() * room->GetRect().GetHeight();
         }
     }
     
-    // Shuffle the vector
-    std::shuffle(std::begin(eligeble_tiles), std::end(eligeble_tiles), RndManager::GetInstance().GetGenerator());
+    auto get_candidate = [&] (std::size_t index) -> Tile* {
+        if (!dungeon_configs->build_stairs_only_in_rooms_)
+            return (*map_->GetMap())[index].get();
+        
+        auto room {std::upper_bound(room_offsets.begin(), room_offsets.end(), index) - room_offsets.begin() - 1};
+        auto &rect {dungeon_map->GetRoomList()[room]->GetRect()};
+        auto offset {index - room_offsets[room]};
+        
+        return map_->GetTile(rect.GetX() + offset % rect.GetWidth(), rect.GetY() + offset / rect.GetWidth());
+    };
     
     auto can_place_stairs = [&] (Tile* tile) -> bool {
         assert (tile != nullptr);
-                
-        //    Get the four neighbours
-        for (auto const &nei : map_->GetNeighbors(tile, MoveDirections::EIGHT_DIRECTIONAL)) {
-            // Neighboring tiles cannot have stairs
-            if (nei->HasAnyTag({DOOR_TAG_, UPSTAIRS_TAG_, DOWNSTAIRS_TAG_}))
-                return false;
+        
+        // Only walkable tiles are eligible
+        if (tile->HasAnyTag({DOWNSTAIRS_TAG_, UPSTAIRS_TAG_, DOOR_TAG_, WALL_TAG_}))
+            return false;
+        
+        // Neighboring tiles cannot have doors or stairs
+        for (auto y {tile->GetY() - 1}; y != tile->GetY() + 2; y++) {
+            for (auto x {tile->GetX() - 1}; x != tile->GetX() + 2; x++) {
+                if (auto nei {map_->GetTile(x, y)}; nei != nullptr && nei != tile
+                    && nei->HasAnyTag({DOOR_TAG_, UPSTAIRS_TAG_, DOWNSTAIRS_TAG_}))
+                    return false;
+            }
         }
         
         return true;
     };
     
+    IndexSampler sampler {candidates, scratch_resource_};
+    Profiler::Count("candidates", candidates);
+    
     auto iterate_and_place = [&] (size_t amount, bool is_upstair) {
-        for (auto i {0}; i < amount; i++) {
-            if (eligeble_tiles.size() == 0)
-                break;
+        for (size_t placed {0}; placed < amount && !sampler.empty();) {
+            auto tile {get_candidate(sampler.Draw())};
+            
+            if (!can_place_stairs(tile))
+                continue;
             
-            if (auto tile {eligeble_tiles.back()}; can_place_stairs(tile)) {
-                PlaceStairs(tile, is_upstair);
-                
-                if (dungeon_configs->dig_space_around_stairs) {
-                    // Remove walls from neighbors
-                    for (auto const &nei : map_->GetNeighbors(tile, MoveDirections::EIGHT_DIRECTIONAL)) {
-                        // Neighboring tiles cannot have stairs
-                        nei->RemoveTag(WALL_TAG_);
+            PlaceStairs(tile, is_upstair);
+            placed++;
+            Profiler::Count("stairs");
+            
+            if (dungeon_configs->dig_space_around_stairs) {
+                // Remove walls from neighbors
+                for (auto y {tile->GetY() - 1}; y != tile->GetY() + 2; y++) {
+                    for (auto x {tile->GetX() - 1}; x != tile->GetX() + 2; x++) {
+                        if (auto nei {map_->GetTile(x, y)}; nei != nullptr)
+                            nei->RemoveTag(WALL_TAG_);
                     }
                 }
             }
-            else
-                i--;
-            
-            eligeble_tiles.pop_back();
         }
     };
     
@@ -510,10 +688,20 @@ void DungeonBuilder::PlaceRoom(std::unique_ptr<Room> &room) {
     UpdateRect(room->GetRect(),
                {FLOOR_TAG_},
                {WALL_TAG_});
-        dungeon_map->GetRoomList().push_back(std::move(room));
+    dungeon_map->AddRoom(std::move(room));
     dungeon_map->GetRoomList().back()->Print();
 }
 
+void DungeonBuilder::PlaceLandingStairs(std::size_t x, std::size_t y, bool is_upstairs) {
+    assert(x >= 2 && y >= 2
+           && x + 2 < map_->GetConfigs().map_width_
+           && y + 2 < map_->GetConfigs().map_height_);
+    
+    auto landing {std::make_unique<Room>(Rect(x - 1, y - 1, 3, 3))};
+    PlaceRoom(landing);
+    PlaceStairs(map_->GetTile(x, y), is_upstairs);
+}
+
 void DungeonBuilder::RemoveRect(Rect const &rect, std::initializer_list<Tag_p> tags) {
     for (auto i {rect.GetY()}; i < rect.GetY() + rect.GetHeight(); i++) {
         for (auto j {rect.GetX()}; j < rect.GetX() + rect.GetWidth(); j++) {
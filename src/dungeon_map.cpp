@@ -1,5 +1,12 @@
 #include "dungeon_map.hpp"
 
+#include <algorithm>
+
+#include "constants.hpp"
+#include "neighbor_mask.hpp"
+#include "poisson_disk_sampler.hpp"
+#include "profiler.hpp"
+
 namespace libpmg {
     
 DungeonMap::DungeonMap() {
@@ -11,6 +18,7 @@ DungeonMap::DungeonMap(DungeonMap &other) {
     map_uuid_ = other.map_uuid_;
     configs_ = std::move(other.configs_);
     map_ = std::move(other.map_);
+    metrics_ = std::move(other.metrics_);
 }
 
 DungeonMap::DungeonMap(MapConfigs &configs)  {    
@@ -18,5 +26,170 @@ DungeonMap::DungeonMap(MapConfigs &configs)  {
     map_ = std::make_unique<std::vector<std::unique_ptr<Tile>>>();
 }
 
+void DungeonMap::AddRoom(std::unique_ptr<Room> room) {
+    InitRegions();
+
+    auto width {configs_->map_width_};
+    auto height {configs_->map_height_};
+    auto const &rect {room->GetRect()};
+    auto label {static_cast<std::uint32_t>(room_list_.size() + 1)};
+    auto right {std::min(rect.GetX() + rect.GetWidth(), width)};
+    auto bottom {std::min(rect.GetY() + rect.GetHeight(), height)};
+
+    for (auto y {rect.GetY()}; y < bottom; y++) {
+        for (auto x {rect.GetX()}; x < right; x++) {
+            if (region_layer_[y * width + x] == kNoRegion)
+                region_layer_[y * width + x] = label;
+        }
+    }
+
+    // Index the room in every cell it covers
+    if (rect.GetX() < right && rect.GetY() < bottom) {
+        auto grid_width {(width + kRoomGridCellSize - 1) / kRoomGridCellSize};
+
+        for (auto cy {rect.GetY() / kRoomGridCellSize}; cy <= (bottom - 1) / kRoomGridCellSize; cy++) {
+            for (auto cx {rect.GetX() / kRoomGridCellSize}; cx <= (right - 1) / kRoomGridCellSize; cx++)
+                room_grid_[cy * grid_width + cx].push_back(label - 1);
+        }
+    }
+
+    room_list_.push_back(std::move(room));
+}
+
+std::uint32_t DungeonMap::AddCorridor(std::vector<std::size_t> const &tiles) {
+    InitRegions();
+
+    auto label {static_cast<std::uint32_t>(kCorridorRegion | (corridors_ + 1))};
+
+    for (auto tile : tiles) {
+        if (tile < region_layer_.size() && region_layer_[tile] == kNoRegion)
+            region_layer_[tile] = label;
+    }
+
+    return static_cast<std::uint32_t>(corridors_++);
+}
+
+std::vector<std::uint32_t> DungeonMap::GetRoomsInRect(Rect const &rect) const {
+    std::vector<std::uint32_t> rooms;
+    auto width {configs_->map_width_};
+    auto height {configs_->map_height_};
+    auto right {std::min(rect.GetX() + rect.GetWidth(), width)};
+    auto bottom {std::min(rect.GetY() + rect.GetHeight(), height)};
+
+    if (room_grid_.empty() || rect.GetX() >= right || rect.GetY() >= bottom)
+        return rooms;
+
+    auto grid_width {(width + kRoomGridCellSize - 1) / kRoomGridCellSize};
+
+    for (auto cy {rect.GetY() / kRoomGridCellSize}; cy <= (bottom - 1) / kRoomGridCellSize; cy++) {
+        for (auto cx {rect.GetX() / kRoomGridCellSize}; cx <= (right - 1) / kRoomGridCellSize; cx++) {
+            for (auto room : room_grid_[cy * grid_width + cx]) {
+                auto const &other {room_list_[room]->GetRect()};
+
+                if (other.GetX() < right && rect.GetX() < other.GetX() + other.GetWidth()
+                    && other.GetY() < bottom && rect.GetY() < other.GetY() + other.GetHeight())
+                    rooms.push_back(room);
+            }
+        }
+    }
+
+    // Rooms covering more than a cell are found once for every cell
+    std::sort(rooms.begin(), rooms.end());
+    rooms.erase(std::unique(rooms.begin(), rooms.end()), rooms.end());
+
+    return rooms;
+}
+
+void DungeonMap::InitRegions() {
+    if (!region_layer_.empty())
+        return;
+
+    auto width {configs_->map_width_};
+    auto height {configs_->map_height_};
+
+    region_layer_.assign(width * height, kNoRegion);
+    room_grid_.assign(((width + kRoomGridCellSize - 1) / kRoomGridCellSize) * ((height + kRoomGridCellSize - 1) / kRoomGridCellSize), {});
+}
+
+RoomGraph const &DungeonMap::GetRoomGraph(MoveDirections const &dir) {
+    if (room_graph_ == nullptr
+        || room_graph_revision_ != revision_
+        || room_graph_->GetRoomCount() != room_list_.size()
+        || room_graph_->GetDirections() != dir) {
+        ScopedPhase phase {metrics_, "BuildRoomGraph"};
+
+        room_graph_ = std::make_unique<RoomGraph>(*this, room_list_, dir);
+        room_graph_revision_ = revision_;
+    }
+
+    return *room_graph_;
+}
+
+std::vector<std::size_t> DungeonMap::PlaceFeatures() {
+    ScopedPhase phase {metrics_, "PlaceFeatures"};
+    auto &tag_manager {TagManager::GetInstance()};
+    auto width {configs_->map_width_};
+    auto height {configs_->map_height_};
+    
+    // The first bit marks walkable floor, every other bit marks a tile that cannot host a feature
+    const std::uint32_t walkable_bit {1 << 0};
+    const std::uint32_t wall_bit {1 << 1};
+    const std::uint32_t feature_bit {1 << 5};
+    auto layer {GetTagLayer({tag_manager.floor_tag_,
+        tag_manager.wall_tag_,
+        tag_manager.door_tag_,
+        tag_manager.upstairs_tag_,
+        tag_manager.downstairs_tag_})};
+    
+    // A layer packs up to 32 tags, so the tiles hosting any feature are merged into a single bit, 32 features at a time
+    for (std::size_t first {0}; first < feature_list_.size(); first += 32) {
+        std::vector<std::shared_ptr<Tag>> feature_tags;
+        for (auto f {first}; f < std::min(first + 32, feature_list_.size()); f++)
+            feature_tags.push_back(feature_list_[f].tag_);
+        
+        auto feature_layer {GetTagLayer(feature_tags)};
+        for (std::size_t i {0}; i < layer.size(); i++) {
+            if (feature_layer[i] != 0)
+                layer[i] |= feature_bit;
+        }
+    }
+    
+    auto wall_masks {NeighborMask::Compute(layer, width, height, wall_bit)};
+    std::vector<std::size_t> placed;
+    
+    for (std::size_t f {0}; f < feature_list_.size(); f++) {
+        auto const &feature {feature_list_[f]};
+        
+        auto is_eligible = [&] (std::size_t index) -> bool {
+            auto x {index % width};
+            auto y {index / width};
+            
+            // Border tiles have no neighbour mask
+            if (x == 0 || y == 0 || x + 1 == width || y + 1 == height || layer[index] != walkable_bit)
+                return false;
+            
+            return !feature.predicate_ || feature.predicate_(wall_masks[index]);
+        };
+        
+        std::vector<std::size_t> candidates;
+        for (std::size_t i {0}; i < layer.size(); i++) {
+            if (is_eligible(i))
+                candidates.push_back(i);
+        }
+        
+        PoissonDiskSampler sampler {width, height, feature.min_spacing_};
+        auto points {sampler.Sample(candidates, is_eligible, feature.max_features_)};
+        
+        for (auto const &index : points) {
+            (*map_)[index]->AddTag(feature.tag_);
+            layer[index] |= feature_bit;
+        }
+        
+        placed.push_back(points.size());
+        Profiler::Count("features", points.size());
+    }
+    
+    return placed;
 }
 
+}
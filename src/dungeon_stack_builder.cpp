@@ -0,0 +1,164 @@
+#include "dungeon_stack_builder.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "constants.hpp"
+#include "parallel.hpp"
+#include "scratch_arena.hpp"
+
+namespace libpmg {
+
+/**
+ The distance kept between the upstairs and the downstairs of the same level, so that their landing rooms don't overlap.
+ */
+static const std::size_t kMinStairsDistance {4};
+
+DungeonStackBuilder::DungeonStackBuilder()
+: levels_ {1},
+map_width_ {0},
+map_height_ {0},
+seed_ {kDefaultSeed},
+threads_ {0}
+{}
+
+void DungeonStackBuilder::SetLevels(std::size_t levels) {
+    assert(levels > 0);
+    
+    levels_ = levels;
+}
+
+void DungeonStackBuilder::SetMapSize(std::size_t width, std::size_t height) {
+    // Landing rooms need to stay 2 tiles away from the border
+    assert(width > 4 && height > 4);
+    
+    map_width_ = width;
+    map_height_ = height;
+}
+
+void DungeonStackBuilder::SetSeed(int seed) {
+    seed_ = seed;
+}
+
+void DungeonStackBuilder::SetThreads(std::size_t threads) {
+    threads_ = threads;
+}
+
+void DungeonStackBuilder::SetLevelSetup(std::function<void(DungeonBuilder&, std::size_t)> setup) {
+    level_setup_ = setup;
+}
+
+std::pair<std::size_t, std::size_t> DungeonStackBuilder::GetStairsCoords(std::size_t level) const {
+    assert(map_width_ > 4 && map_height_ > 4);
+    
+    // Coordinates range from 2 to size - 3, so smaller maps can't keep the stairs of a level apart wherever the upstairs lie
+    if (level > 0 && std::max(map_width_, map_height_) - 4 < 2 * kMinStairsDistance) {
+        Utils::LogError("DungeonStackBuilder::GetStairsCoords", "Map too small to keep the stairs of a level apart.\nAborting...");
+        abort();
+    }
+    
+    auto columns {map_width_ - 4};
+    auto rows {map_height_ - 4};
+    
+    // The range of coordinates closer than kMinStairsDistance to another one, clipped to the map
+    auto near = [] (std::size_t coord, std::size_t size) {
+        auto low {coord >= 2 + kMinStairsDistance - 1 ? coord - (kMinStairsDistance - 1) : 2};
+        auto high {std::min(coord + kMinStairsDistance - 1, size - 3)};
+        return std::make_pair(low, high - low + 1);
+    };
+    
+    std::pair<std::size_t, std::size_t> coords;
+    
+    // Every link depends on the one above it, so they are drawn from the first level down, once each
+    for (std::size_t link_level {0}; link_level <= level; link_level++) {
+        // Coordinates are drawn from a stream of their own, so that they never depend on the state of a generator
+        RndStream link {seed_, 2 * link_level + 1};
+        
+        if (link_level == 0) {
+            coords.first = link.GetRandomUintFromRange(2, map_width_ - 3);
+            coords.second = link.GetRandomUintFromRange(2, map_height_ - 3);
+            continue;
+        }
+        
+        // Keep the landing rooms of the upstairs and downstairs of the same level apart, drawing the downstairs
+        // among the tiles out of the square around the upstairs, row by row
+        auto near_x {near(coords.first, map_width_)};
+        auto near_y {near(coords.second, map_height_)};
+        auto index {link.GetRandomUintFromRange(0, columns * rows - near_x.second * near_y.second - 1)};
+        
+        for (std::size_t y {2}; ; y++) {
+            auto inside {y >= near_y.first && y < near_y.first + near_y.second};
+            auto row_size {inside ? columns - near_x.second : columns};
+            
+            if (index >= row_size) {
+                index -= row_size;
+                continue;
+            }
+            
+            auto x {2 + index};
+            if (inside && x >= near_x.first)
+                x += near_x.second;
+            
+            coords = {x, y};
+            break;
+        }
+    }
+    
+    return coords;
+}
+
+std::unique_ptr<Map> DungeonStackBuilder::BuildLevel(std::size_t level) {
+    assert(level < levels_);
+    
+    RndManager::seed_ = GetLevelSeed(level);
+    RndManager::GetInstance().ResetInstance();
+    
+    // Every thread reuses its arena across levels, so that scratch memory soon stops growing
+    thread_local ScratchArena arena;
+    
+    DungeonBuilder builder;
+    builder.SetMapSize(map_width_, map_height_);
+    builder.SetScratchResource(&arena);
+    
+    if (level_setup_)
+        level_setup_(builder, level);
+    
+    builder.InitMap();
+    
+    // Pin the stairs before digging the rooms, so that the rooms will be dug around them
+    if (level > 0) {
+        auto coords {GetStairsCoords(level - 1)};
+        builder.PlaceLandingStairs(coords.first, coords.second, true);
+    }
+    
+    if (level + 1 < levels_) {
+        auto coords {GetStairsCoords(level)};
+        builder.PlaceLandingStairs(coords.first, coords.second, false);
+    }
+    
+    builder.GenerateRooms();
+    builder.GenerateCorridors();
+    builder.GenerateDoors();
+    arena.Release();
+    
+    return std::move(builder.Build());
+}
+
+std::vector<std::unique_ptr<Map>> &DungeonStackBuilder::Build() {
+    // The calling thread builds levels too, reseeding its generator
+    auto caller_seed {RndManager::seed_};
+    
+    level_list_.clear();
+    level_list_.resize(levels_);
+    
+    Parallel::ForEachIndex(levels_, threads_, [&] (std::size_t level, std::size_t) {
+        level_list_[level] = BuildLevel(level);
+    });
+    
+    RndManager::seed_ = caller_seed;
+    RndManager::GetInstance().ResetInstance();
+    
+    return level_list_;
+}
+
+}
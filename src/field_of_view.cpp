@@ -0,0 +1,256 @@
+#include "field_of_view.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <cstdlib>
+
+#include "parallel.hpp"
+#include "tag_manager.hpp"
+#include "utils.hpp"
+
+namespace libpmg {
+
+/**
+ The transformations from the coordinates of an octant to the map ones, one column per octant.
+ */
+static const long kOctants[4][8] {
+    {1, 0, 0, -1, -1, 0, 0, 1},
+    {0, 1, -1, 0, 0, -1, 1, 0},
+    {0, 1, 1, 0, 0, -1, -1, 0},
+    {1, 0, 0, 1, -1, 0, 0, -1}
+};
+
+void TileBitset::Clear() {
+    std::fill(words_.begin(), words_.end(), 0);
+}
+
+std::size_t TileBitset::Count() const {
+    std::size_t count {0};
+
+    for (auto word : words_)
+        count += std::bitset<64> {word}.count();
+
+    return count;
+}
+
+TileBitset &TileBitset::operator|=(TileBitset const &other) {
+    assert(words_.size() == other.words_.size());
+
+    for (std::size_t i {0}; i < words_.size(); i++)
+        words_[i] |= other.words_[i];
+
+    return *this;
+}
+
+FieldOfView::FieldOfView(Map &map) : FieldOfView(map, {TagManager::GetInstance().wall_tag_}) {}
+
+FieldOfView::FieldOfView(Map &map, std::vector<std::shared_ptr<Tag>> const &opaque_tags)
+: opacity_ {map.GetConfigs().map_width_, map.GetConfigs().map_height_},
+opaque_tags_ {opaque_tags},
+revision_ {map.GetRevision()}
+{
+    ReadOpacity(map);
+}
+
+FieldOfView::FieldOfView(TileBitset opacity) : opacity_ {std::move(opacity)}, revision_ {0} {}
+
+void FieldOfView::Sync(Map &map) {
+    if (opaque_tags_.empty()) {
+        Utils::LogWarning("FieldOfView::Sync", "The layer was not built from a map. Skipping...");
+        return;
+    }
+
+    std::vector<Rect> regions;
+
+    // The map dropped some of the areas, so read every tile again
+    if (!map.GetDirtyRegions(revision_, regions)) {
+        opacity_.Clear();
+        ReadOpacity(map);
+        revision_ = map.GetRevision();
+        return;
+    }
+
+    for (auto const &rect : regions) {
+        for (auto y {rect.GetY()}; y < rect.GetY() + rect.GetHeight(); y++) {
+            for (auto x {rect.GetX()}; x < rect.GetX() + rect.GetWidth(); x++) {
+                auto tile {map.GetTile(x, y)};
+                auto opaque {std::any_of(opaque_tags_.begin(), opaque_tags_.end(), [&] (auto const &tag) { return tile->HasTag(tag); })};
+
+                SetOpaque(x, y, opaque);
+            }
+        }
+    }
+
+    revision_ = map.GetRevision();
+}
+
+void FieldOfView::ReadOpacity(Map &map) {
+    auto layer {map.GetTagLayer(opaque_tags_)};
+
+    for (std::size_t i {0}; i < layer.size(); i++) {
+        if (layer[i] != 0)
+            opacity_.SetIndex(i);
+    }
+}
+
+void FieldOfView::SetOpaque(std::size_t x, std::size_t y, bool opaque) {
+    if (opaque)
+        opacity_.Set(x, y);
+    else
+        opacity_.Reset(x, y);
+}
+
+void FieldOfView::Compute(std::size_t x, std::size_t y, std::size_t radius, TileBitset &visible) const {
+    assert(visible.GetWidth() == opacity_.GetWidth() && visible.GetHeight() == opacity_.GetHeight());
+
+    if (x >= opacity_.GetWidth() || y >= opacity_.GetHeight())
+        return;
+
+    if (radius == 0)
+        radius = std::max(opacity_.GetWidth(), opacity_.GetHeight());
+
+    visible.Set(x, y);
+
+    for (std::size_t octant {0}; octant < 8; octant++)
+        CastLight(x, y, 1, 1.0f, 0.0f, radius,
+                  kOctants[0][octant], kOctants[1][octant], kOctants[2][octant], kOctants[3][octant], visible);
+}
+
+void FieldOfView::CastLight(long x, long y, long row, float start, float end, long radius,
+                            long xx, long xy, long yx, long yy, TileBitset &visible) const {
+    if (start < end)
+        return;
+
+    auto radius_squared {radius * radius};
+    auto new_start {0.0f};
+
+    for (auto distance {row}; distance <= radius; distance++) {
+        auto dy {-distance};
+        auto blocked {false};
+
+        for (auto dx {-distance}; dx <= 0; dx++) {
+            // The slopes of the left and right edges of the tile
+            auto left_slope {(dx - 0.5f) / (dy + 0.5f)};
+            auto right_slope {(dx + 0.5f) / (dy - 0.5f)};
+
+            if (start < right_slope)
+                continue;
+            if (end > left_slope)
+                break;
+
+            // Coordinates out of the map wrap around, and are caught by IsOpaque
+            auto tile_x {static_cast<std::size_t>(x + dx * xx + dy * xy)};
+            auto tile_y {static_cast<std::size_t>(y + dx * yx + dy * yy)};
+            auto opaque {IsOpaque(tile_x, tile_y)};
+
+            if (dx * dx + dy * dy <= radius_squared && tile_x < opacity_.GetWidth() && tile_y < opacity_.GetHeight())
+                visible.Set(tile_x, tile_y);
+
+            if (blocked) {
+                // Keep scanning the shadow, until the next transparent tile
+                if (opaque) {
+                    new_start = right_slope;
+                    continue;
+                }
+
+                blocked = false;
+                start = new_start;
+            } else if (opaque && distance < radius) {
+                // An opaque tile starts a shadow: scan the light before it in the next rows
+                blocked = true;
+                CastLight(x, y, distance + 1, start, left_slope, radius, xx, xy, yx, yy, visible);
+                new_start = right_slope;
+            }
+        }
+
+        if (blocked)
+            break;
+    }
+}
+
+std::vector<TileBitset> FieldOfView::Compute(std::vector<std::pair<std::size_t, std::size_t>> const &observers,
+                                             std::size_t radius,
+                                             std::size_t threads) const {
+    std::vector<TileBitset> visible(observers.size(), TileBitset {opacity_.GetWidth(), opacity_.GetHeight()});
+
+    Parallel::ForEachIndex(observers.size(), threads, [&] (std::size_t observer, std::size_t) {
+        Compute(observers[observer].first, observers[observer].second, radius, visible[observer]);
+    });
+
+    return visible;
+}
+
+void FieldOfView::ComputeUnion(std::vector<std::pair<std::size_t, std::size_t>> const &observers,
+                               std::size_t radius,
+                               TileBitset &visible,
+                               std::size_t threads) const {
+    threads = Parallel::GetThreads(threads, observers.size());
+
+    // Every thread accumulates its observers in a set of its own, merged at the end
+    std::vector<TileBitset> partial(threads, TileBitset {opacity_.GetWidth(), opacity_.GetHeight()});
+
+    Parallel::ForEachIndex(observers.size(), threads, [&] (std::size_t observer, std::size_t thread) {
+        Compute(observers[observer].first, observers[observer].second, radius, partial[thread]);
+    });
+
+    for (auto const &set : partial)
+        visible |= set;
+}
+
+bool FieldOfView::HasLineOfSight(std::size_t x1, std::size_t y1, std::size_t x2, std::size_t y2) const {
+    // A tile always sees itself, and the walk below would step away from it
+    if (x1 == x2 && y1 == y2)
+        return true;
+
+    // Always walk from the same end, so that the result is symmetric
+    if (std::make_pair(y2, x2) < std::make_pair(y1, x1)) {
+        std::swap(x1, x2);
+        std::swap(y1, y2);
+    }
+
+    auto x {static_cast<long>(x1)};
+    auto y {static_cast<long>(y1)};
+    auto dx {std::labs(static_cast<long>(x2) - x)};
+    auto dy {-std::labs(static_cast<long>(y2) - y)};
+    auto step_x {x < static_cast<long>(x2) ? 1 : -1};
+    auto step_y {y < static_cast<long>(y2) ? 1 : -1};
+    auto error {dx + dy};
+
+    while (true) {
+        auto double_error {2 * error};
+
+        if (double_error >= dy) {
+            error += dy;
+            x += step_x;
+        }
+        if (double_error <= dx) {
+            error += dx;
+            y += step_y;
+        }
+
+        if (x == static_cast<long>(x2) && y == static_cast<long>(y2))
+            return true;
+
+        if (IsOpaque(x, y))
+            return false;
+    }
+}
+
+void FieldOfView::MarkExplored(Map &map, TileBitset const &visible) {
+    auto &tiles {*map.GetMap()};
+    auto explored {TagManager::GetInstance().explored_tag_};
+    auto const &words {visible.GetWords()};
+
+    // Skip empty words, since most of the map is usually out of sight
+    for (std::size_t w {0}; w < words.size(); w++) {
+        for (auto word {words[w]}; word != 0; word &= word - 1) {
+            auto index {w * 64 + __builtin_ctzll(word)};
+
+            if (index < tiles.size() && !tiles[index]->HasTag(explored))
+                tiles[index]->AddTag(explored);
+        }
+    }
+}
+
+}
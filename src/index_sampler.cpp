@@ -0,0 +1,36 @@
+#include "index_sampler.hpp"
+
+#include <cassert>
+
+#include "rnd_manager.hpp"
+
+namespace libpmg {
+
+IndexSampler::IndexSampler(std::size_t size, std::pmr::memory_resource *resource)
+: size_ {size},
+drawn_ {0},
+swapped_ {resource}
+{}
+
+std::size_t IndexSampler::Draw() {
+    assert(!empty());
+    
+    auto slot {RndManager::GetInstance().GetRandomUintFromRange(drawn_, size_ - 1)};
+    auto index {GetSlot(slot)};
+    
+    // Move the first undrawn index into the drawn slot, and forget about the slot that is now out of the range
+    swapped_[slot] = GetSlot(drawn_);
+    swapped_.erase(drawn_);
+    drawn_++;
+    
+    return index;
+}
+
+std::size_t IndexSampler::GetSlot(std::size_t slot) const {
+    if (auto it {swapped_.find(slot)}; it != swapped_.end())
+        return it->second;
+    
+    return slot;
+}
+
+}
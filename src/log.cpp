@@ -0,0 +1,125 @@
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace libpmg {
+
+std::atomic<int> Log::level_ {static_cast<int>(kDefaultLogLevel)};
+std::atomic<LogSink*> Log::sink_ {nullptr};
+
+/**
+ Copies a string into a fixed size buffer, truncating it if needed.
+ */
+static void CopyTruncated(char *destination, std::size_t size, char const *source, std::size_t length) {
+    length = std::min(length, size - 1);
+    std::memcpy(destination, source, length);
+    destination[length] = '\0';
+}
+
+void StdoutLogSink::Write(LogLevel level, char const *context, std::string const &message) {
+    switch (level) {
+        case LogLevel::WARNING:
+            printf("[WARNING] %s:: %s\n", context, message.c_str());
+            break;
+        case LogLevel::ERROR:
+            printf("[ERROR] %s:: %s\n", context, message.c_str());
+            break;
+        default:
+            if (*context)
+                printf("%s:: %s\n", context, message.c_str());
+            else
+                printf("%s\n", message.c_str());
+            break;
+    }
+}
+
+RingLogSink::RingLogSink(std::size_t capacity)
+: write_position_ {0},
+read_position_ {0},
+dropped_ {0}
+{
+    std::size_t size {2};
+    while (size < capacity)
+        size <<= 1;
+
+    slots_ = std::make_unique<Slot[]>(size);
+    mask_ = size - 1;
+
+    for (std::size_t i {0}; i < size; i++)
+        slots_[i].sequence_.store(i, std::memory_order_relaxed);
+}
+
+void RingLogSink::Write(LogLevel level, char const *context, std::string const &message) {
+    auto position {write_position_.load(std::memory_order_relaxed)};
+    Slot *slot;
+
+    // Claim a slot whose sequence matches the position, meaning the consumer is done with it
+    while (true) {
+        slot = &slots_[position & mask_];
+        auto sequence {slot->sequence_.load(std::memory_order_acquire)};
+        auto difference {static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position)};
+
+        if (difference == 0) {
+            if (write_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (difference < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = write_position_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level_ = level;
+    CopyTruncated(slot->context_, kLogContextSize, context, std::strlen(context));
+    CopyTruncated(slot->message_, kLogMessageSize, message.data(), message.size());
+
+    // Publish the slot to the consumer
+    slot->sequence_.store(position + 1, std::memory_order_release);
+}
+
+std::size_t RingLogSink::Drain(std::function<void(LogLevel, char const*, char const*)> const &consumer) {
+    std::size_t drained {0};
+
+    while (true) {
+        auto &slot {slots_[read_position_ & mask_]};
+
+        if (slot.sequence_.load(std::memory_order_acquire) != read_position_ + 1)
+            break;
+
+        consumer(slot.level_, slot.context_, slot.message_);
+
+        // Hand the slot back to the writers, one lap ahead
+        slot.sequence_.store(read_position_ + mask_ + 1, std::memory_order_release);
+        read_position_++;
+        drained++;
+    }
+
+    return drained;
+}
+
+void Log::SetLevel(LogLevel level) {
+    level_.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel Log::GetLevel() {
+    return static_cast<LogLevel>(level_.load(std::memory_order_relaxed));
+}
+
+void Log::SetSink(LogSink *sink) {
+    sink_.store(sink, std::memory_order_release);
+}
+
+void Log::Write(LogLevel level, char const *context, std::string const &message) {
+    if (!IsEnabled(level))
+        return;
+
+    static StdoutLogSink default_sink;
+
+    auto sink {sink_.load(std::memory_order_acquire)};
+    (sink != nullptr ? sink : &default_sink)->Write(level, context, message);
+}
+
+}
@@ -1,6 +1,12 @@
 #include "map.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "constants.hpp"
+#include "map_export.hpp"
 #include "utils.hpp"
 
 namespace libpmg {
@@ -41,6 +47,25 @@ std::vector<Location*> Map::GetNeighbors(Location *location, MoveDirections cons
     return vec;
 }
     
+std::size_t Map::GetNeighbors(Location const *location, MoveDirections const &dir, Tile **neighbors) {
+    auto x {location->GetX()};
+    auto y {location->GetY()};
+    std::size_t count {0};
+    
+    // Coordinates out of the map wrap around, and are rejected by GetTile
+    std::pair<std::size_t, std::size_t> const offsets[] {
+        {x, y-1}, {x+1, y}, {x, y+1}, {x-1, y},
+        {x-1, y-1}, {x+1, y+1}, {x-1, y+1}, {x+1, y-1}
+    };
+    
+    for (std::size_t i {0}; i < (dir == MoveDirections::EIGHT_DIRECTIONAL ? 8 : 4); i++) {
+        if (auto tile {GetTile(offsets[i])}; tile != nullptr)
+            neighbors[count++] = tile;
+    }
+    
+    return count;
+}
+    
 std::vector<Tile*> Map::GetNeighbors(Tile *location, MoveDirections const &dir) {
     size_t x, y;
     std::tie(x, y) = location->GetXY();
@@ -69,6 +94,87 @@ std::vector<Tile*> Map::GetNeighbors(Tile *location, MoveDirections const &dir)
     return vec;
 }
 
+/**
+ Packs the tags of every tile of a map into a dense layer.
+ @param tags The tags to pack, in bit order
+ @param add_tags Whether tags not in the list are appended to it, while there are bits left
+ */
+static std::vector<std::uint32_t> PackTagLayer(Map &map, std::vector<std::shared_ptr<Tag>> &tags, bool add_tags) {
+    auto &tiles {*map.GetMap()};
+    std::vector<std::uint32_t> layer(tiles.size(), 0);
+    
+    // Tags are compared by name, so the bits of every tag instance are resolved only the first time it is met
+    // Neighbouring tiles mostly share the same instances, so the last one is checked before the lookup
+    std::unordered_map<Tag*, std::uint32_t> bits;
+    Tag *last_tag {nullptr};
+    std::uint32_t last_bits {0};
+    
+    for (size_t i {0}; i < layer.size(); i++) {
+        for (auto const &tag : tiles[i]->GetTagList()) {
+            if (tag.get() != last_tag) {
+                auto bit {bits.find(tag.get())};
+                
+                if (bit == bits.end()) {
+                    std::uint32_t value {0};
+                    for (size_t t {0}; t < tags.size(); t++) {
+                        if (*tags[t] == *tag)
+                            value |= std::uint32_t {1} << t;
+                    }
+                    
+                    if (value == 0 && add_tags && tags.size() < 32) {
+                        value = std::uint32_t {1} << tags.size();
+                        tags.push_back(tag);
+                    }
+                    
+                    bit = bits.emplace(tag.get(), value).first;
+                }
+                
+                last_tag = tag.get();
+                last_bits = bit->second;
+            }
+            
+            layer[i] |= last_bits;
+        }
+    }
+    
+    return layer;
+}
+
+std::vector<std::uint32_t> Map::GetTagLayer(std::vector<std::shared_ptr<Tag>> const &tags) {
+    assert(tags.size() <= 32);
+    
+    auto table {tags};
+    return PackTagLayer(*this, table, false);
+}
+
+std::vector<std::uint32_t> Map::GetFullTagLayer(std::vector<std::shared_ptr<Tag>> &tags) {
+    tags.clear();
+    return PackTagLayer(*this, tags, true);
+}
+
+std::vector<std::shared_ptr<Tag>> Map::GetTagTable() {
+    std::vector<std::shared_ptr<Tag>> tags;
+    std::unordered_set<Tag*> seen;
+    Tag *last_tag {nullptr};
+    
+    for (auto const &tile : *GetMap()) {
+        for (auto const &tag : tile->GetTagList()) {
+            if (tag.get() == last_tag)
+                continue;
+            
+            last_tag = tag.get();
+            if (!seen.insert(tag.get()).second)
+                continue;
+            
+            auto same {std::find_if(tags.begin(), tags.end(), [&] (auto &other) { return *other == *tag; })};
+            if (same == tags.end())
+                tags.push_back(tag);
+        }
+    }
+    
+    return tags;
+}
+
 Tile *Map::GetTile(std::pair<size_t, size_t> xy) {
     size_t x, y;
     std::tie(x, y) = xy;
@@ -84,17 +190,14 @@ Tile *Map::GetTile(size_t x, size_t y) {
 }
 
 void Map::Print() {
-    std::string output {"\n"};
-    
-    for ( size_t i {0}; i < GetConfigs().map_height_; i++ ) {
-        for ( size_t j {0}; j < GetConfigs().map_width_; j++ ) {
-            if (auto t {GetTile(j, i)}; t != nullptr)
-                output += t->GetChar();
-        }
-        output += '\n';
-    }
-    
-    Utils::LogDebug("Map", output);
+    Log::Info("Map", [&] {
+        auto size {MapExport::GetAsciiSize(GetConfigs().map_width_, GetConfigs().map_height_)};
+        std::string output(size + 1, '\n');
+        
+        MapExport::ExportAscii(*this, &output[1], size);
+        
+        return output;
+    });
 }
     
 void Map::ResetLocationCosts() {
@@ -102,8 +205,74 @@ void Map::ResetLocationCosts() {
         tile->path_cost_ = kDefaultEmptyTileCost;
 }
 
-void Map::ResetPathFlags() {
-    for (auto const &tile : *GetMap()) tile->is_path_explored_ = false;
+void Map::ResetLocationCosts(Rect const &rect) {
+    auto area {ClipRect(rect)};
+
+    for (auto y {area.GetY()}; y < area.GetY() + area.GetHeight(); y++) {
+        for (auto x {area.GetX()}; x < area.GetX() + area.GetWidth(); x++)
+            GetTile(x, y)->path_cost_ = kDefaultEmptyTileCost;
+    }
+}
+
+void Map::UpdateTileTags(std::size_t x,
+                         std::size_t y,
+                         std::initializer_list<std::shared_ptr<Tag>> to_insert,
+                         std::initializer_list<std::shared_ptr<Tag>> to_remove) {
+    UpdateRectTags({x, y, 1, 1}, to_insert, to_remove);
+}
+
+void Map::UpdateRectTags(Rect const &rect,
+                         std::initializer_list<std::shared_ptr<Tag>> to_insert,
+                         std::initializer_list<std::shared_ptr<Tag>> to_remove) {
+    auto area {ClipRect(rect)};
+
+    if (area.GetWidth() == 0 || area.GetHeight() == 0) {
+        Utils::LogWarning("Map::UpdateRectTags", "The area is outside of the map. Skipping...");
+        return;
+    }
+
+    for (auto y {area.GetY()}; y < area.GetY() + area.GetHeight(); y++) {
+        for (auto x {area.GetX()}; x < area.GetX() + area.GetWidth(); x++)
+            GetTile(x, y)->UpdateTags(to_insert, to_remove);
+    }
+
+    MarkDirty(area);
+}
+
+void Map::MarkDirty(Rect const &rect) {
+    auto area {ClipRect(rect)};
+
+    if (area.GetWidth() == 0 || area.GetHeight() == 0)
+        return;
+
+    revision_++;
+    dirty_regions_.emplace_back(revision_, area);
+
+    if (dirty_regions_.size() > kMaxDirtyRegions) {
+        dropped_revision_ = dirty_regions_.front().first;
+        dirty_regions_.pop_front();
+    }
+}
+
+bool Map::GetDirtyRegions(std::uint64_t revision, std::vector<Rect> &regions) const {
+    if (revision < dropped_revision_)
+        return false;
+
+    for (auto const &region : dirty_regions_) {
+        if (region.first > revision)
+            regions.push_back(region.second);
+    }
+
+    return true;
+}
+
+Rect Map::ClipRect(Rect const &rect) {
+    auto width {GetConfigs().map_width_};
+    auto height {GetConfigs().map_height_};
+    auto x {std::min(rect.GetX(), width)};
+    auto y {std::min(rect.GetY(), height)};
+
+    return {x, y, std::min(rect.GetWidth(), width - x), std::min(rect.GetHeight(), height - y)};
 }
     
 }
@@ -0,0 +1,283 @@
+#include "map_cache.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "constants.hpp"
+#include "hasher.hpp"
+#include "rnd_manager.hpp"
+#include "utils.hpp"
+
+namespace libpmg {
+
+static const char kArtifactMagic[4]         {'P', 'M', 'G', 'A'};
+static const std::uint32_t kArtifactVersion {1};
+
+/**
+ The header at the start of every artifact file.
+ */
+struct ArtifactHeader {
+    char magic_[4];
+    std::uint32_t version_;
+    std::uint64_t key_;
+    std::uint64_t count_;
+    std::uint64_t checksum_;
+};
+
+/**
+ Starts the hash of a key with the values shared by every map type.
+ */
+static Hasher GetKeyHasher(MapConfigs const &configs, MapFileType type, int seed, std::string const &recipe) {
+    Hasher hasher;
+    hasher.Add(std::string {kLibraryVersion});
+    hasher.Add(std::uint64_t {kRndStreamVersion});
+    hasher.Add(std::uint64_t {kMapFileVersion});
+    hasher.Add(static_cast<std::uint64_t>(type));
+    hasher.Add(static_cast<std::uint64_t>(seed));
+    hasher.Add(recipe);
+    hasher.Add(std::uint64_t {configs.map_width_});
+    hasher.Add(std::uint64_t {configs.map_height_});
+
+    return hasher;
+}
+
+/**
+ Writes a file through a temporary file, renamed once complete.
+ */
+static bool WriteAtomically(std::string const &path, std::function<bool(std::string const&)> const &write) {
+    auto temp_path {path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(std::hash<std::thread::id> {}(std::this_thread::get_id()))};
+
+    if (!write(temp_path) || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ Checks whether an artifact name is made of letters, digits, '-' and '_', so that its path can't leave the directory.
+ */
+static bool IsValidArtifactName(std::string const &name) {
+    return !name.empty() && std::all_of(name.begin(), name.end(), [] (char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+    });
+}
+
+/**
+ Reads a file of values, checking its header and checksum.
+ */
+static bool ReadValues(std::string const &path, std::uint64_t key, std::vector<std::uint32_t> &values) {
+    std::ifstream file {path, std::ios::binary};
+    if (!file)
+        return false;
+
+    ArtifactHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic_, kArtifactMagic, sizeof(kArtifactMagic)) != 0
+        || header.version_ != kArtifactVersion
+        || header.key_ != key)
+        return false;
+
+    // Check the size before allocating, since the header might be corrupted
+    file.seekg(0, std::ios::end);
+    if (static_cast<std::uint64_t>(file.tellg()) != sizeof(header) + header.count_ * sizeof(std::uint32_t))
+        return false;
+    file.seekg(sizeof(header));
+
+    std::vector<std::uint32_t> read_values(header.count_);
+    if (!file.read(reinterpret_cast<char*>(read_values.data()), read_values.size() * sizeof(std::uint32_t)))
+        return false;
+
+    Hasher hasher;
+    hasher.Add(read_values.data(), read_values.size() * sizeof(std::uint32_t));
+
+    if (hasher.GetHash() != header.checksum_) {
+        Utils::LogWarning("MapCache", path + " is corrupted.");
+        return false;
+    }
+
+    values = std::move(read_values);
+    return true;
+}
+
+/**
+ Writes a file of values, with a header holding their checksum.
+ */
+static bool WriteValues(std::string const &path, std::uint64_t key, std::vector<std::uint32_t> const &values) {
+    ArtifactHeader header;
+    std::memcpy(header.magic_, kArtifactMagic, sizeof(kArtifactMagic));
+    header.version_ = kArtifactVersion;
+    header.key_ = key;
+    header.count_ = values.size();
+
+    Hasher hasher;
+    hasher.Add(values.data(), values.size() * sizeof(std::uint32_t));
+    header.checksum_ = hasher.GetHash();
+
+    return WriteAtomically(path, [&] (std::string const &temp_path) {
+        std::ofstream file {temp_path, std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        file.write(reinterpret_cast<char const*>(values.data()), values.size() * sizeof(std::uint32_t));
+        file.close();
+
+        return static_cast<bool>(file);
+    });
+}
+
+MapCache::MapCache(std::string const &directory)
+: directory_ {directory}
+{
+    if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST)
+        Utils::LogError("MapCache", "Unable to create " + directory_);
+}
+
+std::uint64_t MapCache::GetKey(DungeonMapConfigs const &configs, int seed, std::string const &recipe) {
+    auto hasher {GetKeyHasher(configs, MapFileType::DUNGEON, seed, recipe)};
+    hasher.Add(std::uint64_t {configs.rooms_});
+    hasher.Add(std::uint64_t {configs.max_room_placement_attempts_});
+    hasher.Add(std::uint64_t {configs.max_room_width_});
+    hasher.Add(std::uint64_t {configs.max_room_height_});
+    hasher.Add(std::uint64_t {configs.min_room_width_});
+    hasher.Add(std::uint64_t {configs.min_room_height_});
+    hasher.Add(std::uint64_t {configs.min_upstairs_});
+    hasher.Add(std::uint64_t {configs.max_upstairs_});
+    hasher.Add(std::uint64_t {configs.min_downstairs_});
+    hasher.Add(std::uint64_t {configs.max_downstairs_});
+    hasher.Add(std::uint64_t {configs.build_stairs_only_in_rooms_});
+    hasher.Add(std::uint64_t {configs.dig_space_around_stairs});
+
+    return hasher.GetHash();
+}
+
+std::uint64_t MapCache::GetKey(WorldMapConfigs const &configs, int seed, std::string const &recipe) {
+    auto hasher {GetKeyHasher(configs, MapFileType::WORLD, seed, recipe)};
+    hasher.Add(static_cast<std::uint64_t>(configs.noise_type_));
+    hasher.Add(configs.noise_frequency_);
+    hasher.Add(configs.fractal_lacunarity_);
+    hasher.Add(configs.fractal_gain_);
+    hasher.Add(static_cast<std::uint64_t>(configs.fractal_octaves_));
+    hasher.Add(configs.extreme_multiplier_);
+    hasher.Add(configs.sea_level_multiplier_);
+    hasher.Add(configs.pole_elevation_multiplier_);
+
+    return hasher.GetHash();
+}
+
+std::string MapCache::GetPath(std::uint64_t key, std::string const &suffix) {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+
+    return directory_ + "/" + name + suffix;
+}
+
+bool MapCache::HasMap(std::uint64_t key) {
+    struct stat info;
+    return stat(GetPath(key, ".pmg").c_str(), &info) == 0;
+}
+
+bool MapCache::OpenMap(std::uint64_t key, MapFile &file) {
+    if (!HasMap(key) || !file.Open(GetPath(key, ".pmg")))
+        return false;
+
+    // The checksum of the whole file is stored next to it, as two 32 bit halves
+    std::vector<std::uint32_t> checksum;
+    auto expected {file.GetChecksum()};
+
+    if (!ReadValues(GetPath(key, ".pmg.sum"), key, checksum)
+        || checksum.size() != 2
+        || checksum[0] != static_cast<std::uint32_t>(expected)
+        || checksum[1] != static_cast<std::uint32_t>(expected >> 32)) {
+        Utils::LogWarning("MapCache::OpenMap", "The map " + GetPath(key, ".pmg") + " is corrupted, or has no checksum.");
+        file.Close();
+        return false;
+    }
+
+    return true;
+}
+
+std::unique_ptr<Map> MapCache::GetMap(std::uint64_t key, int seed, std::function<std::unique_ptr<Map>()> const &generate) {
+    MapFile file;
+
+    if (OpenMap(key, file))
+        return file.ToMap();
+
+    RndManager::seed_ = seed;
+    RndManager::GetInstance().ResetInstance();
+
+    auto map {generate()};
+    if (map == nullptr)
+        return map;
+
+    auto stored {WriteAtomically(GetPath(key, ".pmg"), [&] (std::string const &path) {
+        if (auto dungeon_map = dynamic_cast<DungeonMap*>(map.get()))
+            return MapFile::Save(*dungeon_map, path);
+
+        if (auto world_map = dynamic_cast<WorldMap*>(map.get()))
+            return MapFile::Save(*world_map, path);
+
+        return false;
+    })};
+
+    // The checksum is written after the map, so that a map is never trusted before its checksum is complete
+    if (stored) {
+        MapFile file;
+        stored = file.Open(GetPath(key, ".pmg"));
+
+        if (stored) {
+            auto checksum {file.GetChecksum()};
+            stored = WriteValues(GetPath(key, ".pmg.sum"), key, {static_cast<std::uint32_t>(checksum),
+                                                                 static_cast<std::uint32_t>(checksum >> 32)});
+        }
+    }
+
+    if (!stored)
+        Utils::LogWarning("MapCache::GetMap", "Unable to store the map in " + directory_);
+
+    return map;
+}
+
+std::vector<std::uint32_t> MapCache::GetArtifact(std::uint64_t key,
+                                                 std::string const &name,
+                                                 std::function<std::vector<std::uint32_t>()> const &compute) {
+    std::vector<std::uint32_t> artifact;
+
+    if (LoadArtifact(key, name, artifact))
+        return artifact;
+
+    artifact = compute();
+
+    if (!StoreArtifact(key, name, artifact))
+        Utils::LogWarning("MapCache::GetArtifact", "Unable to store the artifact " + name + " in " + directory_);
+
+    return artifact;
+}
+
+bool MapCache::LoadArtifact(std::uint64_t key, std::string const &name, std::vector<std::uint32_t> &artifact) {
+    if (!IsValidArtifactName(name)) {
+        Utils::LogError("MapCache::LoadArtifact", "Invalid artifact name " + name);
+        return false;
+    }
+
+    return ReadValues(GetPath(key, "." + name + ".pma"), key, artifact);
+}
+
+bool MapCache::StoreArtifact(std::uint64_t key, std::string const &name, std::vector<std::uint32_t> const &artifact) {
+    if (!IsValidArtifactName(name)) {
+        Utils::LogError("MapCache::StoreArtifact", "Invalid artifact name " + name);
+        return false;
+    }
+
+    return WriteValues(GetPath(key, "." + name + ".pma"), key, artifact);
+}
+
+}
@@ -0,0 +1,106 @@
+#include "map_digest.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+
+#include "hasher.hpp"
+#include "world_tile.hpp"
+
+namespace libpmg {
+
+/**
+ Adds a value to a hash in little endian order, whatever the byte order of the host.
+ */
+static void AddLittleEndian(Hasher &hasher, std::uint64_t value, std::size_t size) {
+    std::uint8_t bytes[8];
+
+    for (std::size_t i {0}; i < size; i++)
+        bytes[i] = static_cast<std::uint8_t>(value >> (8 * i));
+
+    hasher.Add(bytes, size);
+}
+
+std::uint64_t MapDigest::GetTagDigest(Map &map) {
+    std::vector<std::shared_ptr<Tag>> tags;
+    auto layer {map.GetFullTagLayer(tags)};
+
+    return GetTagDigest(layer.data(), map.GetConfigs().map_width_, map.GetConfigs().map_height_, tags);
+}
+
+std::uint64_t MapDigest::GetTagDigest(std::uint32_t const *layer,
+                                      std::size_t width,
+                                      std::size_t height,
+                                      std::vector<std::shared_ptr<Tag>> const &tags) {
+    // Sort the tags by name, and remap every mask to that order, so that the digest doesn't depend on the order
+    // in which the tags were first met
+    std::vector<std::size_t> order(tags.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&] (std::size_t a, std::size_t b) { return tags[a]->name_ < tags[b]->name_; });
+
+    std::vector<std::uint32_t> remapped_bit(tags.size());
+    for (std::size_t i {0}; i < order.size(); i++)
+        remapped_bit[order[i]] = std::uint32_t {1} << i;
+
+    Hasher hasher;
+    AddLittleEndian(hasher, width, 8);
+    AddLittleEndian(hasher, height, 8);
+    AddLittleEndian(hasher, tags.size(), 8);
+
+    for (auto const &t : order)
+        hasher.Add(tags[t]->name_);
+
+    // Runs of equal masks are common, so the last remapped mask is kept
+    std::uint32_t last_mask {0};
+    std::uint32_t last_remapped {0};
+
+    for (std::size_t i {0}; i < width * height; i++) {
+        if (layer[i] != last_mask) {
+            last_mask = layer[i];
+            last_remapped = 0;
+
+            for (std::size_t t {0}; t < tags.size(); t++) {
+                if (last_mask & std::uint32_t {1} << t)
+                    last_remapped |= remapped_bit[t];
+            }
+        }
+
+        AddLittleEndian(hasher, last_remapped, 4);
+    }
+
+    return hasher.GetHash();
+}
+
+std::uint64_t MapDigest::GetAltitudeDigest(WorldMap &map) {
+    auto &tiles {*map.GetMap()};
+    std::vector<float> altitude(tiles.size());
+
+    for (std::size_t i {0}; i < tiles.size(); i++)
+        altitude[i] = ((WorldTile*)tiles[i].get())->GetAltitude();
+
+    return GetAltitudeDigest(altitude.data(), map.GetConfigs().map_width_, map.GetConfigs().map_height_);
+}
+
+std::uint64_t MapDigest::GetAltitudeDigest(float const *altitude, std::size_t width, std::size_t height) {
+    Hasher hasher;
+    AddLittleEndian(hasher, width, 8);
+    AddLittleEndian(hasher, height, 8);
+
+    for (std::size_t i {0}; i < width * height; i++) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &altitude[i], sizeof(bits));
+        AddLittleEndian(hasher, bits, 4);
+    }
+
+    return hasher.GetHash();
+}
+
+std::string MapDigest::ToString(std::uint64_t digest) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(digest));
+
+    return text;
+}
+
+}
@@ -0,0 +1,205 @@
+#include "map_export.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+
+#include "constants.hpp"
+#include "utils.hpp"
+#include "world_tile.hpp"
+
+namespace libpmg {
+
+typedef std::array<std::uint8_t, 3> Color;
+
+/**
+ A lookup table from tag masks to values.
+ With few tags every mask is precomputed, otherwise the values are computed on first use.
+ */
+template <typename T>
+class MaskTable {
+public:
+    MaskTable(std::size_t tags, std::function<T(std::uint32_t)> const &compute) : compute_ {compute} {
+        if (tags > kMaxGlyphTableTags)
+            return;
+
+        dense_.resize(std::size_t {1} << tags);
+        for (std::uint32_t mask {0}; mask < dense_.size(); mask++)
+            dense_[mask] = compute_(mask);
+    }
+
+    inline T Get(std::uint32_t mask) {
+        if (!dense_.empty())
+            return dense_[mask & (dense_.size() - 1)];
+
+        auto value {sparse_.find(mask)};
+        if (value == sparse_.end())
+            value = sparse_.emplace(mask, compute_(mask)).first;
+
+        return value->second;
+    }
+
+    inline std::vector<T> &GetDense() { return dense_; }
+
+private:
+    std::function<T(std::uint32_t)> compute_;
+    std::vector<T> dense_;
+    std::unordered_map<std::uint32_t, T> sparse_;
+};
+
+/**
+ Gets the tag drawn for a mask, following the same rules of Tile::GetChar.
+ @return The index of the tag, or -1 if no tag has a positive draw priority
+ */
+static int GetDrawnTag(std::uint32_t mask, std::vector<std::shared_ptr<Tag>> const &tags) {
+    auto priority {0.0f};
+    auto drawn {-1};
+
+    for (std::size_t t {0}; t < tags.size(); t++) {
+        if ((mask & std::uint32_t {1} << t) && tags[t]->draw_priority_ > priority) {
+            priority = tags[t]->draw_priority_;
+            drawn = static_cast<int>(t);
+        }
+    }
+
+    return drawn;
+}
+
+/**
+ Gets the color of a tag, hashed from its name.
+ */
+static Color GetTagColor(Tag const &tag) {
+    std::uint32_t hash {2166136261};
+    for (auto c : tag.name_) {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= 16777619;
+    }
+
+    // Keep colors away from black, which is used for tiles with no drawn tag
+    return {static_cast<std::uint8_t>(64 + (hash & 0xBF)),
+            static_cast<std::uint8_t>(64 + (hash >> 8 & 0xBF)),
+            static_cast<std::uint8_t>(64 + (hash >> 16 & 0xBF))};
+}
+
+/**
+ Writes a binary PNM image.
+ */
+static bool WriteImage(std::string const &path, char const *format, std::size_t width, std::size_t height, std::vector<std::uint8_t> const &pixels) {
+    char header[64];
+    auto header_size {std::snprintf(header, sizeof(header), "%s\n%zu %zu\n255\n", format, width, height)};
+
+    std::ofstream file {path, std::ios::binary | std::ios::trunc};
+    file.write(header, header_size);
+    file.write(reinterpret_cast<char const*>(pixels.data()), pixels.size());
+    file.close();
+
+    if (!file) {
+        Utils::LogError("MapExport", "Unable to write " + path);
+        return false;
+    }
+
+    return true;
+}
+
+std::vector<char> MapExport::GetGlyphTable(std::vector<std::shared_ptr<Tag>> const &tags) {
+    assert(tags.size() <= kMaxGlyphTableTags);
+
+    MaskTable<char> glyphs {tags.size(), [&] (std::uint32_t mask) {
+        auto drawn {GetDrawnTag(mask, tags)};
+        return drawn < 0 ? kDefaultEmptyChar : tags[drawn]->sprite_;
+    }};
+
+    return std::move(glyphs.GetDense());
+}
+
+std::size_t MapExport::ExportAscii(Map &map, char *buffer, std::size_t size) {
+    std::vector<std::shared_ptr<Tag>> tags;
+    auto layer {map.GetFullTagLayer(tags)};
+
+    return ExportAscii(layer.data(), map.GetConfigs().map_width_, map.GetConfigs().map_height_, tags, buffer, size);
+}
+
+std::size_t MapExport::ExportAscii(std::uint32_t const *layer,
+                                   std::size_t width,
+                                   std::size_t height,
+                                   std::vector<std::shared_ptr<Tag>> const &tags,
+                                   char *buffer,
+                                   std::size_t size) {
+    if (size < GetAsciiSize(width, height))
+        return 0;
+
+    MaskTable<char> glyphs {tags.size(), [&] (std::uint32_t mask) {
+        auto drawn {GetDrawnTag(mask, tags)};
+        return drawn < 0 ? kDefaultEmptyChar : tags[drawn]->sprite_;
+    }};
+
+    auto out {buffer};
+    for (std::size_t y {0}; y < height; y++) {
+        auto row {layer + y * width};
+
+        for (std::size_t x {0}; x < width; x++)
+            *out++ = glyphs.Get(row[x]);
+
+        *out++ = '\n';
+    }
+
+    return out - buffer;
+}
+
+bool MapExport::ExportTagsPpm(Map &map, std::string const &path) {
+    std::vector<std::shared_ptr<Tag>> tags;
+    auto layer {map.GetFullTagLayer(tags)};
+
+    return ExportTagsPpm(layer.data(), map.GetConfigs().map_width_, map.GetConfigs().map_height_, tags, path);
+}
+
+bool MapExport::ExportTagsPpm(std::uint32_t const *layer,
+                              std::size_t width,
+                              std::size_t height,
+                              std::vector<std::shared_ptr<Tag>> const &tags,
+                              std::string const &path) {
+    MaskTable<Color> colors {tags.size(), [&] (std::uint32_t mask) {
+        auto drawn {GetDrawnTag(mask, tags)};
+        return drawn < 0 ? Color {0, 0, 0} : GetTagColor(*tags[drawn]);
+    }};
+
+    std::vector<std::uint8_t> pixels(width * height * 3);
+    for (std::size_t i {0}; i < width * height; i++) {
+        auto color {colors.Get(layer[i])};
+        std::memcpy(&pixels[i * 3], color.data(), 3);
+    }
+
+    return WriteImage(path, "P6", width, height, pixels);
+}
+
+bool MapExport::ExportAltitudePgm(WorldMap &map, std::string const &path) {
+    auto &tiles {*map.GetMap()};
+    std::vector<float> altitude(tiles.size());
+
+    for (std::size_t i {0}; i < tiles.size(); i++)
+        altitude[i] = ((WorldTile*)tiles[i].get())->GetAltitude();
+
+    return ExportAltitudePgm(altitude.data(), map.GetConfigs().map_width_, map.GetConfigs().map_height_, path);
+}
+
+bool MapExport::ExportAltitudePgm(float const *altitude, std::size_t width, std::size_t height, std::string const &path) {
+    auto size {width * height};
+    auto bounds {std::minmax_element(altitude, altitude + size)};
+    auto low {size ? *bounds.first : 0.0f};
+    auto range {size ? *bounds.second - low : 0.0f};
+
+    std::vector<std::uint8_t> pixels(size, 0);
+    if (range > 0.0f) {
+        for (std::size_t i {0}; i < size; i++)
+            pixels[i] = static_cast<std::uint8_t>((altitude[i] - low) / range * 255.0f + 0.5f);
+    }
+
+    return WriteImage(path, "P5", width, height, pixels);
+}
+
+}
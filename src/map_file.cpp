@@ -0,0 +1,569 @@
+#include "map_file.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hasher.hpp"
+#include "utils.hpp"
+#include "world_tile.hpp"
+
+namespace libpmg {
+
+static const char kMapFileMagic[4]          {'P', 'M', 'G', 'M'};
+static const std::uint32_t kByteOrderMark   {0x01020304};
+
+/**
+ The header at the start of every map file. Offsets are in bytes from the start of the file, 0 when missing.
+ */
+struct MapFileHeader {
+    char magic_[4];
+    std::uint32_t byte_order_;
+    std::uint32_t version_;
+    std::uint32_t type_;
+    std::uint64_t width_;
+    std::uint64_t height_;
+    std::uint64_t configs_offset_;
+    std::uint64_t tag_table_offset_;
+    std::uint64_t tag_count_;
+    std::uint64_t rooms_offset_;
+    std::uint64_t room_count_;
+    std::uint64_t tags_offset_;
+    std::uint64_t costs_offset_;
+    std::uint64_t altitude_offset_;
+    std::uint64_t biome_offset_;
+    std::uint64_t regions_offset_;
+    std::uint64_t corridor_count_;
+    std::uint64_t file_size_;
+};
+
+/**
+ A tag table entry.
+ */
+struct TagRecord {
+    char name_[kMapFileMaxTagName + 1];
+    char sprite_;
+    char padding_[3];
+    float draw_priority_;
+};
+
+/**
+ A room list entry.
+ */
+struct RoomRecord {
+    std::uint64_t x_, y_, width_, height_;
+};
+
+/**
+ The stored DungeonMapConfigs, with fixed width fields.
+ */
+struct DungeonConfigsRecord {
+    std::uint64_t rooms_;
+    std::uint64_t max_room_placement_attempts_;
+    std::uint64_t max_room_width_;
+    std::uint64_t max_room_height_;
+    std::uint64_t min_room_width_;
+    std::uint64_t min_room_height_;
+    std::uint64_t min_upstairs_;
+    std::uint64_t max_upstairs_;
+    std::uint64_t min_downstairs_;
+    std::uint64_t max_downstairs_;
+    std::uint8_t build_stairs_only_in_rooms_;
+    std::uint8_t dig_space_around_stairs_;
+    std::uint8_t padding_[6];
+};
+
+/**
+ The stored WorldMapConfigs, with fixed width fields.
+ */
+struct WorldConfigsRecord {
+    std::int32_t noise_type_;
+    float noise_frequency_;
+    float fractal_lacunarity_;
+    float fractal_gain_;
+    std::int32_t fractal_octaves_;
+    float extreme_multiplier_;
+    float sea_level_multiplier_;
+    float pole_elevation_multiplier_;
+};
+
+/**
+ Writes a map file section by section, keeping every section 8 bytes aligned.
+ */
+class MapFileWriter {
+public:
+    MapFileWriter(Map &map, MapFileType type) : map_ {map} {
+        std::memset(&header_, 0, sizeof(header_));
+        std::memcpy(header_.magic_, kMapFileMagic, sizeof(kMapFileMagic));
+        header_.byte_order_ = kByteOrderMark;
+        header_.version_ = kMapFileVersion;
+        header_.type_ = static_cast<std::uint32_t>(type);
+        header_.width_ = map.GetConfigs().map_width_;
+        header_.height_ = map.GetConfigs().map_height_;
+        
+        Append(&header_, sizeof(header_));
+    }
+    
+    /**
+     Appends a section, padding the buffer to 8 bytes first.
+     @return The offset of the section
+     */
+    std::uint64_t Append(void const *data, std::size_t size) {
+        buffer_.resize((buffer_.size() + 7) & ~std::size_t {7}, 0);
+        
+        auto offset {buffer_.size()};
+        auto bytes {static_cast<char const*>(data)};
+        buffer_.insert(buffer_.end(), bytes, bytes + size);
+        
+        return offset;
+    }
+    
+    /**
+     Appends the tag table, the tag layer and the cost layer of the map.
+     @return False if the map uses too many tags, or tags with names too long
+     */
+    bool AppendTiles() {
+        std::vector<std::shared_ptr<Tag>> tags;
+        std::unordered_map<Tag*, std::uint32_t> bits;
+        
+        auto size {map_.GetMap()->size()};
+        std::vector<std::uint32_t> tag_layer(size, 0);
+        std::vector<float> cost_layer(size);
+        
+        for (std::size_t i {0}; i < size; i++) {
+            auto &tile {(*map_.GetMap())[i]};
+            
+            for (auto const &tag : tile->GetTagList()) {
+                auto bit {bits.find(tag.get())};
+                
+                if (bit == bits.end()) {
+                    // Different instances of the same tag share the same bit, since tags are compared by name
+                    auto same {std::find_if(tags.begin(), tags.end(), [&] (auto &other) { return *other == *tag; })};
+                    auto index {static_cast<std::uint32_t>(same - tags.begin())};
+                    
+                    if (same == tags.end()) {
+                        if (tags.size() == 32 || tag->name_.size() > kMapFileMaxTagName) {
+                            Utils::LogError("MapFile::Save", "Maps can hold up to 32 tags, with names up to 55 chars.");
+                            return false;
+                        }
+                        tags.push_back(tag);
+                    }
+                    
+                    bit = bits.emplace(tag.get(), std::uint32_t {1} << index).first;
+                }
+                
+                tag_layer[i] |= bit->second;
+            }
+            
+            cost_layer[i] = tile->path_cost_;
+        }
+        
+        std::vector<TagRecord> records(tags.size());
+        for (std::size_t t {0}; t < tags.size(); t++) {
+            std::memset(&records[t], 0, sizeof(TagRecord));
+            std::memcpy(records[t].name_, tags[t]->name_.data(), tags[t]->name_.size());
+            records[t].sprite_ = tags[t]->sprite_;
+            records[t].draw_priority_ = tags[t]->draw_priority_;
+        }
+        
+        header_.tag_count_ = records.size();
+        header_.tag_table_offset_ = Append(records.data(), records.size() * sizeof(TagRecord));
+        header_.tags_offset_ = Append(tag_layer.data(), size * sizeof(std::uint32_t));
+        header_.costs_offset_ = Append(cost_layer.data(), size * sizeof(float));
+        
+        return true;
+    }
+    
+    /**
+     Patches the header and writes the buffer to a file.
+     @return True if the file was written, false otherwise
+     */
+    bool Write(std::string const &path) {
+        buffer_.resize((buffer_.size() + 7) & ~std::size_t {7}, 0);
+        header_.file_size_ = buffer_.size();
+        std::memcpy(buffer_.data(), &header_, sizeof(header_));
+        
+        std::ofstream file {path, std::ios::binary | std::ios::trunc};
+        file.write(buffer_.data(), buffer_.size());
+        
+        if (!file) {
+            Utils::LogError("MapFile::Save", "Unable to write " + path);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    MapFileHeader header_;
+    
+private:
+    Map &map_;
+    std::vector<char> buffer_;
+};
+
+MapFile::MapFile()
+: data_ {nullptr},
+size_ {0}
+{}
+
+MapFile::~MapFile() {
+    Close();
+}
+
+bool MapFile::Save(DungeonMap &map, std::string const &path) {
+    MapFileWriter writer {map, MapFileType::DUNGEON};
+    auto &configs {(DungeonMapConfigs&)map.GetConfigs()};
+    
+    DungeonConfigsRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.rooms_ = configs.rooms_;
+    record.max_room_placement_attempts_ = configs.max_room_placement_attempts_;
+    record.max_room_width_ = configs.max_room_width_;
+    record.max_room_height_ = configs.max_room_height_;
+    record.min_room_width_ = configs.min_room_width_;
+    record.min_room_height_ = configs.min_room_height_;
+    record.min_upstairs_ = configs.min_upstairs_;
+    record.max_upstairs_ = configs.max_upstairs_;
+    record.min_downstairs_ = configs.min_downstairs_;
+    record.max_downstairs_ = configs.max_downstairs_;
+    record.build_stairs_only_in_rooms_ = configs.build_stairs_only_in_rooms_;
+    record.dig_space_around_stairs_ = configs.dig_space_around_stairs;
+    writer.header_.configs_offset_ = writer.Append(&record, sizeof(record));
+    
+    std::vector<RoomRecord> rooms;
+    for (auto const &room : map.GetRoomList()) {
+        auto &rect {room->GetRect()};
+        rooms.push_back({rect.GetX(), rect.GetY(), rect.GetWidth(), rect.GetHeight()});
+    }
+    writer.header_.room_count_ = rooms.size();
+    writer.header_.rooms_offset_ = writer.Append(rooms.data(), rooms.size() * sizeof(RoomRecord));
+    
+    auto const &regions {map.GetRegionLayer()};
+    writer.header_.corridor_count_ = map.GetCorridorCount();
+    if (!regions.empty())
+        writer.header_.regions_offset_ = writer.Append(regions.data(), regions.size() * sizeof(std::uint32_t));
+    
+    return writer.AppendTiles() && writer.Write(path);
+}
+
+bool MapFile::Save(WorldMap &map, std::string const &path) {
+    MapFileWriter writer {map, MapFileType::WORLD};
+    auto &configs {(WorldMapConfigs&)map.GetConfigs()};
+    
+    WorldConfigsRecord record;
+    record.noise_type_ = configs.noise_type_;
+    record.noise_frequency_ = configs.noise_frequency_;
+    record.fractal_lacunarity_ = configs.fractal_lacunarity_;
+    record.fractal_gain_ = configs.fractal_gain_;
+    record.fractal_octaves_ = configs.fractal_octaves_;
+    record.extreme_multiplier_ = configs.extreme_multiplier_;
+    record.sea_level_multiplier_ = configs.sea_level_multiplier_;
+    record.pole_elevation_multiplier_ = configs.pole_elevation_multiplier_;
+    writer.header_.configs_offset_ = writer.Append(&record, sizeof(record));
+    
+    auto size {map.GetMap()->size()};
+    std::vector<float> altitude_layer(size);
+    std::vector<std::uint8_t> biome_layer(size);
+    
+    for (std::size_t i {0}; i < size; i++) {
+        auto tile {(WorldTile*)(*map.GetMap())[i].get()};
+        altitude_layer[i] = tile->altitude_;
+        biome_layer[i] = static_cast<std::uint8_t>(tile->biome_);
+    }
+    
+    writer.header_.altitude_offset_ = writer.Append(altitude_layer.data(), size * sizeof(float));
+    writer.header_.biome_offset_ = writer.Append(biome_layer.data(), size);
+    
+    return writer.AppendTiles() && writer.Write(path);
+}
+
+bool MapFile::Open(std::string const &path) {
+    Close();
+    
+    auto fd {open(path.c_str(), O_RDONLY)};
+    if (fd < 0) {
+        Utils::LogError("MapFile::Open", "Unable to open " + path);
+        return false;
+    }
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(MapFileHeader)) {
+        Utils::LogError("MapFile::Open", path + " is not a map file.");
+        close(fd);
+        return false;
+    }
+    
+    auto data {mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0)};
+    close(fd);
+    
+    if (data == MAP_FAILED) {
+        Utils::LogError("MapFile::Open", "Unable to map " + path);
+        return false;
+    }
+    
+    data_ = data;
+    size_ = info.st_size;
+    
+    auto header {static_cast<MapFileHeader const*>(data_)};
+    
+    // Sizes are checked for overflow before being multiplied, so that a crafted file can't wrap them into range
+    auto multiply = [] (std::uint64_t a, std::uint64_t b, std::uint64_t &product) {
+        if (b != 0 && a > std::numeric_limits<std::uint64_t>::max() / b)
+            return false;
+        
+        product = a * b;
+        return true;
+    };
+    
+    auto fits = [&] (std::uint64_t offset, std::uint64_t bytes) {
+        return offset == 0 || (offset % 8 == 0 && offset <= size_ && bytes <= size_ - offset);
+    };
+    
+    // The tag, cost and altitude layers hold 4 bytes per tile, biomes 1
+    std::uint64_t tiles {0}, tile_layer_bytes {0}, room_bytes {0}, configs_bytes {0};
+    
+    if (header->type_ == static_cast<std::uint32_t>(MapFileType::DUNGEON))
+        configs_bytes = sizeof(DungeonConfigsRecord);
+    else if (header->type_ == static_cast<std::uint32_t>(MapFileType::WORLD))
+        configs_bytes = sizeof(WorldConfigsRecord);
+    
+    if (std::memcmp(header->magic_, kMapFileMagic, sizeof(kMapFileMagic)) != 0
+        || header->byte_order_ != kByteOrderMark
+        || header->version_ != kMapFileVersion
+        || header->file_size_ != size_
+        || configs_bytes == 0
+        || header->tag_count_ > 32
+        || !multiply(header->width_, header->height_, tiles)
+        || !multiply(tiles, sizeof(std::uint32_t), tile_layer_bytes)
+        || !multiply(header->room_count_, sizeof(RoomRecord), room_bytes)
+        || !fits(header->configs_offset_, configs_bytes)
+        || !fits(header->tag_table_offset_, header->tag_count_ * sizeof(TagRecord))
+        || !fits(header->rooms_offset_, room_bytes)
+        || !fits(header->tags_offset_, tile_layer_bytes)
+        || !fits(header->costs_offset_, tile_layer_bytes)
+        || !fits(header->altitude_offset_, tile_layer_bytes)
+        || !fits(header->biome_offset_, tiles)
+        || !fits(header->regions_offset_, tile_layer_bytes)
+        || header->corridor_count_ > tiles
+        || (header->tag_table_offset_ == 0 && header->tag_count_ != 0)
+        || (header->rooms_offset_ == 0 && header->room_count_ != 0)
+        || header->tags_offset_ == 0
+        || header->costs_offset_ == 0) {
+        Utils::LogError("MapFile::Open", path + " is not a valid map file, or has a different version.");
+        Close();
+        return false;
+    }
+    
+    return true;
+}
+
+void MapFile::Close() {
+    if (data_ != nullptr)
+        munmap(data_, size_);
+    
+    data_ = nullptr;
+    size_ = 0;
+}
+
+void const *MapFile::At(std::uint64_t offset) const {
+    if (offset == 0)
+        return nullptr;
+    
+    return static_cast<char const*>(data_) + offset;
+}
+
+std::uint64_t MapFile::GetChecksum() const {
+    Hasher hasher;
+    hasher.Add(data_, size_);
+
+    return hasher.GetHash();
+}
+
+MapFileType MapFile::GetType() const {
+    return static_cast<MapFileType>(static_cast<MapFileHeader const*>(data_)->type_);
+}
+
+std::pair<std::size_t, std::size_t> MapFile::GetMapSize() const {
+    auto header {static_cast<MapFileHeader const*>(data_)};
+    return std::make_pair(header->width_, header->height_);
+}
+
+std::vector<std::shared_ptr<Tag>> MapFile::GetTagTable() const {
+    auto header {static_cast<MapFileHeader const*>(data_)};
+    auto records {static_cast<TagRecord const*>(At(header->tag_table_offset_))};
+    std::vector<std::shared_ptr<Tag>> tags;
+    
+    for (std::size_t t {0}; t < header->tag_count_; t++) {
+        std::string name {records[t].name_, strnlen(records[t].name_, kMapFileMaxTagName)};
+        auto tag {TagManager::GetInstance().GetTag(name)};
+        
+        if (tag == nullptr)
+            tag = std::make_shared<Tag>(records[t].sprite_, records[t].draw_priority_, name);
+        
+        tags.push_back(tag);
+    }
+    
+    return tags;
+}
+
+std::vector<Rect> MapFile::GetRooms() const {
+    auto header {static_cast<MapFileHeader const*>(data_)};
+    auto records {static_cast<RoomRecord const*>(At(header->rooms_offset_))};
+    std::vector<Rect> rooms;
+    
+    for (std::size_t r {0}; r < header->room_count_; r++)
+        rooms.emplace_back(records[r].x_, records[r].y_, records[r].width_, records[r].height_);
+    
+    return rooms;
+}
+
+std::size_t MapFile::GetCorridorCount() const {
+    return static_cast<MapFileHeader const*>(data_)->corridor_count_;
+}
+
+std::uint32_t const *MapFile::GetRegionLayer() const {
+    return static_cast<std::uint32_t const*>(At(static_cast<MapFileHeader const*>(data_)->regions_offset_));
+}
+
+DungeonMapConfigs MapFile::GetDungeonConfigs() const {
+    auto header {static_cast<MapFileHeader const*>(data_)};
+    DungeonMapConfigs configs {};
+    configs.map_width_ = header->width_;
+    configs.map_height_ = header->height_;
+    
+    if (GetType() != MapFileType::DUNGEON || !header->configs_offset_)
+        return configs;
+    
+    auto record {static_cast<DungeonConfigsRecord const*>(At(header->configs_offset_))};
+    configs.rooms_ = record->rooms_;
+    configs.max_room_placement_attempts_ = record->max_room_placement_attempts_;
+    configs.max_room_width_ = record->max_room_width_;
+    configs.max_room_height_ = record->max_room_height_;
+    configs.min_room_width_ = record->min_room_width_;
+    configs.min_room_height_ = record->min_room_height_;
+    configs.min_upstairs_ = record->min_upstairs_;
+    configs.max_upstairs_ = record->max_upstairs_;
+    configs.min_downstairs_ = record->min_downstairs_;
+    configs.max_downstairs_ = record->max_downstairs_;
+    configs.build_stairs_only_in_rooms_ = record->build_stairs_only_in_rooms_;
+    configs.dig_space_around_stairs = record->dig_space_around_stairs_;
+    
+    return configs;
+}
+
+WorldMapConfigs MapFile::GetWorldConfigs() const {
+    auto header {static_cast<MapFileHeader const*>(data_)};
+    WorldMapConfigs configs;
+    configs.map_width_ = header->width_;
+    configs.map_height_ = header->height_;
+    
+    if (GetType() != MapFileType::WORLD || !header->configs_offset_)
+        return configs;
+    
+    auto record {static_cast<WorldConfigsRecord const*>(At(header->configs_offset_))};
+    configs.noise_type_ = static_cast<FastNoise::NoiseType>(record->noise_type_);
+    configs.noise_frequency_ = record->noise_frequency_;
+    configs.fractal_lacunarity_ = record->fractal_lacunarity_;
+    configs.fractal_gain_ = record->fractal_gain_;
+    configs.fractal_octaves_ = record->fractal_octaves_;
+    configs.extreme_multiplier_ = record->extreme_multiplier_;
+    configs.sea_level_multiplier_ = record->sea_level_multiplier_;
+    configs.pole_elevation_multiplier_ = record->pole_elevation_multiplier_;
+    
+    return configs;
+}
+
+std::uint32_t const *MapFile::GetTagLayer() const {
+    return static_cast<std::uint32_t const*>(At(static_cast<MapFileHeader const*>(data_)->tags_offset_));
+}
+
+float const *MapFile::GetCostLayer() const {
+    return static_cast<float const*>(At(static_cast<MapFileHeader const*>(data_)->costs_offset_));
+}
+
+float const *MapFile::GetAltitudeLayer() const {
+    return static_cast<float const*>(At(static_cast<MapFileHeader const*>(data_)->altitude_offset_));
+}
+
+std::uint8_t const *MapFile::GetBiomeLayer() const {
+    return static_cast<std::uint8_t const*>(At(static_cast<MapFileHeader const*>(data_)->biome_offset_));
+}
+
+std::unique_ptr<Map> MapFile::ToMap() const {
+    assert(IsOpen());
+    
+    auto size {GetMapSize()};
+    auto tags {GetTagTable()};
+    auto tag_layer {GetTagLayer()};
+    auto cost_layer {GetCostLayer()};
+    
+    std::unique_ptr<Map> map;
+    
+    if (GetType() == MapFileType::DUNGEON) {
+        auto configs {GetDungeonConfigs()};
+        auto dungeon_map {std::make_unique<DungeonMap>(configs)};
+        
+        for (auto const &rect : GetRooms())
+            dungeon_map->AddRoom(std::make_unique<Room>(rect));
+        
+        // Rooms label the same tiles again, so adding the corridors in order gives every tile its stored label back
+        std::vector<std::vector<std::size_t>> corridors(GetCorridorCount());
+        if (auto region_layer = GetRegionLayer()) {
+            for (std::size_t i {0}; i < size.first * size.second; i++) {
+                auto corridor {(region_layer[i] & ~kCorridorRegion) - 1};
+                
+                if (region_layer[i] & kCorridorRegion && corridor < corridors.size())
+                    corridors[corridor].push_back(i);
+            }
+        }
+        
+        for (auto const &tiles : corridors)
+            dungeon_map->AddCorridor(tiles);
+        
+        map = std::move(dungeon_map);
+    } else {
+        auto configs {GetWorldConfigs()};
+        map = std::make_unique<WorldMap>(configs);
+    }
+    
+    auto altitude_layer {GetAltitudeLayer()};
+    auto biome_layer {GetBiomeLayer()};
+    map->GetMap()->reserve(size.first * size.second);
+    
+    for (std::size_t y {0}; y < size.second; y++) {
+        for (std::size_t x {0}; x < size.first; x++) {
+            auto i {y * size.first + x};
+            
+            std::vector<std::shared_ptr<Tag>> tile_tags;
+            for (std::size_t t {0}; t < tags.size(); t++) {
+                if (tag_layer[i] & std::uint32_t {1} << t)
+                    tile_tags.push_back(tags[t]);
+            }
+            
+            if (GetType() == MapFileType::WORLD) {
+                auto tile {std::make_unique<WorldTile>(x, y)};
+                tile->RemoveTags({TagManager::GetInstance().wall_tag_});
+                tile->AddTags(tile_tags);
+                tile->altitude_ = altitude_layer != nullptr ? altitude_layer[i] : 0.0f;
+                tile->biome_ = static_cast<BiomeType>(biome_layer != nullptr ? biome_layer[i] : 0);
+                map->GetMap()->push_back(std::move(tile));
+            } else {
+                map->GetMap()->push_back(std::make_unique<Tile>(x, y, tile_tags));
+            }
+            
+            map->GetMap()->back()->path_cost_ = cost_layer[i];
+        }
+    }
+    
+    return map;
+}
+
+}
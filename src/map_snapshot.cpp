@@ -0,0 +1,485 @@
+#include "map_snapshot.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "tag_manager.hpp"
+#include "utils.hpp"
+
+namespace libpmg {
+
+static const char kMapSnapshotMagic[4]      {'P', 'M', 'G', 'S'};
+static const std::uint8_t kEntropyStageFlag {1};
+static const std::size_t kMaxVarintBytes    {10};
+static const std::size_t kMaxSnapshotSide   {1 << 16};
+static const std::uint32_t kRiceEscape      {16};
+
+/**
+ Appends an unsigned LEB128 varint.
+ */
+static void PutVarint(std::vector<std::uint8_t> &out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+/**
+ Reads an unsigned LEB128 varint, advancing the cursor.
+ @return False if the data ends before the varint, or the varint is too long
+ */
+static bool GetVarint(std::uint8_t const *&cursor, std::uint8_t const *end, std::uint64_t &value) {
+    value = 0;
+
+    for (std::size_t i {0}; i < kMaxVarintBytes && cursor != end; i++) {
+        auto byte {*cursor++};
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << (7 * i);
+
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ Gets the number of bits needed to store every value up to the specified one.
+ */
+static unsigned BitWidth(std::uint64_t value) {
+    unsigned bits {0};
+    while (value >> bits)
+        bits++;
+    return bits;
+}
+
+/**
+ Writes values as a stream of bits, most significant bit first.
+ */
+class BitWriter {
+public:
+    BitWriter(std::vector<std::uint8_t> &out) : out_ {out}, bits_ {0}, count_ {0} {}
+
+    void Put(std::uint32_t value, unsigned bits) {
+        if (bits == 0)
+            return;
+
+        bits_ = bits_ << bits | (value & ((std::uint64_t {1} << bits) - 1));
+        count_ += bits;
+
+        while (count_ >= 8) {
+            count_ -= 8;
+            out_.push_back(static_cast<std::uint8_t>(bits_ >> count_));
+        }
+    }
+
+    void Flush() {
+        if (count_ > 0)
+            out_.push_back(static_cast<std::uint8_t>(bits_ << (8 - count_)));
+        count_ = 0;
+    }
+
+private:
+    std::vector<std::uint8_t> &out_;
+    std::uint64_t bits_;
+    unsigned count_;
+};
+
+/**
+ Reads values from a stream of bits written by BitWriter.
+ */
+class BitReader {
+public:
+    BitReader(std::uint8_t const *data, std::uint8_t const *end) : data_ {data}, end_ {end}, bits_ {0}, count_ {0}, overrun_ {false} {}
+
+    std::uint32_t Get(unsigned bits) {
+        if (bits == 0)
+            return 0;
+
+        while (count_ < bits) {
+            if (data_ == end_) {
+                overrun_ = true;
+                return 0;
+            }
+            bits_ = bits_ << 8 | *data_++;
+            count_ += 8;
+        }
+
+        count_ -= bits;
+        return static_cast<std::uint32_t>((bits_ >> count_) & ((std::uint64_t {1} << bits) - 1));
+    }
+
+    inline bool IsOverrun() const { return overrun_; }
+    inline bool IsExhausted() const { return data_ == end_; }
+
+private:
+    std::uint8_t const *data_, *end_;
+    std::uint64_t bits_;
+    unsigned count_;
+    bool overrun_;
+};
+
+/**
+ Gets the Rice parameter for the running sum and count of the coded values, so that it follows their mean.
+ */
+static unsigned GetRiceParameter(std::uint64_t sum, std::uint64_t count) {
+    unsigned k {0};
+    while ((count << k) < sum)
+        k++;
+    return k;
+}
+
+/**
+ Updates the running sum and count of the coded values, halving the history every 32 values.
+ */
+static void UpdateRiceState(std::uint64_t &sum, std::uint64_t &count, std::uint64_t value) {
+    sum += value;
+
+    if (++count == 32) {
+        sum >>= 1;
+        count >>= 1;
+    }
+}
+
+MapSnapshotEncoder::MapSnapshotEncoder(Map &map, bool entropy_stage)
+: width_ {map.GetConfigs().map_width_},
+height_ {map.GetConfigs().map_height_},
+entropy_stage_ {entropy_stage},
+next_row_ {0},
+rice_sum_ {0},
+rice_count_ {0}
+{
+    layer_ = map.GetFullTagLayer(tags_);
+    BuildPalette();
+}
+
+MapSnapshotEncoder::MapSnapshotEncoder(std::vector<std::uint32_t> layer,
+                                       std::size_t width,
+                                       std::size_t height,
+                                       std::vector<std::shared_ptr<Tag>> tags,
+                                       bool entropy_stage)
+: layer_ {std::move(layer)},
+width_ {width},
+height_ {height},
+tags_ {std::move(tags)},
+entropy_stage_ {entropy_stage},
+next_row_ {0},
+rice_sum_ {0},
+rice_count_ {0}
+{
+    assert(layer_.size() >= width_ * height_);
+    assert(tags_.size() <= 32);
+
+    BuildPalette();
+}
+
+void MapSnapshotEncoder::BuildPalette() {
+    for (std::size_t i {0}; i < width_ * height_; i++) {
+        if (palette_map_.emplace(layer_[i], palette_.size()).second)
+            palette_.push_back(layer_[i]);
+    }
+}
+
+void MapSnapshotEncoder::EncodeHeader(std::vector<std::uint8_t> &out) {
+    // The header starts a new snapshot
+    next_row_ = 0;
+    rice_sum_ = std::max<std::uint64_t>(2, (width_ + 32) / 64);
+    rice_count_ = 1;
+
+    row_buffer_.assign(kMapSnapshotMagic, kMapSnapshotMagic + sizeof(kMapSnapshotMagic));
+    row_buffer_.push_back(kMapSnapshotVersion);
+    row_buffer_.push_back(entropy_stage_ ? kEntropyStageFlag : 0);
+
+    PutVarint(row_buffer_, width_);
+    PutVarint(row_buffer_, height_);
+
+    PutVarint(row_buffer_, tags_.size());
+    for (auto const &tag : tags_) {
+        PutVarint(row_buffer_, tag->name_.size());
+        row_buffer_.insert(row_buffer_.end(), tag->name_.begin(), tag->name_.end());
+        row_buffer_.push_back(static_cast<std::uint8_t>(tag->sprite_));
+
+        // The draw priority is sent as the little endian bits of the float
+        std::uint32_t priority;
+        std::memcpy(&priority, &tag->draw_priority_, sizeof(priority));
+        for (auto shift {0}; shift < 32; shift += 8)
+            row_buffer_.push_back(static_cast<std::uint8_t>(priority >> shift));
+    }
+
+    PutVarint(row_buffer_, palette_.size());
+    for (auto value : palette_)
+        PutVarint(row_buffer_, value);
+
+    PutVarint(out, row_buffer_.size());
+    out.insert(out.end(), row_buffer_.begin(), row_buffer_.end());
+}
+
+bool MapSnapshotEncoder::EncodeRow(std::vector<std::uint8_t> &out) {
+    if (IsComplete())
+        return false;
+
+    auto row {&layer_[next_row_ * width_]};
+    auto index_bits {BitWidth(palette_.size() - 1)};
+
+    row_buffer_.clear();
+    BitWriter writer {row_buffer_};
+    std::uint32_t previous[2] {0, 0};
+    std::size_t runs {0};
+
+    for (std::size_t x {0}; x < width_;) {
+        auto start {x};
+        while (x < width_ && row[x] == row[start])
+            x++;
+
+        auto index {palette_map_[row[start]]};
+        std::uint64_t length {x - start - 1};
+
+        if (!entropy_stage_) {
+            // Pack the palette index in the lowest bits of the run length
+            PutVarint(row_buffer_, length << index_bits | index);
+            continue;
+        }
+
+        // Rows mostly alternate between two values, so the index of a run is predicted to be the one two runs back
+        if (index_bits > 1 && runs >= 2 && index == previous[1]) {
+            writer.Put(1, 1);
+        } else {
+            if (index_bits > 1)
+                writer.Put(0, 1);
+            writer.Put(index, index_bits);
+        }
+
+        auto k {GetRiceParameter(rice_sum_, rice_count_)};
+        auto quotient {length >> k};
+
+        if (quotient < kRiceEscape) {
+            for (std::uint64_t q {0}; q < quotient; q++)
+                writer.Put(1, 1);
+            writer.Put(0, 1);
+            writer.Put(static_cast<std::uint32_t>(length), k);
+        } else {
+            for (std::uint32_t q {0}; q < kRiceEscape; q++)
+                writer.Put(1, 1);
+            writer.Put(static_cast<std::uint32_t>(length), BitWidth(width_ - 1));
+        }
+
+        UpdateRiceState(rice_sum_, rice_count_, length);
+        previous[1] = previous[0];
+        previous[0] = index;
+        runs++;
+    }
+
+    writer.Flush();
+
+    PutVarint(out, row_buffer_.size());
+    out.insert(out.end(), row_buffer_.begin(), row_buffer_.end());
+    next_row_++;
+
+    return true;
+}
+
+std::vector<std::uint8_t> MapSnapshotEncoder::Encode() {
+    std::vector<std::uint8_t> out;
+
+    EncodeHeader(out);
+    while (EncodeRow(out));
+
+    return out;
+}
+
+MapSnapshotDecoder::MapSnapshotDecoder(std::size_t max_tiles)
+: max_tiles_ {max_tiles},
+has_header_ {false},
+failed_ {false},
+entropy_stage_ {false},
+width_ {0},
+height_ {0},
+decoded_rows_ {0},
+rice_sum_ {0},
+rice_count_ {0}
+{}
+
+bool MapSnapshotDecoder::Feed(void const *data, std::size_t size) {
+    if (failed_)
+        return false;
+
+    auto bytes {static_cast<std::uint8_t const*>(data)};
+    buffer_.insert(buffer_.end(), bytes, bytes + size);
+
+    std::uint8_t const *start {buffer_.data()};
+    std::uint8_t const *end {buffer_.data() + buffer_.size()};
+
+    while (!IsComplete()) {
+        auto cursor {start};
+        std::uint64_t length;
+
+        // Stop at the first incomplete chunk, waiting for more data
+        if (!GetVarint(cursor, end, length)) {
+            if (static_cast<std::size_t>(end - start) >= kMaxVarintBytes)
+                failed_ = true;
+            break;
+        }
+
+        if (length > static_cast<std::uint64_t>(end - cursor))
+            break;
+
+        if (!(has_header_ ? DecodeRow(cursor, length) : DecodeHeader(cursor, length))) {
+            failed_ = true;
+            break;
+        }
+
+        start = cursor + length;
+    }
+
+    if (failed_) {
+        Utils::LogError("MapSnapshotDecoder::Feed", "Malformed snapshot.");
+        buffer_.clear();
+        return false;
+    }
+
+    buffer_.erase(buffer_.begin(), buffer_.begin() + (start - buffer_.data()));
+    return true;
+}
+
+bool MapSnapshotDecoder::DecodeHeader(std::uint8_t const *data, std::size_t size) {
+    auto cursor {data};
+    auto end {data + size};
+    std::uint64_t width, height, tag_count, palette_size;
+
+    if (size < sizeof(kMapSnapshotMagic) + 2
+        || std::memcmp(cursor, kMapSnapshotMagic, sizeof(kMapSnapshotMagic)) != 0
+        || cursor[4] != kMapSnapshotVersion)
+        return false;
+
+    entropy_stage_ = cursor[5] & kEntropyStageFlag;
+    cursor += sizeof(kMapSnapshotMagic) + 2;
+
+    if (!GetVarint(cursor, end, width)
+        || !GetVarint(cursor, end, height)
+        || !GetVarint(cursor, end, tag_count)
+        || width > kMaxSnapshotSide
+        || height > kMaxSnapshotSide
+        || width * height > max_tiles_
+        || tag_count > 32)
+        return false;
+
+    tags_.clear();
+    for (std::uint64_t t {0}; t < tag_count; t++) {
+        std::uint64_t name_size;
+
+        if (!GetVarint(cursor, end, name_size) || name_size + 5 > static_cast<std::uint64_t>(end - cursor))
+            return false;
+
+        std::string name {reinterpret_cast<char const*>(cursor), name_size};
+        cursor += name_size;
+
+        auto sprite {static_cast<char>(*cursor++)};
+        std::uint32_t bits {0};
+        for (auto shift {0}; shift < 32; shift += 8)
+            bits |= static_cast<std::uint32_t>(*cursor++) << shift;
+
+        float priority;
+        std::memcpy(&priority, &bits, sizeof(priority));
+
+        auto tag {TagManager::GetInstance().GetTag(name)};
+        if (tag == nullptr)
+            tag = std::make_shared<Tag>(sprite, priority, name);
+
+        tags_.push_back(tag);
+    }
+
+    if (!GetVarint(cursor, end, palette_size) || palette_size > width * height || (palette_size == 0 && width * height != 0))
+        return false;
+
+    palette_.clear();
+    for (std::uint64_t p {0}; p < palette_size; p++) {
+        std::uint64_t value;
+
+        if (!GetVarint(cursor, end, value) || value > UINT32_MAX)
+            return false;
+
+        palette_.push_back(static_cast<std::uint32_t>(value));
+    }
+
+    width_ = width;
+    height_ = height;
+    decoded_rows_ = 0;
+    rice_sum_ = std::max<std::uint64_t>(2, (width_ + 32) / 64);
+    rice_count_ = 1;
+    layer_.assign(width_ * height_, 0);
+    has_header_ = true;
+
+    return cursor == end;
+}
+
+bool MapSnapshotDecoder::DecodeRow(std::uint8_t const *data, std::size_t size) {
+    auto row {&layer_[decoded_rows_ * width_]};
+    auto index_bits {BitWidth(palette_.size() - 1)};
+    auto end {data + size};
+
+    if (!entropy_stage_) {
+        auto cursor {data};
+
+        for (std::size_t x {0}; x < width_;) {
+            std::uint64_t run;
+            if (!GetVarint(cursor, end, run))
+                return false;
+
+            auto index {run & ((std::uint64_t {1} << index_bits) - 1)};
+            auto length {(run >> index_bits) + 1};
+
+            if (index >= palette_.size() || length > width_ - x)
+                return false;
+
+            std::fill(row + x, row + x + length, palette_[index]);
+            x += length;
+        }
+
+        decoded_rows_++;
+        return cursor == end;
+    }
+
+    BitReader reader {data, end};
+    std::uint32_t previous[2] {0, 0};
+    std::size_t runs {0};
+
+    for (std::size_t x {0}; x < width_;) {
+        std::uint32_t index;
+
+        if (index_bits > 1 && reader.Get(1)) {
+            if (runs < 2)
+                return false;
+            index = previous[1];
+        } else {
+            index = reader.Get(index_bits);
+        }
+
+        auto k {GetRiceParameter(rice_sum_, rice_count_)};
+        std::uint64_t quotient {0};
+        while (quotient < kRiceEscape && reader.Get(1) && !reader.IsOverrun())
+            quotient++;
+
+        std::uint64_t length;
+        if (quotient < kRiceEscape)
+            length = quotient << k | reader.Get(k);
+        else
+            length = reader.Get(BitWidth(width_ - 1));
+
+        if (reader.IsOverrun() || index >= palette_.size() || length + 1 > width_ - x)
+            return false;
+
+        std::fill(row + x, row + x + length + 1, palette_[index]);
+        x += length + 1;
+
+        UpdateRiceState(rice_sum_, rice_count_, length);
+        previous[1] = previous[0];
+        previous[0] = index;
+        runs++;
+    }
+
+    decoded_rows_++;
+    return reader.IsExhausted();
+}
+
+}
@@ -0,0 +1,41 @@
+#include "neighbor_mask.hpp"
+
+namespace libpmg {
+
+std::vector<std::uint8_t> NeighborMask::Compute(std::vector<std::uint32_t> const &layer,
+                                                std::size_t width,
+                                                std::size_t height,
+                                                std::uint32_t bits) {
+    std::vector<std::uint8_t> masks(width * height, 0);
+
+    if (width < 3 || height < 3 || layer.size() < width * height)
+        return masks;
+
+    // Flatten the selected bits into a 0/1 plane, so that the mask pass is made only of
+    // branchless shifts and ors over contiguous bytes, which the compiler can vectorize
+    std::vector<std::uint8_t> plane(width * height);
+    for (std::size_t i {0}; i < plane.size(); i++)
+        plane[i] = (layer[i] & bits) != 0;
+
+    for (std::size_t y {1}; y < height - 1; y++) {
+        auto up {&plane[(y - 1) * width]};
+        auto row {&plane[y * width]};
+        auto down {&plane[(y + 1) * width]};
+        auto out {&masks[y * width]};
+
+        for (std::size_t x {1}; x < width - 1; x++) {
+            out[x] = up[x]
+                | row[x + 1] << 1
+                | down[x] << 2
+                | row[x - 1] << 3
+                | up[x - 1] << 4
+                | down[x + 1] << 5
+                | down[x - 1] << 6
+                | up[x + 1] << 7;
+        }
+    }
+
+    return masks;
+}
+
+}
@@ -0,0 +1,38 @@
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace libpmg {
+
+std::size_t Parallel::GetThreads(std::size_t threads, std::size_t count) {
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    
+    return std::max<std::size_t>(1, std::min(threads, count));
+}
+
+void Parallel::ForEachIndex(std::size_t count,
+                            std::size_t threads,
+                            std::function<void(std::size_t, std::size_t)> const &function) {
+    threads = GetThreads(threads, count);
+    
+    std::atomic<std::size_t> next_index {0};
+    auto worker = [&] (std::size_t thread) {
+        for (auto index {next_index++}; index < count; index = next_index++)
+            function(index, thread);
+    };
+    
+    std::vector<std::thread> workers;
+    for (std::size_t i {1}; i < threads; i++)
+        workers.emplace_back(worker, i);
+    
+    worker(0);
+    
+    for (auto &thread : workers)
+        thread.join();
+}
+
+}
@@ -0,0 +1,220 @@
+#include "path_service.hpp"
+
+#include <algorithm>
+
+#include "neighbor_mask.hpp"
+#include "tag_manager.hpp"
+
+namespace libpmg {
+
+PathService::PathService(Map &map, MoveDirections const &dir, std::size_t threads)
+: width_ {map.GetConfigs().map_width_},
+height_ {map.GetConfigs().map_height_},
+dir_ {dir}
+{
+    auto layer {map.GetTagLayer({TagManager::GetInstance().wall_tag_})};
+
+    walkable_.resize(layer.size());
+    for (std::size_t i {0}; i < layer.size(); i++)
+        walkable_[i] = layer[i] == 0;
+
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (std::size_t i {0}; i < threads; i++)
+        workers_.emplace_back(&PathService::WorkerLoop, this);
+}
+
+PathService::~PathService() {
+    {
+        std::lock_guard<std::mutex> lock {mutex_};
+        stopping_ = true;
+    }
+
+    work_ready_.notify_all();
+
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+std::future<PathResult> PathService::Submit(std::size_t start, std::size_t goal) {
+    PendingQuery query {start, {}, nullptr};
+    auto future {query.promise_.get_future()};
+
+    Enqueue(goal, std::move(query));
+
+    return future;
+}
+
+void PathService::Submit(std::size_t start, std::size_t goal, std::function<void(PathResult const&)> const &callback) {
+    Enqueue(goal, {start, {}, callback});
+}
+
+void PathService::WaitIdle() {
+    std::unique_lock<std::mutex> lock {mutex_};
+    idle_.wait(lock, [&] { return goals_.empty() && running_ == 0; });
+}
+
+PathServiceStats PathService::GetStats() const {
+    std::lock_guard<std::mutex> lock {mutex_};
+    PathServiceStats stats {queries_, searches_, 0.0, 0.0};
+
+    if (has_submitted_ && stats.queries_ > 0) {
+        stats.seconds_ = std::chrono::duration<double> {last_answer_ - first_submit_}.count();
+
+        if (stats.seconds_ > 0.0)
+            stats.queries_per_second_ = stats.queries_ / stats.seconds_;
+    }
+
+    return stats;
+}
+
+void PathService::ResetStats() {
+    std::lock_guard<std::mutex> lock {mutex_};
+
+    queries_ = 0;
+    searches_ = 0;
+    has_submitted_ = false;
+}
+
+void PathService::Enqueue(std::size_t goal, PendingQuery query) {
+    {
+        std::lock_guard<std::mutex> lock {mutex_};
+
+        if (!has_submitted_) {
+            first_submit_ = std::chrono::steady_clock::now();
+            has_submitted_ = true;
+        }
+
+        // Queries joining a goal already waiting are answered by the same search
+        auto &queries {pending_[goal]};
+        if (queries.empty())
+            goals_.push_back(goal);
+
+        queries.push_back(std::move(query));
+    }
+
+    work_ready_.notify_one();
+}
+
+void PathService::WorkerLoop() {
+    Scratch scratch;
+    scratch.visited_.assign(walkable_.size(), 0);
+    scratch.targets_.assign(walkable_.size(), 0);
+    scratch.parents_.assign(walkable_.size(), 0);
+
+    while (true) {
+        std::vector<PendingQuery> queries;
+        std::size_t goal;
+
+        {
+            std::unique_lock<std::mutex> lock {mutex_};
+            work_ready_.wait(lock, [&] { return stopping_ || !goals_.empty(); });
+
+            // The queue is drained before stopping
+            if (goals_.empty())
+                return;
+
+            goal = goals_.front();
+            goals_.pop_front();
+
+            auto it {pending_.find(goal)};
+            queries = std::move(it->second);
+            pending_.erase(it);
+            running_ += queries.size();
+        }
+
+        Answer(goal, queries, scratch);
+
+        {
+            std::lock_guard<std::mutex> lock {mutex_};
+
+            running_ -= queries.size();
+            queries_ += queries.size();
+            last_answer_ = std::chrono::steady_clock::now();
+
+            if (goals_.empty() && running_ == 0)
+                idle_.notify_all();
+        }
+    }
+}
+
+void PathService::Answer(std::size_t goal, std::vector<PendingQuery> &queries, Scratch &scratch) {
+    auto is_walkable = [&] (std::size_t index) { return index < walkable_.size() && walkable_[index]; };
+    auto goal_walkable {is_walkable(goal)};
+
+    if (goal_walkable) {
+        // Stamps tell the tiles of this search from the ones of the previous searches, until they wrap around
+        if (++scratch.stamp_ == 0) {
+            std::fill(scratch.visited_.begin(), scratch.visited_.end(), 0);
+            std::fill(scratch.targets_.begin(), scratch.targets_.end(), 0);
+            scratch.stamp_ = 1;
+        }
+
+        auto stamp {scratch.stamp_};
+        std::size_t remaining {0};
+
+        for (auto const &query : queries) {
+            if (is_walkable(query.start_) && scratch.targets_[query.start_] != stamp) {
+                scratch.targets_[query.start_] = stamp;
+                remaining++;
+            }
+        }
+
+        // Search backwards from the goal, so that the parents lead every start to it
+        auto &frontier {scratch.frontier_};
+        auto neighbours {dir_ == MoveDirections::EIGHT_DIRECTIONAL ? 8 : 4};
+
+        frontier.assign(1, static_cast<std::uint32_t>(goal));
+        scratch.visited_[goal] = stamp;
+        scratch.parents_[goal] = static_cast<std::uint32_t>(goal);
+        if (scratch.targets_[goal] == stamp)
+            remaining--;
+
+        for (std::size_t head {0}; head < frontier.size() && remaining > 0; head++) {
+            auto current {frontier[head]};
+            auto x {current % width_};
+            auto y {current / width_};
+
+            for (auto n {0}; n < neighbours; n++) {
+                auto nx {x + kNeighborOffsets[n][0]};
+                auto ny {y + kNeighborOffsets[n][1]};
+
+                if (nx >= width_ || ny >= height_)
+                    continue;
+
+                auto nei {ny * width_ + nx};
+                if (!walkable_[nei] || scratch.visited_[nei] == stamp)
+                    continue;
+
+                scratch.visited_[nei] = stamp;
+                scratch.parents_[nei] = current;
+                frontier.push_back(static_cast<std::uint32_t>(nei));
+
+                if (scratch.targets_[nei] == stamp)
+                    remaining--;
+            }
+        }
+
+        searches_++;
+    }
+
+    for (auto &query : queries) {
+        PathResult result {false, {}};
+
+        if (goal_walkable && is_walkable(query.start_) && scratch.visited_[query.start_] == scratch.stamp_) {
+            result.found_ = true;
+
+            for (auto tile {query.start_}; tile != goal; tile = scratch.parents_[tile])
+                result.path_.push_back(tile);
+            result.path_.push_back(goal);
+        }
+
+        if (query.callback_)
+            query.callback_(result);
+        else
+            query.promise_.set_value(std::move(result));
+    }
+}
+
+}
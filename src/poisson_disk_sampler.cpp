@@ -0,0 +1,125 @@
+#include "poisson_disk_sampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "index_sampler.hpp"
+#include "rnd_manager.hpp"
+
+namespace libpmg {
+
+static const std::size_t kNoPoint {static_cast<std::size_t>(-1)};
+
+PoissonDiskSampler::PoissonDiskSampler(std::size_t width,
+                                       std::size_t height,
+                                       float min_distance,
+                                       std::size_t max_attempts)
+: width_ {width},
+height_ {height},
+min_distance_ {std::max(min_distance, 1.0f)},
+max_attempts_ {max_attempts},
+cell_size_ {min_distance_ / std::sqrt(2.0f)},
+grid_width_ {static_cast<std::size_t>(std::ceil(width / cell_size_)) + 1},
+grid_height_ {static_cast<std::size_t>(std::ceil(height / cell_size_)) + 1},
+grid_(grid_width_ * grid_height_, kNoPoint)
+{}
+
+std::vector<std::size_t> PoissonDiskSampler::Sample(std::vector<std::size_t> const &candidates,
+                                                    std::function<bool(std::size_t)> const &is_eligible,
+                                                    std::size_t max_points) {
+    std::fill(grid_.begin(), grid_.end(), kNoPoint);
+    
+    std::vector<std::size_t> points;
+    std::vector<std::size_t> active;
+    IndexSampler seeds {candidates.size()};
+    
+    auto &rnd {RndManager::GetInstance()};
+    auto reach {static_cast<long>(std::ceil(2.0f * min_distance_))};
+    auto min_distance_2 {min_distance_ * min_distance_};
+    
+    auto try_insert = [&] (std::size_t x, std::size_t y) -> bool {
+        auto index {y * width_ + x};
+        
+        if (!is_eligible(index) || !IsFarEnough(x, y, points))
+            return false;
+        
+        grid_[GetCell(x, y)] = points.size();
+        active.push_back(points.size());
+        points.push_back(index);
+        
+        return true;
+    };
+    
+    while (points.size() < max_points) {
+        // Restart from a new seed whenever the active list runs out
+        if (active.empty()) {
+            if (seeds.empty())
+                break;
+            
+            auto seed {candidates[seeds.Draw()]};
+            try_insert(seed % width_, seed / width_);
+            continue;
+        }
+        
+        auto slot {rnd.GetRandomUintFromRange(0, active.size() - 1)};
+        auto origin {points[active[slot]]};
+        auto found {false};
+        
+        // Try candidates in the annulus between min_distance_ and twice that. Offsets are drawn as integers,
+        // since points live on tiles, and the ones outside the annulus are counted as failed attempts
+        for (std::size_t attempt {0}; attempt < max_attempts_ && !found; attempt++) {
+            auto dx {static_cast<long>(rnd.GetRandomUintFromRange(0, 2 * reach)) - reach};
+            auto dy {static_cast<long>(rnd.GetRandomUintFromRange(0, 2 * reach)) - reach};
+            auto distance_2 {static_cast<float>(dx * dx + dy * dy)};
+            
+            if (distance_2 < min_distance_2 || distance_2 > 4.0f * min_distance_2)
+                continue;
+            
+            auto x {static_cast<long>(origin % width_) + dx};
+            auto y {static_cast<long>(origin / width_) + dy};
+            
+            if (x < 0 || y < 0 || x >= (long)width_ || y >= (long)height_)
+                continue;
+            
+            found = try_insert(x, y);
+        }
+        
+        // Retire the point once its surroundings are saturated
+        if (!found) {
+            active[slot] = active.back();
+            active.pop_back();
+        }
+    }
+    
+    return points;
+}
+
+bool PoissonDiskSampler::IsFarEnough(std::size_t x, std::size_t y, std::vector<std::size_t> const &points) const {
+    auto cell_x {static_cast<long>(x / cell_size_)};
+    auto cell_y {static_cast<long>(y / cell_size_)};
+    auto min_distance_2 {min_distance_ * min_distance_};
+    
+    // A cell is min_distance_ wide on the diagonal, so any point too close lies within 2 cells
+    for (auto gy {std::max(cell_y - 2, 0l)}; gy <= std::min(cell_y + 2, (long)grid_height_ - 1); gy++) {
+        for (auto gx {std::max(cell_x - 2, 0l)}; gx <= std::min(cell_x + 2, (long)grid_width_ - 1); gx++) {
+            auto point {grid_[gy * grid_width_ + gx]};
+            
+            if (point == kNoPoint)
+                continue;
+            
+            auto dx {static_cast<float>(points[point] % width_) - static_cast<float>(x)};
+            auto dy {static_cast<float>(points[point] / width_) - static_cast<float>(y)};
+            
+            if (dx * dx + dy * dy < min_distance_2)
+                return false;
+        }
+    }
+    
+    return true;
+}
+
+std::size_t PoissonDiskSampler::GetCell(std::size_t x, std::size_t y) const {
+    return static_cast<std::size_t>(y / cell_size_) * grid_width_ + static_cast<std::size_t>(x / cell_size_);
+}
+
+}
@@ -0,0 +1,184 @@
+#include "profiler.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "utils.hpp"
+
+namespace libpmg {
+
+std::atomic<bool> Profiler::enabled_ {false};
+thread_local GenerationMetrics *Profiler::current_metrics_ {nullptr};
+thread_local std::size_t Profiler::current_phase_ {0};
+thread_local std::uint64_t Profiler::allocations_ {0};
+thread_local std::uint64_t Profiler::allocated_bytes_ {0};
+
+/**
+ Gets the current time of the steady clock.
+ */
+static std::uint64_t GetTimeNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ Gets a small id of the calling thread, assigned on first use.
+ */
+static std::uint32_t GetThreadId() {
+    static std::atomic<std::uint32_t> next_id {1};
+    thread_local std::uint32_t id {next_id.fetch_add(1, std::memory_order_relaxed)};
+
+    return id;
+}
+
+/**
+ Appends a string to a JSON document, escaping it.
+ */
+static void AppendJsonString(std::string &json, std::string const &value) {
+    json += '"';
+
+    for (auto c : value) {
+        if (c == '"' || c == '\\') {
+            json += '\\';
+            json += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            json += escaped;
+        } else {
+            json += c;
+        }
+    }
+
+    json += '"';
+}
+
+std::uint64_t PhaseMetrics::GetCounter(std::string const &name) const {
+    for (auto const &counter : counters_) {
+        if (counter.first == name)
+            return counter.second;
+    }
+
+    return 0;
+}
+
+PhaseMetrics const *GenerationMetrics::GetPhase(std::string const &name) const {
+    for (auto const &phase : phases_) {
+        if (phase.name_ == name)
+            return &phase;
+    }
+
+    return nullptr;
+}
+
+std::uint64_t GenerationMetrics::GetDuration(std::string const &name) const {
+    std::uint64_t duration {0};
+
+    for (auto const &phase : phases_) {
+        if (phase.name_ == name)
+            duration += phase.duration_ns_;
+    }
+
+    return duration;
+}
+
+std::uint64_t GenerationMetrics::GetCounter(std::string const &name) const {
+    std::uint64_t total {0};
+
+    for (auto const &phase : phases_)
+        total += phase.GetCounter(name);
+
+    return total;
+}
+
+bool GenerationMetrics::WriteChromeTrace(std::string const &path) const {
+    return WriteChromeTrace(std::vector<GenerationMetrics const*> {this}, path);
+}
+
+bool GenerationMetrics::WriteChromeTrace(std::vector<GenerationMetrics const*> const &metrics, std::string const &path) {
+    std::string json {"{\"traceEvents\":["};
+    auto first {true};
+
+    // Complete events, with timestamps and durations in microseconds
+    for (auto const &map_metrics : metrics) {
+        for (auto const &phase : map_metrics->phases_) {
+            char times[128];
+            std::snprintf(times, sizeof(times), "\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                          phase.thread_, phase.start_ns_ / 1000.0, phase.duration_ns_ / 1000.0);
+
+            json += first ? "\n{\"name\":" : ",\n{\"name\":";
+            AppendJsonString(json, phase.name_);
+            json += ",\"cat\":\"libpmg\",";
+            json += times;
+            json += ",\"args\":{\"allocations\":" + std::to_string(phase.allocations_);
+            json += ",\"allocated_bytes\":" + std::to_string(phase.allocated_bytes_);
+
+            for (auto const &counter : phase.counters_) {
+                json += ',';
+                AppendJsonString(json, counter.first);
+                json += ':' + std::to_string(counter.second);
+            }
+
+            json += "}}";
+            first = false;
+        }
+    }
+
+    json += "\n]}\n";
+
+    std::ofstream file {path, std::ios::trunc};
+    file << json;
+    file.close();
+
+    if (!file) {
+        Utils::LogError("GenerationMetrics", "Unable to write " + path);
+        return false;
+    }
+
+    return true;
+}
+
+void Profiler::AddToCurrent(char const *name, std::uint64_t value) {
+    auto &counters {current_metrics_->phases_[current_phase_].counters_};
+
+    for (auto &counter : counters) {
+        if (std::strcmp(counter.first.c_str(), name) == 0) {
+            counter.second += value;
+            return;
+        }
+    }
+
+    counters.emplace_back(name, value);
+}
+
+void ScopedPhase::Start(GenerationMetrics &metrics, char const *name) {
+    metrics_ = &metrics;
+    phase_ = metrics.phases_.size();
+    previous_metrics_ = Profiler::current_metrics_;
+    previous_phase_ = Profiler::current_phase_;
+
+    metrics.phases_.push_back(PhaseMetrics {name, 0, 0, 0, 0, GetThreadId(), {}});
+    Profiler::current_metrics_ = &metrics;
+    Profiler::current_phase_ = phase_;
+
+    // Take the starting values last, so that the bookkeeping above is not measured
+    auto &phase {metrics.phases_[phase_]};
+    phase.allocations_ = Profiler::allocations_;
+    phase.allocated_bytes_ = Profiler::allocated_bytes_;
+    phase.start_ns_ = GetTimeNs();
+}
+
+void ScopedPhase::Stop() {
+    auto end {GetTimeNs()};
+    auto &phase {metrics_->phases_[phase_]};
+
+    phase.duration_ns_ = end - phase.start_ns_;
+    phase.allocations_ = Profiler::allocations_ - phase.allocations_;
+    phase.allocated_bytes_ = Profiler::allocated_bytes_ - phase.allocated_bytes_;
+
+    Profiler::current_metrics_ = previous_metrics_;
+    Profiler::current_phase_ = previous_phase_;
+}
+
+}
@@ -69,14 +69,16 @@ Rect Rect::GetRndRect(size_t min_x,
 }
 
 void Rect::Print() {
-    std::ostringstream stream;
-    stream
-    << "Rect: X:" << x_
-    << ", Y:" << y_
-    << ", width:" << width_
-    << ", height:" << height_;
-    
-    Utils::LogDebug(stream.str());
+    Log::Debug("", [&] {
+        std::ostringstream stream;
+        stream
+        << "Rect: X:" << x_
+        << ", Y:" << y_
+        << ", width:" << width_
+        << ", height:" << height_;
+        
+        return stream.str();
+    });
 }
     
 bool Rect::IsAdjacentTile(std::size_t x, std::size_t y) {
@@ -1,23 +1,141 @@
 #include "rnd_manager.hpp"
 
+#include <mutex>
+
 #include "constants.hpp"
 
 namespace libpmg {
-    
-int RndManager::seed_ = kDefaultSeed;
 
-size_t RndManager::GetRandomUintFromRange(size_t min, size_t max) {
-    std::uniform_int_distribution random_distributor((int)min, (int)max);
-    return random_distributor(*random_generator_);
+thread_local int RndManager::seed_ = kDefaultSeed;
+
+static std::mutex engine_factory_mutex;
+static std::function<std::unique_ptr<RandomEngine>()> engine_factory;
+
+static const std::uint32_t kPhiloxMultiplier0   {0xD2511F53};
+static const std::uint32_t kPhiloxMultiplier1   {0xCD9E8D57};
+static const std::uint32_t kPhiloxWeyl0         {0x9E3779B9};
+static const std::uint32_t kPhiloxWeyl1         {0xBB67AE85};
+static const std::size_t kPhiloxRounds          {10};
+
+PhiloxEngine::PhiloxEngine() {
+    Seed(0, 0);
+}
+
+void PhiloxEngine::Seed(std::uint64_t seed, std::uint64_t stream) {
+    key_ = {static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+    counter_ = {0, 0, static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)};
+    position_ = block_.size();
+}
+
+std::uint32_t PhiloxEngine::Next() {
+    if (position_ == block_.size()) {
+        block_ = GetBlock(counter_, key_);
+        position_ = 0;
+
+        // The block index takes the low 64 bits of the counter, the stream the high ones
+        if (++counter_[0] == 0)
+            counter_[1]++;
+    }
+
+    return block_[position_++];
+}
+
+std::array<std::uint32_t, 4> PhiloxEngine::GetBlock(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key) {
+    for (std::size_t round {0}; round < kPhiloxRounds; round++) {
+        auto product0 {static_cast<std::uint64_t>(kPhiloxMultiplier0) * counter[0]};
+        auto product1 {static_cast<std::uint64_t>(kPhiloxMultiplier1) * counter[2]};
+
+        counter = {static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                   static_cast<std::uint32_t>(product1),
+                   static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                   static_cast<std::uint32_t>(product0)};
+
+        key[0] += kPhiloxWeyl0;
+        key[1] += kPhiloxWeyl1;
+    }
+
+    return counter;
+}
+
+void Mt19937Engine::Seed(std::uint64_t seed, std::uint64_t stream) {
+    auto base {static_cast<std::uint32_t>(seed)};
+    generator_.seed(stream == 0 ? base : static_cast<std::uint32_t>(RndManager::DeriveSeed(static_cast<int>(base), stream)));
+}
+
+RndStream::RndStream(int seed, std::uint64_t stream)
+: engine_ {RndManager::CreateEngine()}
+{
+    engine_->Seed(static_cast<std::uint32_t>(seed), stream);
+}
+
+std::size_t RndStream::GetRandomUintFromRange(std::size_t min, std::size_t max) {
+    if (max <= min)
+        return min;
+
+    auto &engine {*engine_};
+    auto span {static_cast<std::uint64_t>(max - min)};
+
+    if (span <= 0xFFFFFFFF) {
+        // Map a 32 bit word to the range with a multiplication, rejecting the few low words that would bias it
+        auto bound {span + 1};
+        auto product {static_cast<std::uint64_t>(engine.Next()) * bound};
+
+        if ((product & 0xFFFFFFFF) < bound) {
+            auto threshold {(0x100000000 - bound) % bound};
+
+            while ((product & 0xFFFFFFFF) < threshold)
+                product = static_cast<std::uint64_t>(engine.Next()) * bound;
+        }
+
+        return min + static_cast<std::size_t>(product >> 32);
+    }
+
+    auto mask {span};
+    for (auto shift {1}; shift < 64; shift <<= 1)
+        mask |= mask >> shift;
+
+    std::uint64_t value;
+    do {
+        // Draw the words in separate statements, since the evaluation order of operands is unspecified
+        std::uint64_t high {engine.Next()};
+        std::uint64_t low {engine.Next()};
+        value = (high << 32 | low) & mask;
+    } while (value > span);
+
+    return min + static_cast<std::size_t>(value);
+}
+
+int RndManager::DeriveSeed(int seed, std::uint64_t stream) {
+    auto z {(static_cast<std::uint64_t>(static_cast<std::uint32_t>(seed)) << 32) ^ (stream + 1) * 0x9E3779B97F4A7C15ull};
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+
+    return static_cast<int>(z & 0x7FFFFFFF);
+}
+
+void RndManager::SetEngineFactory(std::function<std::unique_ptr<RandomEngine>()> const &factory) {
+    std::lock_guard<std::mutex> lock {engine_factory_mutex};
+    engine_factory = factory;
+}
+
+std::unique_ptr<RandomEngine> RndManager::CreateEngine() {
+    {
+        std::lock_guard<std::mutex> lock {engine_factory_mutex};
+        if (engine_factory)
+            return engine_factory();
+    }
+
+    return std::make_unique<PhiloxEngine>();
 }
 
 RndManager::RndManager() {
-    if (random_generator_ == nullptr)
+    if (stream_ == nullptr)
         ResetInstance();
 }
 
 void RndManager::ResetInstance() {
-    random_generator_ = std::make_unique<std::mt19937> (seed_);
+    stream_ = std::make_unique<RndStream>(seed_, 0);
 }
-    
+
 }
@@ -7,15 +7,16 @@
 namespace libpmg {
         
 void Room::Print() {
-    
-    std::ostringstream stream;
-    stream
-    << "Room: X:" << rect_.GetX()
-    << ", Y:" << rect_.GetY()
-    << ", width:" << rect_.GetWidth()
-    << ", height:" << rect_.GetHeight();
-    
-    Utils::LogDebug(stream.str());
+    Log::Debug("", [&] {
+        std::ostringstream stream;
+        stream
+        << "Room: X:" << rect_.GetX()
+        << ", Y:" << rect_.GetY()
+        << ", width:" << rect_.GetWidth()
+        << ", height:" << rect_.GetHeight();
+        
+        return stream.str();
+    });
 }
         
 }
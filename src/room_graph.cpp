@@ -0,0 +1,162 @@
+#include "room_graph.hpp"
+
+#include <algorithm>
+
+#include "neighbor_mask.hpp"
+#include "tag_manager.hpp"
+
+namespace libpmg {
+
+RoomGraph::RoomGraph(Map &map, std::vector<std::unique_ptr<Room>> const &rooms, MoveDirections const &dir)
+: rooms_ {rooms.size()},
+dir_ {dir},
+distances_(rooms.size() * rooms.size(), kUnreachableDistance),
+next_rooms_(rooms.size() * rooms.size(), kNoRoom),
+links_(rooms.size())
+{
+    auto width {map.GetConfigs().map_width_};
+    auto height {map.GetConfigs().map_height_};
+    auto walls {map.GetTagLayer({TagManager::GetInstance().wall_tag_})};
+
+    room_layer_.assign(width * height, kNoRoom);
+
+    for (std::size_t r {0}; r < rooms_; r++) {
+        auto const &rect {rooms[r]->GetRect()};
+
+        for (auto y {rect.GetY()}; y < std::min(rect.GetY() + rect.GetHeight(), height); y++) {
+            for (auto x {rect.GetX()}; x < std::min(rect.GetX() + rect.GetWidth(), width); x++) {
+                if (room_layer_[y * width + x] == kNoRoom)
+                    room_layer_[y * width + x] = static_cast<std::uint32_t>(r);
+            }
+        }
+    }
+
+    auto neighbours {dir == MoveDirections::EIGHT_DIRECTIONAL ? 8 : 4};
+    std::vector<std::uint32_t> distances(width * height);
+    std::vector<std::uint32_t> parents(width * height);
+    std::vector<std::size_t> frontier;
+    std::vector<std::size_t> first_tiles(rooms_);
+
+    // Floods the map from every tile of a room, calling a function on every tile the first time it is reached.
+    // Direct floods stop at the other rooms, so that they only follow the corridors leaving the room
+    auto flood = [&] (std::uint32_t room, bool direct, auto const &function) {
+        std::fill(distances.begin(), distances.end(), kUnreachableDistance);
+        frontier.clear();
+
+        auto const &rect {rooms[room]->GetRect()};
+        for (auto y {rect.GetY()}; y < std::min(rect.GetY() + rect.GetHeight(), height); y++) {
+            for (auto x {rect.GetX()}; x < std::min(rect.GetX() + rect.GetWidth(), width); x++) {
+                auto i {y * width + x};
+
+                if (room_layer_[i] == room && walls[i] == 0) {
+                    distances[i] = 0;
+                    parents[i] = static_cast<std::uint32_t>(i);
+                    frontier.push_back(i);
+                }
+            }
+        }
+
+        for (std::size_t head {0}; head < frontier.size(); head++) {
+            auto current {frontier[head]};
+
+            if (direct && room_layer_[current] != kNoRoom && room_layer_[current] != room)
+                continue;
+
+            auto x {current % width};
+            auto y {current / width};
+
+            for (auto n {0}; n < neighbours; n++) {
+                auto nx {x + kNeighborOffsets[n][0]};
+                auto ny {y + kNeighborOffsets[n][1]};
+
+                if (nx >= width || ny >= height)
+                    continue;
+
+                auto nei {ny * width + nx};
+                if (walls[nei] != 0 || distances[nei] != kUnreachableDistance)
+                    continue;
+
+                distances[nei] = distances[current] + 1;
+                parents[nei] = static_cast<std::uint32_t>(current);
+                frontier.push_back(nei);
+                function(nei);
+            }
+        }
+    };
+
+    for (std::uint32_t from {0}; from < rooms_; from++) {
+        auto row {from * rooms_};
+
+        // Distances: the first tile reached in every room is the closest one
+        flood(from, false, [&] (std::size_t tile) {
+            auto room {room_layer_[tile]};
+
+            if (room != kNoRoom && room != from && distances_[row + room] == kUnreachableDistance) {
+                distances_[row + room] = distances[tile];
+                first_tiles[room] = tile;
+            }
+        });
+
+        distances_[row + from] = 0;
+        next_rooms_[row + from] = from;
+
+        // Walk every shortest way back, keeping the last room met before the first one
+        for (std::uint32_t to {0}; to < rooms_; to++) {
+            if (to == from || distances_[row + to] == kUnreachableDistance)
+                continue;
+
+            auto next {to};
+            for (auto tile {first_tiles[to]}; room_layer_[tile] != from; tile = parents[tile]) {
+                if (room_layer_[tile] != kNoRoom)
+                    next = room_layer_[tile];
+            }
+
+            next_rooms_[row + to] = next;
+        }
+
+        // Corridors: the first tile reached in every room, without crossing any other
+        flood(from, true, [&] (std::size_t tile) {
+            auto room {room_layer_[tile]};
+
+            if (room == kNoRoom || room == from)
+                return;
+
+            auto &links {links_[from]};
+            auto link {std::find_if(links.begin(), links.end(), [&] (RoomLink const &l) { return l.room_ == room; })};
+            if (link != links.end())
+                return;
+
+            RoomLink new_link {room, distances[tile], {}};
+            for (auto path_tile {parents[tile]}; room_layer_[path_tile] != from; path_tile = parents[path_tile])
+                new_link.path_.push_back(path_tile);
+
+            std::reverse(new_link.path_.begin(), new_link.path_.end());
+            links.push_back(std::move(new_link));
+        });
+
+        std::sort(links_[from].begin(), links_[from].end(), [] (RoomLink const &a, RoomLink const &b) { return a.room_ < b.room_; });
+    }
+}
+
+std::vector<std::uint32_t> RoomGraph::GetRoute(std::size_t from, std::size_t to) const {
+    std::vector<std::uint32_t> route;
+
+    if (GetDistance(from, to) == kUnreachableDistance)
+        return route;
+
+    // Every next room is strictly closer to the destination, so the walk always ends
+    route.push_back(static_cast<std::uint32_t>(from));
+    for (auto room {from}; room != to; room = GetNextRoom(room, to))
+        route.push_back(GetNextRoom(room, to));
+
+    return route;
+}
+
+RoomLink const *RoomGraph::GetLink(std::size_t from, std::size_t to) const {
+    auto const &links {links_[from]};
+    auto link {std::lower_bound(links.begin(), links.end(), to, [] (RoomLink const &l, std::size_t room) { return l.room_ < room; })};
+
+    return link != links.end() && link->room_ == to ? &*link : nullptr;
+}
+
+}
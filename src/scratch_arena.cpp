@@ -0,0 +1,77 @@
+#include "scratch_arena.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace libpmg {
+
+ScratchArena::ScratchArena(std::size_t size, std::pmr::memory_resource *upstream)
+: upstream_ {upstream},
+buffer_ {nullptr},
+capacity_ {size},
+used_ {0},
+overflow_bytes_ {0},
+peak_ {0},
+upstream_allocations_ {0}
+{
+    if (capacity_ > 0)
+        buffer_ = static_cast<std::byte*>(upstream_->allocate(capacity_, alignof(std::max_align_t)));
+}
+
+ScratchArena::~ScratchArena() {
+    for (auto const &overflow : overflows_)
+        upstream_->deallocate(overflow.data_, overflow.size_, overflow.alignment_);
+
+    if (buffer_ != nullptr)
+        upstream_->deallocate(buffer_, capacity_, alignof(std::max_align_t));
+}
+
+void *ScratchArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    auto offset {(used_ + alignment - 1) & ~(alignment - 1)};
+
+    if (alignment <= alignof(std::max_align_t) && offset + bytes <= capacity_) {
+        used_ = offset + bytes;
+        peak_ = std::max(peak_, used_ + overflow_bytes_);
+        return buffer_ + offset;
+    }
+
+    auto data {upstream_->allocate(bytes, alignment)};
+    overflows_.push_back(Overflow {data, bytes, alignment});
+    overflow_bytes_ += bytes;
+    upstream_allocations_++;
+    peak_ = std::max(peak_, used_ + overflow_bytes_);
+
+    return data;
+}
+
+void ScratchArena::Rewind(Mark const &mark) {
+    assert(mark.used_ <= used_ && mark.overflow_count_ <= overflows_.size());
+
+    for (auto i {mark.overflow_count_}; i < overflows_.size(); i++)
+        upstream_->deallocate(overflows_[i].data_, overflows_[i].size_, overflows_[i].alignment_);
+
+    overflows_.resize(mark.overflow_count_);
+    used_ = mark.used_;
+    overflow_bytes_ = mark.overflow_bytes_;
+}
+
+void ScratchArena::Release() {
+    for (auto const &overflow : overflows_)
+        upstream_->deallocate(overflow.data_, overflow.size_, overflow.alignment_);
+
+    // Grow the buffer to the peak usage, with some slack, so that the next builds fit in it
+    if (peak_ > capacity_) {
+        if (buffer_ != nullptr)
+            upstream_->deallocate(buffer_, capacity_, alignof(std::max_align_t));
+
+        capacity_ = peak_ + peak_ / 4;
+        buffer_ = static_cast<std::byte*>(upstream_->allocate(capacity_, alignof(std::max_align_t)));
+    }
+
+    overflows_.clear();
+    used_ = 0;
+    overflow_bytes_ = 0;
+    peak_ = 0;
+}
+
+}
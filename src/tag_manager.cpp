@@ -19,18 +19,31 @@ TagManager::TagManager() {
 }
 
 void TagManager::RemoveTaggable(libpmg::Taggable *taggable, Tag_p tag) {
-    tag_map_[tag].erase(
-            std::remove(tag_map_[tag].begin(), tag_map_[tag].end(), taggable),
-            tag_map_[tag].end());
+    std::lock_guard<std::mutex> lock {tag_map_mutex_};
+    
+    tag_map_[tag].erase(taggable);
 }
 
 bool TagManager::TryAddTaggable(libpmg::Taggable *taggable, Tag_p tag) {
-    if(std::find(tag_map_[tag].begin(), tag_map_[tag].end(), taggable) != tag_map_[tag].end())
-        return false;
-
-    tag_map_[tag].push_back(taggable);
+    std::lock_guard<std::mutex> lock {tag_map_mutex_};
+    
+    return tag_map_[tag].insert(taggable).second;
+}
 
-    return true;
+Tag_p TagManager::GetTag(std::string const &name) {
+    for (auto const &tag : {floor_tag_, wall_tag_, door_tag_, explored_tag_, upstairs_tag_, downstairs_tag_}) {
+        if (tag->name_ == name)
+            return tag;
+    }
+    
+    std::lock_guard<std::mutex> lock {tag_map_mutex_};
+    
+    for (auto const &kv : tag_map_) {
+        if (kv.first->name_ == name)
+            return kv.first;
+    }
+    
+    return nullptr;
 }
 
 }
@@ -0,0 +1,88 @@
+#include "terrain_cost.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace libpmg {
+
+TerrainCost::TerrainCost(WorldMap &map, TerrainCostParams const &params)
+: width_ {map.GetConfigs().map_width_},
+height_ {map.GetConfigs().map_height_},
+params_ {params}
+{
+    auto &tiles {*map.GetMap()};
+    std::vector<std::uint8_t> biomes(tiles.size());
+
+    altitude_.resize(tiles.size());
+    for (std::size_t i {0}; i < tiles.size(); i++) {
+        auto tile {(WorldTile*)tiles[i].get()};
+
+        altitude_[i] = tile->GetAltitude();
+        biomes[i] = static_cast<std::uint8_t>(tile->GetBiome());
+    }
+
+    ComputeEntryCosts(biomes.data());
+}
+
+TerrainCost::TerrainCost(float const *altitude,
+                         std::uint8_t const *biomes,
+                         std::size_t width,
+                         std::size_t height,
+                         TerrainCostParams const &params)
+: width_ {width},
+height_ {height},
+params_ {params},
+altitude_(altitude, altitude + width * height)
+{
+    assert(altitude != nullptr && biomes != nullptr);
+
+    ComputeEntryCosts(biomes);
+}
+
+void TerrainCost::ComputeEntryCosts(std::uint8_t const *biomes) {
+    entry_costs_.resize(altitude_.size());
+
+    for (std::size_t i {0}; i < altitude_.size(); i++) {
+        if (altitude_[i] < params_.water_level_ || biomes[i] >= kBiomeCount)
+            entry_costs_[i] = std::numeric_limits<float>::infinity();
+        else
+            entry_costs_[i] = params_.biome_costs_[biomes[i]];
+    }
+}
+
+std::vector<std::uint32_t> TerrainCost::BuildLayer() const {
+    std::vector<std::uint32_t> layer(entry_costs_.size());
+
+    for (std::size_t i {0}; i < entry_costs_.size(); i++) {
+        auto cost {entry_costs_[i] * kTerrainCostUnit};
+
+        // Costs too high to be stored are impassable as well
+        if (!(cost < static_cast<float>(kImpassableCost)))
+            layer[i] = kImpassableCost;
+        else
+            layer[i] = static_cast<std::uint32_t>(std::min<long>(std::lround(std::max(cost, 0.0f)), kImpassableCost - 1));
+    }
+
+    return layer;
+}
+
+float TerrainCost::GetLowestCost() const {
+    auto lowest {std::numeric_limits<float>::infinity()};
+
+    for (auto cost : entry_costs_)
+        lowest = std::min(lowest, cost);
+
+    return std::isinf(lowest) ? 0.0f : lowest;
+}
+
+float CostLayer::GetLowestCost(std::vector<std::uint32_t> const &layer) {
+    auto lowest {kImpassableCost};
+
+    for (auto cost : layer)
+        lowest = std::min(lowest, cost);
+
+    return lowest == kImpassableCost ? 0.0f : static_cast<float>(lowest) / kTerrainCostUnit;
+}
+
+}
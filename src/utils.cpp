@@ -1,30 +1,144 @@
 #include "utils.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
 #include "map.hpp"
+#include "profiler.hpp"
 
 namespace libpmg {
     
-typedef std::unique_ptr<std::unordered_map<Location*, Location*>> LocationMap_up;
+typedef std::unique_ptr<LocationMap> LocationMap_up;
+
+/**
+ Gets the context of a search, falling back to a local one, and forgets the previous search if needed.
+ */
+static SearchContext &PrepareContext(SearchContext *context, SearchContext &local, Map *map, bool reset_path_flags) {
+    auto &prepared {context != nullptr ? *context : local};
+    auto size {map->GetMap()->size()};
+
+    if (reset_path_flags || prepared.explored_.size() != size)
+        prepared.Reset(size);
+
+    return prepared;
+}
+
+/**
+ Checks whether a cost can be the priority of a BucketQueue, being a small enough integer.
+ */
+static inline bool IsBucketPriority(float cost) {
+    return cost >= 0.0f && cost <= static_cast<float>(std::numeric_limits<std::uint32_t>::max() / 2) && std::trunc(cost) == cost;
+}
+
+/**
+ Runs the Dijkstra algorithm with a queue. Queues with integer priorities give up as soon as a cost isn't an integer,
+ returning nullptr and clearing fits.
+ */
+template<typename Queue>
+static LocationMap_up RunDijkstra(Location *start_tile,
+                                  Location *end_tile,
+                                  Map *map,
+                                  MoveDirections const &dir,
+                                  SearchContext &search,
+                                  Queue &frontier,
+                                  bool &fits,
+                                  std::pmr::memory_resource *resource) {
+    auto &tiles {*map->GetMap()};
+    auto width {map->GetConfigs().map_width_};
+    auto index_of = [=] (Location *loc) -> std::uint32_t { return static_cast<std::uint32_t>(loc->GetY() * width + loc->GetX()); };
+    auto came_from {std::make_unique<LocationMap>(resource)};
+    Tile *neighbors[8];
+    
+    // Costs are only read for the tiles explored by this search, so they are never cleared
+    auto &costs {search.costs_};
+    costs.resize(tiles.size());
+    
+    auto push = [&] (Location *loc, float cost) {
+        if constexpr (std::is_integral_v<typename Queue::priority_type>) {
+            if (!IsBucketPriority(cost))
+                return fits = false;
+            
+            frontier.push(index_of(loc), static_cast<typename Queue::priority_type>(cost));
+        } else {
+            frontier.push(index_of(loc), cost);
+        }
+        
+        return true;
+    };
+    
+    fits = true;
+    
+    //Start point
+    search.MarkExplored(index_of(start_tile));
+    costs[index_of(start_tile)] = start_tile->path_cost_;
+    if (!push(start_tile, start_tile->path_cost_))
+        return nullptr;
+    
+    std::uint64_t expanded {0};
+    
+    while (!frontier.empty()) {
+        auto index {frontier.pop()};
+        Location *current {tiles[index].get()};
+        expanded++;
+        
+        for (std::size_t n {0}, count {map->GetNeighbors(current, dir, neighbors)}; n < count; n++) {
+            Location *nei {neighbors[n]};
+            auto nei_index {index_of(nei)};
+            
+            // Tiles are explored as soon as they are reached, so they are pushed once
+            if (!search.IsExplored(nei_index)) {
+                auto new_cost {costs[index] + nei->path_cost_};
+                costs[nei_index] = new_cost;
+                
+                if (!push(nei, new_cost))
+                    return nullptr;
+                
+                (*came_from)[nei] = current;
+                search.MarkExplored(nei_index);
+                
+                if (nei == end_tile) {
+                    Profiler::Count("nodes_expanded", expanded);
+                    return came_from;
+                }
+            }
+        }
+    }
+    Profiler::Count("nodes_expanded", expanded);
+    return nullptr;
+}
 
 LocationMap_up Utils::Astar(std::pair<size_t, size_t> start_coor,
                            std::pair<size_t, size_t> end_coor,
                            Map *map,
                            MoveDirections const &dir,
-                           bool reset_path_flags) {
-    if (reset_path_flags)
-        map->ResetPathFlags();
+                           bool reset_path_flags,
+                           std::pmr::memory_resource *resource,
+                           SearchContext *context) {
+    SearchContext local_context {resource};
+    auto &search {PrepareContext(context, local_context, map, reset_path_flags)};
     
     auto start_tile {map->GetTile(start_coor)};
     auto end_tile {map->GetTile(end_coor)};
     
-    PriorityQueue<Location*, float> frontier;
-    std::unordered_map<Location*, float> cost_so_far;
-    auto came_from {std::make_unique<std::unordered_map<Location*, Location*>>()};
+    // The frontier holds row major indices, so that ties are broken by position instead of by address. Priorities
+    // are not monotone, since the heuristic drops faster than the cost grows on free tiles, so it is a heap
+    auto &tiles {*map->GetMap()};
+    QuaternaryHeap<float> frontier {search.heap_positions_, tiles.size(), resource};
+    auto width {map->GetConfigs().map_width_};
+    auto index_of = [=] (Location *loc) -> std::uint32_t { return static_cast<std::uint32_t>(loc->GetY() * width + loc->GetX()); };
+    auto came_from {std::make_unique<LocationMap>(resource)};
+    Tile *neighbors[8];
+    
+    // Costs are only read for the tiles explored by this search, so they are never cleared
+    auto &costs {search.costs_};
+    costs.resize(tiles.size());
     
     //Start point
-    start_tile->is_path_explored_ = true;
-    cost_so_far[start_tile] = start_tile->path_cost_;
-    frontier.push(start_tile, start_tile->path_cost_);
+    search.MarkExplored(index_of(start_tile));
+    costs[index_of(start_tile)] = start_tile->path_cost_;
+    frontier.push(index_of(start_tile), start_tile->path_cost_);
     
     // Calculate heuristic distance
     auto heuristic_distance_calc = [=] (Location *loc1, Location *loc2) -> float {
@@ -34,28 +148,37 @@ LocationMap_up Utils::Astar(std::pair<size_t, size_t> start_coor,
         return abs(x1 - x2) + abs(y1 - y2);
     };
     
+    std::uint64_t expanded {0};
+    
     while (!frontier.empty()) {
-        auto current {frontier.pop()};
+        auto index {frontier.pop()};
+        Location *current {tiles[index].get()};
+        expanded++;
         
-        for (auto const &nei : map->GetNeighbors(current, dir)) {
-            if (nei->is_path_explored_ == false) {
-                auto new_cost {cost_so_far[current] + nei->path_cost_};
-                if (!cost_so_far.count(nei) || new_cost < cost_so_far[nei]) {
-                    cost_so_far[nei] = new_cost;
-                    
-                    // Add heuristic distance calc
-                    float priority {new_cost + heuristic_distance_calc(nei, end_tile)};
-
-                    frontier.push(nei, priority);
-                    (*came_from)[nei] = current;
-                    nei->is_path_explored_ = true;
-                }
+        for (std::size_t n {0}, count {map->GetNeighbors(current, dir, neighbors)}; n < count; n++) {
+            Location *nei {neighbors[n]};
+            auto nei_index {index_of(nei)};
+            
+            // Tiles are explored as soon as they are reached, so they are pushed once
+            if (!search.IsExplored(nei_index)) {
+                auto new_cost {costs[index] + nei->path_cost_};
+                costs[nei_index] = new_cost;
+                
+                // Add heuristic distance calc
+                float priority {new_cost + heuristic_distance_calc(nei, end_tile)};
                 
-                if ((Location*)map->GetTile(nei->GetXY()) == end_tile)
+                frontier.push(nei_index, priority);
+                (*came_from)[nei] = current;
+                search.MarkExplored(nei_index);
+                
+                if (nei == end_tile) {
+                    Profiler::Count("nodes_expanded", expanded);
                     return came_from;
+                }
             }
         }
     }
+    Profiler::Count("nodes_expanded", expanded);
     return nullptr;
 }
 
@@ -63,41 +186,30 @@ LocationMap_up Utils::Dijkstra(std::pair<size_t, size_t> start_coor,
                               std::pair<size_t, size_t> end_coor,
                               Map *map,
                               MoveDirections const &dir,
-                              bool reset_path_flags) {
-    if (reset_path_flags)
-        map->ResetPathFlags();
+                              bool reset_path_flags,
+                              std::pmr::memory_resource *resource,
+                              SearchContext *context) {
+    SearchContext local_context {resource};
+    auto &search {PrepareContext(context, local_context, map, reset_path_flags)};
     
     auto start_tile {map->GetTile(start_coor)};
     auto end_tile {map->GetTile(end_coor)};
+    bool fits;
     
-    PriorityQueue<Location*, float> frontier;
-    std::unordered_map<Location*, float> cost_so_far;
-    auto came_from {std::make_unique<std::unordered_map<Location*, Location*>>()};
-    
-    //Start point
-    start_tile->is_path_explored_ = true;
-    cost_so_far[start_tile] = start_tile->path_cost_;
-    frontier.push(start_tile, start_tile->path_cost_);
-    
-    while (!frontier.empty()) {
-        auto current {frontier.pop()};
+    // Dungeon costs are small integers, so the frontier is a bucket queue. If a cost isn't, the search starts again
+    // with a heap, unless it must keep the tiles explored by the previous search
+    if (reset_path_flags) {
+        BucketQueue<std::uint32_t> buckets {1024, resource};
+        auto came_from {RunDijkstra(start_tile, end_tile, map, dir, search, buckets, fits, resource)};
         
-        for (auto const &nei : map->GetNeighbors(current, dir)) {
-            if (nei->is_path_explored_ == false) {
-                auto new_cost {cost_so_far[current] + nei->path_cost_};
-                if (!cost_so_far.count(nei) || new_cost < cost_so_far[nei]) {
-                    cost_so_far[nei] = new_cost;
-                    frontier.push(nei, new_cost);
-                    (*came_from)[nei] = current;
-                    nei->is_path_explored_ = true;
-                }
-                
-                if ((Location*)map->GetTile(nei->GetXY()) == end_tile)
-                    return came_from;
-            }
-        }
+        if (fits)
+            return came_from;
+        
+        search.Reset(map->GetMap()->size());
     }
-    return nullptr;
+    
+    QuaternaryHeap<float> heap {search.heap_positions_, map->GetMap()->size(), resource};
+    return RunDijkstra(start_tile, end_tile, map, dir, search, heap, fits, resource);
 }
 
 LocationMap_up Utils::BreadthFirstSearch(std::pair<size_t, size_t> start_coor,
@@ -105,43 +217,185 @@ LocationMap_up Utils::BreadthFirstSearch(std::pair<size_t, size_t> start_coor,
                                         Map *map,
                                         bool diagonals,
                                         MoveDirections const &dir,
-                                        bool reset_path_flags) {
-    if (reset_path_flags)
-        map->ResetPathFlags();
+                                        bool reset_path_flags,
+                                        std::pmr::memory_resource *resource,
+                                        SearchContext *context) {
+    SearchContext local_context {resource};
+    auto &search {PrepareContext(context, local_context, map, reset_path_flags)};
     
     auto start_tile {map->GetTile(start_coor)};
     auto end_tile {map->GetTile(end_coor)};
     
-    std::queue<Location*> frontier;
-    auto came_from {std::make_unique<std::unordered_map<Location*, Location*>>()};
+    std::queue<Location*, std::pmr::deque<Location*>> frontier {std::pmr::deque<Location*> {resource}};
+    auto width {map->GetConfigs().map_width_};
+    auto index_of = [=] (Location *loc) -> std::size_t { return loc->GetY() * width + loc->GetX(); };
+    auto came_from {std::make_unique<LocationMap>(resource)};
+    Tile *neighbors[8];
     
     //Start point
-    start_tile->is_path_explored_ = true;
+    search.MarkExplored(index_of(start_tile));
     frontier.push(start_tile);
     
+    std::uint64_t expanded {0};
+    
     while (!frontier.empty()) {
         auto current {frontier.front()};
-        auto neis {map->GetNeighbors(current, dir)};
+        expanded++;
+        auto count {map->GetNeighbors(current, dir, neighbors)};
         
         if ((diagonals && dir == MoveDirections::FOUR_DIRECTIONAL) &&
             ((current->GetX() + current->GetY()) % 2 == 0))
-            std::reverse(neis.begin(), neis.end());
+            std::reverse(neighbors, neighbors + count);
         
-        for (auto const &nei : neis) {
-            if (nei->is_path_explored_ == false) {
+        for (std::size_t n {0}; n < count; n++) {
+            Location *nei {neighbors[n]};
+            
+            if (!search.IsExplored(index_of(nei))) {
                 frontier.push(nei);
                 (*came_from)[nei] = current;
-                nei->is_path_explored_ = true;
+                search.MarkExplored(index_of(nei));
             }
             
-            if ((Location*)map->GetTile(nei->GetXY()) == end_tile)
+            if (nei == end_tile) {
+                Profiler::Count("nodes_expanded", expanded);
                 return came_from;
+            }
         }
         
         frontier.pop();
     }
     
+    Profiler::Count("nodes_expanded", expanded);
     return nullptr;
 }
+
+LocationMap_up Utils::BidirectionalBreadthFirstSearch(std::pair<size_t, size_t> start_coor,
+                                                     std::pair<size_t, size_t> end_coor,
+                                                     Map *map,
+                                                     bool diagonals,
+                                                     MoveDirections const &dir,
+                                                     std::size_t max_expansions,
+                                                     std::pmr::memory_resource *resource,
+                                                     SearchContext *context) {
+    auto start_tile {map->GetTile(start_coor)};
+    auto end_tile {map->GetTile(end_coor)};
+    auto came_from {std::make_unique<LocationMap>(resource)};
+    
+    if (start_tile == nullptr || end_tile == nullptr)
+        return nullptr;
+    
+    if (start_tile == end_tile)
+        return came_from;
+    
+    auto &tiles {*map->GetMap()};
+    SearchContext local_context {resource};
+    auto &search {PrepareContext(context, local_context, map, true)};
+    
+    // Parents are only read for the tiles explored by this search, so they are never cleared. The tiles reached from
+    // the start point to where they come from, the ones reached from the end to where they lead
+    auto &parents {search.parents_};
+    parents.resize(tiles.size());
+    
+    auto width {map->GetConfigs().map_width_};
+    auto index_of = [=] (Location *loc) -> std::uint32_t { return static_cast<std::uint32_t>(loc->GetY() * width + loc->GetX()); };
+    
+    // Every frontier holds a single layer, and grows by a whole layer at a time, so that the first meeting found is
+    // on a shortest path
+    std::pmr::vector<Location*> frontiers[2] {std::pmr::vector<Location*> {resource}, std::pmr::vector<Location*> {resource}};
+    std::pmr::vector<Location*> next_layer {resource};
+    Tile *neighbors[8];
+    
+    search.MarkExplored(index_of(start_tile));
+    search.MarkExplored(index_of(end_tile), true);
+    frontiers[0].push_back(start_tile);
+    frontiers[1].push_back(end_tile);
+    
+    Location *meet_from {nullptr};
+    Location *meet_to {nullptr};
+    std::uint64_t expanded {0};
+    
+    while (meet_from == nullptr && !frontiers[0].empty() && !frontiers[1].empty()) {
+        // Grow the smaller frontier
+        auto backward {frontiers[1].size() < frontiers[0].size()};
+        auto &layer {frontiers[backward]};
+        next_layer.clear();
+        
+        for (std::size_t i {0}; i < layer.size() && meet_from == nullptr; i++) {
+            if (max_expansions > 0 && expanded >= max_expansions) {
+                Profiler::Count("nodes_expanded", expanded);
+                return nullptr;
+            }
+            
+            auto current {layer[i]};
+            expanded++;
+            auto count {map->GetNeighbors(current, dir, neighbors)};
+            
+            if ((diagonals && dir == MoveDirections::FOUR_DIRECTIONAL) &&
+                ((current->GetX() + current->GetY()) % 2 == 0))
+                std::reverse(neighbors, neighbors + count);
+            
+            for (std::size_t n {0}; n < count; n++) {
+                Location *nei {neighbors[n]};
+                auto index {index_of(nei)};
+                
+                if (search.IsExplored(index, !backward)) {
+                    meet_from = backward ? nei : current;
+                    meet_to = backward ? current : nei;
+                    break;
+                }
+                
+                if (!search.IsExplored(index, backward)) {
+                    search.MarkExplored(index, backward);
+                    parents[index] = index_of(current);
+                    next_layer.push_back(nei);
+                }
+            }
+        }
+        
+        layer.swap(next_layer);
+    }
+    
+    Profiler::Count("nodes_expanded", expanded);
+    
+    if (meet_from == nullptr)
+        return nullptr;
+    
+    // Join the two halves, so that the whole path leads back to the start
+    for (auto index {index_of(meet_from)}; index != index_of(start_tile); index = parents[index])
+        (*came_from)[tiles[index].get()] = tiles[parents[index]].get();
+    
+    (*came_from)[meet_to] = meet_from;
+    
+    for (auto index {index_of(meet_to)}; index != index_of(end_tile); index = parents[index])
+        (*came_from)[tiles[parents[index]].get()] = tiles[index].get();
+    
+    return came_from;
+}
+
+LocationMap_up Utils::LShapedPath(std::pair<size_t, size_t> start_coor,
+                                 std::pair<size_t, size_t> end_coor,
+                                 Map *map,
+                                 std::pmr::memory_resource *resource) {
+    if (map->GetTile(start_coor) == nullptr || map->GetTile(end_coor) == nullptr)
+        return nullptr;
+    
+    auto came_from {std::make_unique<LocationMap>(resource)};
+    Location *previous {map->GetTile(start_coor)};
+    auto x {start_coor.first};
+    auto y {start_coor.second};
+    
+    while (x != end_coor.first || y != end_coor.second) {
+        if (x != end_coor.first)
+            x < end_coor.first ? x++ : x--;
+        else
+            y < end_coor.second ? y++ : y--;
+        
+        Location *tile {map->GetTile(x, y)};
+        (*came_from)[tile] = previous;
+        previous = tile;
+    }
+    
+    return came_from;
+}
     
 }
@@ -2,6 +2,7 @@
 
 #include <cassert>
 
+#include "profiler.hpp"
 #include "rnd_manager.hpp"
 #include "utils.hpp"
 
@@ -22,6 +23,9 @@ std::unique_ptr<Map> &WorldBuilder::Build() {
 }
 
 void WorldBuilder::InitMap() {
+    ScopedPhase phase {map_->GetMetrics(), "InitMap"};
+    Profiler::Count("tiles", map_->GetConfigs().map_width_ * map_->GetConfigs().map_height_);
+    
     for (auto i {0}; i < map_->GetConfigs().map_height_; i++) {
         for (auto j {0}; j < map_->GetConfigs().map_width_; j++)
             map_->GetMap()->push_back (std::make_unique<WorldTile> (j, i));
@@ -29,6 +33,7 @@ void WorldBuilder::InitMap() {
 }
 
 void WorldBuilder::GenerateHeightMap() {
+    ScopedPhase phase {map_->GetMetrics(), "GenerateHeightMap"};
     auto world_configs {(WorldMapConfigs&)map_->GetConfigs()};
     
     FastNoise noise_map;
@@ -81,6 +86,8 @@ void WorldBuilder::GenerateHeightMap() {
 
 void WorldBuilder::ApplyHeightMap() {
     assert (height_map_ != nullptr);
+    
+    ScopedPhase phase {map_->GetMetrics(), "ApplyHeightMap"};
 
     for (auto i {0}; i < map_->GetConfigs().map_height_; i++) {
         for (auto j {0}; j < map_->GetConfigs().map_width_; j++) {
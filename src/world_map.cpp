@@ -1,11 +1,22 @@
 #include "world_map.hpp"
 
 namespace libpmg {
+
+WorldMap::WorldMap() {
+    configs_ = std::make_unique<WorldMapConfigs>();
+    map_ = std::make_unique<std::vector<std::unique_ptr<Tile>>>();
+}
+
+WorldMap::WorldMap(MapConfigs &configs) {
+    configs_ = std::make_unique<WorldMapConfigs>((WorldMapConfigs&) configs);
+    map_ = std::make_unique<std::vector<std::unique_ptr<Tile>>>();
+}
     
 WorldMap::WorldMap(std::shared_ptr<WorldMap> other) {
     map_uuid_ = other->map_uuid_;
     configs_ = std::move(other->configs_);
     map_ = std::move(other->map_);
+    metrics_ = std::move(other->metrics_);
 }
         
 }
@@ -0,0 +1,145 @@
+/**
+ @file field_of_view.cpp
+ @author pat <pat@fourthbox.com>
+
+ Checks FieldOfView lines of sight from a tile to itself, to its neighbours and across walls, and checks that on open
+ maps every tile seen by Compute has a line of sight, and that Compute is symmetric, failing on any mismatch.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "libpmg.hpp"
+
+using namespace libpmg;
+
+static const std::size_t kMapWidth {21};
+static const std::size_t kMapHeight {11};
+
+static std::size_t failures {0};
+
+/**
+ Reports a failed check.
+ */
+static void Check(bool passed, std::string const &what) {
+    if (passed)
+        return;
+
+    std::printf("FAILED %s\n", what.c_str());
+    failures++;
+}
+
+static std::string Pair(std::size_t x1, std::size_t y1, std::size_t x2, std::size_t y2) {
+    return std::to_string(x1) + "," + std::to_string(y1) + " to " + std::to_string(x2) + "," + std::to_string(y2);
+}
+
+/**
+ A tile always sees itself and its neighbours, even when every tile is opaque.
+ */
+static void CheckSelfAndAdjacent() {
+    TileBitset opacity {kMapWidth, kMapHeight};
+    for (std::size_t i {0}; i < kMapWidth * kMapHeight; i++)
+        opacity.SetIndex(i);
+
+    FieldOfView fov {opacity};
+
+    for (std::size_t y {0}; y < kMapHeight; y++) {
+        for (std::size_t x {0}; x < kMapWidth; x++) {
+            TileBitset visible {kMapWidth, kMapHeight};
+            fov.Compute(x, y, 0, visible);
+
+            Check(fov.HasLineOfSight(x, y, x, y), "self line of sight " + Pair(x, y, x, y));
+            Check(visible.Get(x, y), "self visible " + Pair(x, y, x, y));
+
+            for (auto dy {-1}; dy <= 1; dy++) {
+                for (auto dx {-1}; dx <= 1; dx++) {
+                    auto nx {x + dx};
+                    auto ny {y + dy};
+
+                    if (nx >= kMapWidth || ny >= kMapHeight)
+                        continue;
+
+                    Check(fov.HasLineOfSight(x, y, nx, ny), "adjacent line of sight " + Pair(x, y, nx, ny));
+                    Check(visible.Get(nx, ny), "adjacent visible " + Pair(x, y, nx, ny));
+                }
+            }
+        }
+    }
+}
+
+/**
+ A wall across the map hides every tile behind it, and a pillar the tiles straight behind it, but walls are visible.
+ */
+static void CheckBlocked() {
+    TileBitset wall {kMapWidth, kMapHeight};
+    for (std::size_t y {0}; y < kMapHeight; y++)
+        wall.Set(10, y);
+
+    FieldOfView walled {wall};
+    TileBitset visible {kMapWidth, kMapHeight};
+    walled.Compute(3, 5, 0, visible);
+
+    Check(!walled.HasLineOfSight(3, 5, 15, 5), "line of sight through a wall " + Pair(3, 5, 15, 5));
+    Check(!walled.HasLineOfSight(15, 2, 3, 8), "line of sight through a wall " + Pair(15, 2, 3, 8));
+    Check(walled.HasLineOfSight(3, 5, 10, 5), "line of sight to a wall " + Pair(3, 5, 10, 5));
+    Check(visible.Get(10, 5), "wall visible " + Pair(3, 5, 10, 5));
+
+    for (std::size_t y {0}; y < kMapHeight; y++) {
+        for (std::size_t x {11}; x < kMapWidth; x++)
+            Check(!visible.Get(x, y), "visible through a wall " + Pair(3, 5, x, y));
+    }
+
+    TileBitset pillar {kMapWidth, kMapHeight};
+    pillar.Set(10, 5);
+
+    FieldOfView pillared {pillar};
+    visible.Clear();
+    pillared.Compute(5, 5, 0, visible);
+
+    Check(!pillared.HasLineOfSight(5, 5, 15, 5), "line of sight through a pillar " + Pair(5, 5, 15, 5));
+    Check(!pillared.HasLineOfSight(15, 5, 5, 5), "line of sight through a pillar " + Pair(15, 5, 5, 5));
+    Check(!visible.Get(15, 5), "visible through a pillar " + Pair(5, 5, 15, 5));
+    Check(visible.Get(10, 5), "pillar visible " + Pair(5, 5, 10, 5));
+}
+
+/**
+ On an open map every tile has a line of sight to every other, so Compute must agree with HasLineOfSight and be
+ symmetric for any radius.
+ */
+static void CheckOpenSymmetry() {
+    FieldOfView fov {TileBitset {kMapWidth, kMapHeight}};
+    auto tiles {kMapWidth * kMapHeight};
+
+    for (auto radius : {std::size_t {3}, std::size_t {6}, kMapWidth + kMapHeight}) {
+        std::vector<TileBitset> visible(tiles, TileBitset {kMapWidth, kMapHeight});
+        for (std::size_t i {0}; i < tiles; i++)
+            fov.Compute(i % kMapWidth, i / kMapWidth, radius, visible[i]);
+
+        for (std::size_t a {0}; a < tiles; a++) {
+            auto ax {a % kMapWidth}, ay {a / kMapWidth};
+
+            for (std::size_t b {0}; b < tiles; b++) {
+                auto bx {b % kMapWidth}, by {b / kMapWidth};
+                auto what {Pair(ax, ay, bx, by) + " within " + std::to_string(radius)};
+
+                Check(visible[a].GetIndex(b) == visible[b].GetIndex(a), "symmetric visibility " + what);
+                Check(fov.HasLineOfSight(ax, ay, bx, by), "open line of sight " + what);
+
+                if (radius >= kMapWidth + kMapHeight)
+                    Check(visible[a].GetIndex(b), "open visibility " + what);
+            }
+        }
+    }
+}
+
+int main() {
+    Log::SetLevel(LogLevel::WARNING);
+
+    CheckSelfAndAdjacent();
+    CheckBlocked();
+    CheckOpenSymmetry();
+
+    std::printf("%zu failed checks\n", failures);
+    return failures == 0 ? 0 : 1;
+}
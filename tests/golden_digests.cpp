@@ -0,0 +1,252 @@
+/**
+ @file golden_digests.cpp
+ @author pat <pat@fourthbox.com>
+
+ Generates a matrix of seeds and configs through DungeonBuilder, DungeonStackBuilder and WorldBuilder, and compares the
+ digests of the maps with the golden digests checked in, failing on any mismatch.
+ Run it with <digest file> <dungeon|world>. Add --update to store the digests of a kind instead, after a change that
+ is meant to alter the maps, which must also bump kRndStreamVersion.
+ A kind with no digests stored fails, so that a test can't pass without checking anything.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "libpmg.hpp"
+
+using namespace libpmg;
+
+static const int kGoldenSeeds[] {1, 2, 3};
+
+/**
+ A list of digests, by kind and then by name.
+ */
+typedef std::map<std::string, std::map<std::string, std::string>> DigestList;
+
+/**
+ A dungeon config of the matrix.
+ */
+struct DungeonCase {
+    char const *name_;
+    std::size_t width_;
+    std::size_t height_;
+    std::size_t rooms_;
+    PathAlgorithm algorithm_;
+    bool diagonal_corridors_;
+};
+
+static const DungeonCase kDungeonCases[] {
+    {"80x50/10/AstarBfsMix", 80, 50, 10, PathAlgorithm::ASTAR_BFS_MIX, true},
+    {"128x80/25/BreadthFirstSearch", 128, 80, 25, PathAlgorithm::BREADTH_FIRST_SEARCH, true},
+    {"128x80/25/Dijkstra", 128, 80, 25, PathAlgorithm::DIJKSTRA, false},
+    {"128x80/25/Astar", 128, 80, 25, PathAlgorithm::ASTAR, false},
+    {"128x80/25/BidirectionalBreadthFirstSearch", 128, 80, 25, PathAlgorithm::BIDIRECTIONAL_BREADTH_FIRST_SEARCH, true},
+    {"160x100/40/AstarBfsMix", 160, 100, 40, PathAlgorithm::ASTAR_BFS_MIX, false},
+};
+
+/**
+ Resets the generator of the calling thread to a seed.
+ */
+static void ResetSeed(int seed) {
+    RndManager::seed_ = seed;
+    RndManager::GetInstance().ResetInstance();
+}
+
+static void ComputeDungeonDigests(std::map<std::string, std::string> &digests) {
+    for (auto seed : kGoldenSeeds) {
+        for (auto const &config : kDungeonCases) {
+            ResetSeed(seed);
+
+            DungeonBuilder builder;
+            builder.SetMapSize(config.width_, config.height_);
+            builder.SetMinRoomSize(4, 4);
+            builder.SetMaxRoomSize(12, 12);
+            builder.SetMaxRoomPlacementAttempts(10);
+            builder.SetMaxRooms(config.rooms_);
+            builder.SetMaxUpstairs(2);
+            builder.SetMaxDownstairs(2);
+            builder.SetDefaultPathAlgorithm(config.algorithm_);
+            builder.SetDiagonalCorridors(config.diagonal_corridors_);
+            builder.InitMap();
+            builder.GenerateRooms();
+            builder.GenerateCorridors();
+            builder.GenerateDoors();
+            builder.GenerateWallStairs();
+            builder.GenerateGroundStairs();
+
+            auto name {"DungeonBuilder/" + std::string {config.name_} + "/" + std::to_string(seed)};
+            digests[name] = MapDigest::ToString(MapDigest::GetTagDigest(*builder.Build()));
+        }
+
+        // Levels are built by many threads, and must not depend on which one built them
+        DungeonStackBuilder stack;
+        stack.SetLevels(3);
+        stack.SetMapSize(80, 50);
+        stack.SetSeed(seed);
+        stack.SetThreads(2);
+
+        auto &levels {stack.Build()};
+        for (std::size_t level {0}; level < levels.size(); level++) {
+            auto name {"DungeonStackBuilder/80x50/" + std::to_string(seed) + "/" + std::to_string(level)};
+            digests[name] = MapDigest::ToString(MapDigest::GetTagDigest(*levels[level]));
+        }
+    }
+}
+
+static void ComputeWorldDigests(std::map<std::string, std::string> &digests) {
+    static const std::pair<char const*, FastNoise::NoiseType> kNoiseTypes[] {
+        {"Perlin", FastNoise::Perlin},
+        {"PerlinFractal", FastNoise::PerlinFractal},
+    };
+
+    for (auto seed : kGoldenSeeds) {
+        for (auto const &noise_type : kNoiseTypes) {
+            ResetSeed(seed);
+
+            WorldBuilder builder;
+            builder.SetMapSize(128, 128);
+            builder.SetNoiseType(noise_type.second);
+            builder.InitMap();
+            builder.GenerateHeightMap();
+            builder.ApplyHeightMap();
+
+            auto &map {builder.Build()};
+            auto name {"WorldBuilder/128x128/" + std::string {noise_type.first} + "/" + std::to_string(seed)};
+            digests[name + "/tags"] = MapDigest::ToString(MapDigest::GetTagDigest(*map));
+            digests[name + "/altitude"] = MapDigest::ToString(MapDigest::GetAltitudeDigest((WorldMap&)*map));
+        }
+    }
+}
+
+/**
+ Reads a digest file.
+ @return False if the file can't be read, or was stored with another kRndStreamVersion
+ */
+static bool ReadDigests(char const *path, DigestList &golden) {
+    std::ifstream file {path};
+    if (!file) {
+        std::printf("Cannot read %s\n", path);
+        return false;
+    }
+
+    std::string line;
+    unsigned version {0};
+
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields {line};
+        std::string kind, name, digest;
+        fields >> kind >> name >> digest;
+
+        if (kind == "rnd_stream_version")
+            version = std::stoul(name);
+        else
+            golden[kind][name] = digest;
+    }
+
+    if (version != kRndStreamVersion) {
+        std::printf("%s holds digests of kRndStreamVersion %u, not %u: regenerate them with --update\n",
+                    path, version, kRndStreamVersion);
+        return false;
+    }
+
+    return true;
+}
+
+static bool WriteDigests(char const *path, DigestList const &golden) {
+    std::ofstream file {path};
+    if (!file) {
+        std::printf("Cannot write %s\n", path);
+        return false;
+    }
+
+    file << "# Golden map digests, checked by tests/golden_digests.cpp\n";
+    file << "# Regenerate a kind with: pmg_golden_digests <this file> <kind> --update\n";
+    file << "rnd_stream_version " << kRndStreamVersion << "\n";
+
+    for (auto const &kind : golden) {
+        for (auto const &digest : kind.second)
+            file << kind.first << " " << digest.first << " " << digest.second << "\n";
+    }
+
+    return static_cast<bool>(file);
+}
+
+int main(int argc, char **argv) {
+    Log::SetLevel(LogLevel::WARNING);
+
+    if (argc < 3) {
+        std::printf("Usage: %s <digest file> <dungeon|world> [--update]\n", argv[0]);
+        return 1;
+    }
+
+    auto path {argv[1]};
+    std::string kind {argv[2]};
+    auto update {argc > 3 && std::strcmp(argv[3], "--update") == 0};
+
+    std::map<std::string, std::string> digests;
+    if (kind == "dungeon") {
+        ComputeDungeonDigests(digests);
+    } else if (kind == "world") {
+        ComputeWorldDigests(digests);
+    } else {
+        std::printf("Unknown kind %s\n", kind.c_str());
+        return 1;
+    }
+
+    DigestList golden;
+
+    if (update) {
+        // Keep the digests of the other kinds, unless they were stored with another kRndStreamVersion
+        if (!ReadDigests(path, golden))
+            golden.clear();
+
+        golden[kind] = digests;
+        if (!WriteDigests(path, golden))
+            return 1;
+
+        std::printf("Stored %zu %s digests\n", digests.size(), kind.c_str());
+        return 0;
+    }
+
+    if (!ReadDigests(path, golden))
+        return 1;
+
+    auto &expected {golden[kind]};
+    if (expected.empty()) {
+        std::printf("No %s digests stored: generate them with --update\n", kind.c_str());
+        return 1;
+    }
+
+    std::size_t mismatches {0};
+
+    for (auto const &digest : digests) {
+        auto stored {expected.find(digest.first)};
+
+        if (stored == expected.end()) {
+            std::printf("MISSING  %s %s\n", digest.first.c_str(), digest.second.c_str());
+            mismatches++;
+        } else if (stored->second != digest.second) {
+            std::printf("MISMATCH %s expected %s, got %s\n", digest.first.c_str(), stored->second.c_str(), digest.second.c_str());
+            mismatches++;
+        }
+    }
+
+    for (auto const &digest : expected) {
+        if (digests.count(digest.first) == 0) {
+            std::printf("STALE    %s\n", digest.first.c_str());
+            mismatches++;
+        }
+    }
+
+    std::printf("%zu %s digests, %zu mismatches\n", digests.size(), kind.c_str(), mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+/**
+ @file incremental_repair.cpp
+ @author pat <pat@fourthbox.com>
+
+ Applies random edits to the costs, sources and tags of dungeon maps, and after every batch of edits compares the
+ fields repaired by DijkstraMap::Update and the labels repaired by Connectivity::RepairComponents with the ones
+ computed again from scratch, failing on any difference. Labels are compared up to relabelling.
+ Run it with [seeds] [batches].
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+#include "libpmg.hpp"
+
+using namespace libpmg;
+
+static const std::size_t kDefaultSeeds {4};
+static const std::size_t kDefaultBatches {300};
+static const std::size_t kMaxEditsPerBatch {4};
+static const std::size_t kSources {3};
+static const std::size_t kMapWidth {64};
+static const std::size_t kMapHeight {48};
+
+/**
+ The costs drawn by SetCost edits, 0 making a tile unwalkable.
+ */
+static const std::uint8_t kEditCosts[] {0, 1, 1, 2, 7};
+
+/**
+ Generates a dungeon map, whose walls are the unwalkable tiles.
+ */
+static std::unique_ptr<Map> Generate(int seed) {
+    RndManager::seed_ = seed;
+    RndManager::GetInstance().ResetInstance();
+
+    DungeonBuilder builder;
+    builder.SetMapSize(kMapWidth, kMapHeight);
+    builder.SetMinRoomSize(4, 4);
+    builder.SetMaxRoomSize(10, 10);
+    builder.SetMaxRoomPlacementAttempts(10);
+    builder.SetMaxRooms(12);
+    builder.InitMap();
+    builder.GenerateRooms();
+    builder.GenerateCorridors();
+    builder.GenerateDoors();
+
+    return std::move(builder.Build());
+}
+
+/**
+ Checks whether two labellings split the tiles into the same components, whatever their labels.
+ @return True if there is a one to one mapping between the labels, false otherwise
+ */
+static bool SameComponents(std::vector<std::uint32_t> const &repaired, std::vector<std::uint32_t> const &expected) {
+    std::unordered_map<std::uint32_t, std::uint32_t> forward, backward;
+
+    for (std::size_t i {0}; i < expected.size(); i++) {
+        if ((repaired[i] == kNoComponent) != (expected[i] == kNoComponent))
+            return false;
+
+        if (expected[i] == kNoComponent)
+            continue;
+
+        auto to {forward.emplace(repaired[i], expected[i]).first};
+        auto from {backward.emplace(expected[i], repaired[i]).first};
+
+        if (to->second != expected[i] || from->second != repaired[i])
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ Compares a field with a field built from scratch on the same costs and sources.
+ @return True if every distance matches, false otherwise
+ */
+static bool SameField(DijkstraMap const &repaired, DijkstraMap &expected) {
+    expected.SetSources(repaired.GetSources());
+    expected.Update();
+
+    return repaired.GetDistances() == expected.GetDistances();
+}
+
+/**
+ Picks a random walkable tile.
+ @return The row major index of the tile, or the size of the layer if none was found
+ */
+static std::size_t PickWalkable(RndStream &rnd, std::vector<std::uint8_t> const &costs) {
+    for (std::size_t attempt {0}; attempt < 1000; attempt++) {
+        auto index {rnd.GetRandomUintFromRange(0, costs.size() - 1)};
+        if (costs[index] != 0)
+            return index;
+    }
+
+    return costs.size();
+}
+
+/**
+ Edits a cost layer with SetCost and MoveSource.
+ @return The number of mismatches
+ */
+static std::size_t CheckCostEdits(Map &map, int seed, MoveDirections dir, std::size_t batches) {
+    auto walls {map.GetTagLayer({TagManager::GetInstance().wall_tag_})};
+    std::vector<std::uint8_t> costs(walls.size());
+    for (std::size_t i {0}; i < walls.size(); i++)
+        costs[i] = walls[i] == 0 ? 1 : 0;
+
+    RndStream rnd {seed, 1 + static_cast<std::uint64_t>(dir)};
+    DijkstraMap field {costs, kMapWidth, kMapHeight, dir};
+    std::vector<std::size_t> sources;
+
+    for (std::size_t s {0}; s < kSources; s++)
+        sources.push_back(PickWalkable(rnd, costs));
+
+    field.SetSources(sources);
+    field.Update();
+
+    std::size_t components;
+    auto labels {Connectivity::LabelComponents(costs, kMapWidth, kMapHeight, dir, components)};
+    std::size_t mismatches {0};
+
+    for (std::size_t batch {0}; batch < batches; batch++) {
+        std::vector<std::size_t> changed;
+        auto edits {rnd.GetRandomUintFromRange(1, kMaxEditsPerBatch)};
+
+        for (std::size_t edit {0}; edit < edits; edit++) {
+            if (rnd.GetRandomUintFromRange(0, 3) == 0 && !field.GetSources().empty()) {
+                auto &current {field.GetSources()};
+                auto from {current[rnd.GetRandomUintFromRange(0, current.size() - 1)]};
+                auto to {PickWalkable(rnd, costs)};
+
+                if (to < costs.size() && std::find(current.begin(), current.end(), to) == current.end())
+                    field.MoveSource(from, to);
+            } else {
+                auto index {rnd.GetRandomUintFromRange(0, costs.size() - 1)};
+                auto cost {kEditCosts[rnd.GetRandomUintFromRange(0, std::size(kEditCosts) - 1)]};
+
+                field.SetCost(index, cost);
+                costs[index] = cost;
+                changed.push_back(index);
+            }
+        }
+
+        field.Update();
+        Connectivity::RepairComponents(costs, kMapWidth, kMapHeight, dir, changed, labels, components);
+
+        DijkstraMap expected {costs, kMapWidth, kMapHeight, dir};
+        if (!SameField(field, expected)) {
+            std::printf("MISMATCH seed %d, %d directions, batch %zu: SetCost/MoveSource distances\n",
+                        seed, static_cast<int>(dir), batch);
+            mismatches++;
+        }
+
+        std::size_t expected_components;
+        if (!SameComponents(labels, Connectivity::LabelComponents(costs, kMapWidth, kMapHeight, dir, expected_components))) {
+            std::printf("MISMATCH seed %d, %d directions, batch %zu: components\n", seed, static_cast<int>(dir), batch);
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+/**
+ Digs and fills walls of a map with UpdateTileTags, syncing a field built from the map.
+ @return The number of mismatches
+ */
+static std::size_t CheckTagEdits(Map &map, int seed, MoveDirections dir, std::size_t batches) {
+    auto wall {TagManager::GetInstance().wall_tag_};
+    auto floor {TagManager::GetInstance().floor_tag_};
+
+    RndStream rnd {seed, 3 + static_cast<std::uint64_t>(dir)};
+    DijkstraMap field {map, dir};
+    std::vector<std::size_t> sources;
+
+    auto walls {map.GetTagLayer({wall})};
+    std::vector<std::uint8_t> walkable(walls.size());
+    for (std::size_t i {0}; i < walls.size(); i++)
+        walkable[i] = walls[i] == 0;
+
+    for (std::size_t s {0}; s < kSources; s++)
+        sources.push_back(PickWalkable(rnd, walkable));
+
+    field.SetSources(sources);
+    field.Update();
+
+    std::size_t mismatches {0};
+
+    for (std::size_t batch {0}; batch < batches; batch++) {
+        auto edits {rnd.GetRandomUintFromRange(1, kMaxEditsPerBatch)};
+
+        for (std::size_t edit {0}; edit < edits; edit++) {
+            auto x {rnd.GetRandomUintFromRange(0, kMapWidth - 1)};
+            auto y {rnd.GetRandomUintFromRange(0, kMapHeight - 1)};
+
+            if (map.GetTile(x, y)->HasTag(wall))
+                map.UpdateTileTags(x, y, {floor}, {wall});
+            else
+                map.UpdateTileTags(x, y, {wall}, {floor});
+        }
+
+        field.Sync(map);
+        field.Update();
+
+        DijkstraMap expected {map, dir};
+        if (!SameField(field, expected)) {
+            std::printf("MISMATCH seed %d, %d directions, batch %zu: UpdateTileTags distances\n",
+                        seed, static_cast<int>(dir), batch);
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+int main(int argc, char **argv) {
+    Log::SetLevel(LogLevel::ERROR);
+
+    auto seeds {argc > 1 ? std::strtoul(argv[1], nullptr, 10) : kDefaultSeeds};
+    auto batches {argc > 2 ? std::strtoul(argv[2], nullptr, 10) : kDefaultBatches};
+    std::size_t mismatches {0};
+
+    for (std::size_t seed {1}; seed <= seeds; seed++) {
+        for (auto dir : {MoveDirections::FOUR_DIRECTIONAL, MoveDirections::EIGHT_DIRECTIONAL}) {
+            mismatches += CheckCostEdits(*Generate(static_cast<int>(seed)), static_cast<int>(seed), dir, batches);
+            mismatches += CheckTagEdits(*Generate(static_cast<int>(seed)), static_cast<int>(seed), dir, batches);
+        }
+    }
+
+    std::printf("%zu seeds, %zu batches each, %zu mismatches\n", seeds, batches, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
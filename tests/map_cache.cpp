@@ -0,0 +1,143 @@
+/**
+ @file map_cache.cpp
+ @author pat <pat@fourthbox.com>
+
+ Generates dungeon maps through a MapCache twice, the first time missing the cache and the second time loading the
+ stored map, and checks that the two maps hold the same tags, path costs, rooms and corridors, failing on any difference.
+ Run it with [cache directory]. By default a temporary directory is used, and removed at the end.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "libpmg.hpp"
+
+using namespace libpmg;
+
+static const int kSeeds[] {1, 2, 3};
+
+/**
+ Generates a dungeon map with corridors crossing rooms and each other.
+ */
+static std::unique_ptr<Map> Generate() {
+    DungeonBuilder builder;
+    builder.SetMapSize(96, 64);
+    builder.SetMinRoomSize(4, 4);
+    builder.SetMaxRoomSize(12, 12);
+    builder.SetMaxRoomPlacementAttempts(10);
+    builder.SetMaxRooms(20);
+    builder.InitMap();
+    builder.GenerateRooms();
+    builder.GenerateCorridors();
+    builder.GenerateDoors();
+    builder.GenerateWallStairs();
+
+    return std::move(builder.Build());
+}
+
+/**
+ Compares a generated map with the same map loaded from the cache.
+ @return The number of differences
+ */
+static std::size_t Compare(DungeonMap &generated, DungeonMap &loaded, int seed) {
+    std::size_t differences {0};
+    auto report = [&] (char const *what) {
+        std::printf("MISMATCH seed %d: %s\n", seed, what);
+        differences++;
+    };
+
+    auto width {generated.GetConfigs().map_width_};
+    auto height {generated.GetConfigs().map_height_};
+
+    if (loaded.GetConfigs().map_width_ != width || loaded.GetConfigs().map_height_ != height) {
+        report("map size");
+        return differences;
+    }
+
+    if (MapDigest::GetTagDigest(generated) != MapDigest::GetTagDigest(loaded))
+        report("tags");
+
+    if (generated.GetRoomList().size() != loaded.GetRoomList().size())
+        report("room count");
+
+    if (generated.GetCorridorCount() == 0)
+        report("no corridors generated");
+
+    if (generated.GetCorridorCount() != loaded.GetCorridorCount())
+        report("corridor count");
+
+    if (generated.GetRegionLayer() != loaded.GetRegionLayer())
+        report("region layer");
+
+    for (std::size_t y {0}; y < height; y++) {
+        for (std::size_t x {0}; x < width; x++) {
+            if (generated.GetRoomAt(x, y) != loaded.GetRoomAt(x, y)
+                || generated.GetCorridorAt(x, y) != loaded.GetCorridorAt(x, y)) {
+                std::printf("MISMATCH seed %d: region of %zu,%zu\n", seed, x, y);
+                return differences + 1;
+            }
+
+            if (generated.GetTile(x, y)->path_cost_ != loaded.GetTile(x, y)->path_cost_) {
+                std::printf("MISMATCH seed %d: path cost of %zu,%zu\n", seed, x, y);
+                return differences + 1;
+            }
+        }
+    }
+
+    return differences;
+}
+
+int main(int argc, char **argv) {
+    Log::SetLevel(LogLevel::WARNING);
+
+    char temporary[] {"/tmp/pmg_map_cache_XXXXXX"};
+    auto owned {argc < 2};
+
+    if (owned && mkdtemp(temporary) == nullptr) {
+        std::printf("Cannot create a temporary directory\n");
+        return 1;
+    }
+
+    std::string directory {owned ? temporary : argv[1]};
+    MapCache cache {directory};
+    std::size_t differences {0};
+
+    for (auto seed : kSeeds) {
+        auto key {MapCache::GetKey((DungeonMapConfigs&)Generate()->GetConfigs(), seed, "tests/map_cache")};
+        auto generated {cache.GetMap(key, seed, Generate)};
+
+        auto regenerated {false};
+        auto loaded {cache.GetMap(key, seed, [&] () {
+            regenerated = true;
+            return Generate();
+        })};
+
+        if (generated == nullptr || loaded == nullptr || regenerated) {
+            std::printf("MISMATCH seed %d: the map was not served from the cache\n", seed);
+            differences++;
+            continue;
+        }
+
+        differences += Compare((DungeonMap&)*generated, (DungeonMap&)*loaded, seed);
+    }
+
+    if (owned) {
+        if (auto entries = opendir(directory.c_str())) {
+            while (auto entry = readdir(entries)) {
+                if (entry->d_name[0] != '.')
+                    unlink((directory + "/" + entry->d_name).c_str());
+            }
+            closedir(entries);
+        }
+
+        rmdir(directory.c_str());
+    }
+
+    std::printf("%zu seeds, %zu differences\n", std::size(kSeeds), differences);
+    return differences == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/**
+ @file random_engines.cpp
+ @author pat <pat@fourthbox.com>
+
+ Checks the random engines against known answers: the Philox4x32-10 vectors published with the Random123 library,
+ and the 10000th word of a default seeded std::mt19937, required by the C++ standard. Also checks that the words of
+ PhiloxEngine streams are laid out as documented, failing on any mismatch.
+ */
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+
+#include "libpmg.hpp"
+
+using namespace libpmg;
+
+/**
+ A Philox4x32-10 known answer vector.
+ */
+struct PhiloxVector {
+    std::array<std::uint32_t, 4> counter_;
+    std::array<std::uint32_t, 2> key_;
+    std::array<std::uint32_t, 4> block_;
+};
+
+static const PhiloxVector kPhiloxVectors[] {
+    {{0x00000000, 0x00000000, 0x00000000, 0x00000000}, {0x00000000, 0x00000000},
+     {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+    {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff},
+     {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+    {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0},
+     {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+};
+
+static const std::uint32_t kMt19937Seed {5489};
+static const std::uint32_t kMt19937Word10000 {4123659995};
+
+int main() {
+    std::size_t failures {0};
+
+    for (auto const &vector : kPhiloxVectors) {
+        if (PhiloxEngine::GetBlock(vector.counter_, vector.key_) != vector.block_) {
+            std::printf("FAILED Philox4x32-10 vector with counter %08x %08x %08x %08x\n",
+                        vector.counter_[0], vector.counter_[1], vector.counter_[2], vector.counter_[3]);
+            failures++;
+        }
+    }
+
+    // The first block of stream 0 of seed 0 is the all zero vector, also the first words drawn by the default engine
+    PhiloxEngine zero;
+    RndStream stream {0, 0};
+
+    for (auto word : kPhiloxVectors[0].block_) {
+        if (zero.Next() != word || stream.GetEngine().Next() != word) {
+            std::printf("FAILED first words of seed 0, stream 0\n");
+            failures++;
+            break;
+        }
+    }
+
+    // Seeds are the key, block indices the low half of the counter and streams the high half
+    std::uint64_t const seed {0x299f31d0a4093822};
+    std::uint64_t const stream_number {0x0370734413198a2e};
+    PhiloxEngine engine;
+    engine.Seed(seed, stream_number);
+
+    for (std::uint32_t block {0}; block < 4; block++) {
+        auto expected {PhiloxEngine::GetBlock({block, 0, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0})};
+
+        for (auto word : expected) {
+            if (engine.Next() != word) {
+                std::printf("FAILED layout of block %u\n", block);
+                failures++;
+                break;
+            }
+        }
+    }
+
+    Mt19937Engine mt19937;
+    mt19937.Seed(kMt19937Seed, 0);
+
+    for (std::size_t word {1}; word < 10000; word++)
+        mt19937.Next();
+
+    if (mt19937.Next() != kMt19937Word10000) {
+        std::printf("FAILED 10000th word of std::mt19937\n");
+        failures++;
+    }
+
+    std::printf("%zu failed checks\n", failures);
+    return failures == 0 ? 0 : 1;
+}
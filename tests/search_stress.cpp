@@ -0,0 +1,169 @@
+/**
+ @file search_stress.cpp
+ @author pat <pat@fourthbox.com>
+
+ Runs the path searches on a single shared map from many threads at once, every thread with its own SearchContext,
+ and checks every path against the one found by a single thread, failing on any mismatch.
+ Run it with [threads] [rounds]. Build with PMG_SANITIZER=thread to check for data races too.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "libpmg.hpp"
+
+using namespace libpmg;
+
+static const std::size_t kDefaultThreads {8};
+static const std::size_t kDefaultRounds {2};
+static const std::size_t kMapWidth {128};
+static const std::size_t kMapHeight {80};
+
+typedef std::pair<std::size_t, std::size_t> Coords;
+
+/**
+ A search of the test, run with a context of its own.
+ */
+struct Search {
+    char const *name_;
+    std::function<std::unique_ptr<LocationMap>(Coords, Coords, Map*, SearchContext&)> run_;
+};
+
+static const Search kSearches[] {
+    {"BreadthFirstSearch", [] (Coords start, Coords end, Map *map, SearchContext &context) {
+        return Utils::BreadthFirstSearch(start, end, map, false, MoveDirections::FOUR_DIRECTIONAL, true,
+                                         std::pmr::get_default_resource(), &context);
+    }},
+    {"BidirectionalBreadthFirstSearch", [] (Coords start, Coords end, Map *map, SearchContext &context) {
+        return Utils::BidirectionalBreadthFirstSearch(start, end, map, true, MoveDirections::FOUR_DIRECTIONAL, 0,
+                                                      std::pmr::get_default_resource(), &context);
+    }},
+    {"Dijkstra", [] (Coords start, Coords end, Map *map, SearchContext &context) {
+        return Utils::Dijkstra(start, end, map, MoveDirections::FOUR_DIRECTIONAL, true,
+                               std::pmr::get_default_resource(), &context);
+    }},
+    {"Astar", [] (Coords start, Coords end, Map *map, SearchContext &context) {
+        return Utils::Astar(start, end, map, MoveDirections::EIGHT_DIRECTIONAL, true,
+                            std::pmr::get_default_resource(), &context);
+    }},
+};
+
+/**
+ Walks a path back from its end.
+ @return The row major indices of the path, from the end to the start, or an empty list if there is no path
+ */
+static std::vector<std::size_t> GetPath(std::unique_ptr<LocationMap> const &came_from, Coords start, Coords end, Map *map) {
+    std::vector<std::size_t> path;
+    if (came_from == nullptr)
+        return path;
+
+    auto start_tile {map->GetTile(start)};
+    Location *current {map->GetTile(end)};
+
+    while (current != start_tile) {
+        path.push_back(current->GetY() * kMapWidth + current->GetX());
+
+        auto from {came_from->find(current)};
+        if (from == came_from->end() || path.size() > kMapWidth * kMapHeight)
+            return {};
+
+        current = from->second;
+    }
+
+    path.push_back(start_tile->GetY() * kMapWidth + start_tile->GetX());
+    return path;
+}
+
+int main(int argc, char **argv) {
+    Log::SetLevel(LogLevel::WARNING);
+
+    auto threads {argc > 1 ? std::strtoul(argv[1], nullptr, 10) : kDefaultThreads};
+    auto rounds {argc > 2 ? std::strtoul(argv[2], nullptr, 10) : kDefaultRounds};
+
+    RndManager::seed_ = 1;
+    RndManager::GetInstance().ResetInstance();
+
+    DungeonBuilder builder;
+    builder.SetMapSize(kMapWidth, kMapHeight);
+    builder.SetMinRoomSize(4, 4);
+    builder.SetMaxRoomSize(12, 12);
+    builder.SetMaxRoomPlacementAttempts(10);
+    builder.SetMaxRooms(25);
+    builder.InitMap();
+    builder.GenerateRooms();
+    builder.GenerateCorridors();
+    builder.GenerateDoors();
+
+    auto map {builder.Build().get()};
+
+    // Link every room to a few others, through walls too, so that the searches cross the whole map
+    std::vector<std::pair<Coords, Coords>> queries;
+    auto &rooms {((DungeonMap*)map)->GetRoomList()};
+
+    for (std::size_t r {0}; r < rooms.size(); r++) {
+        for (std::size_t step : {1, 3, 7}) {
+            auto &from {rooms[r]->GetRect()};
+            auto &to {rooms[(r + step) % rooms.size()]->GetRect()};
+            queries.push_back({{from.GetX(), from.GetY()}, {to.GetX() + to.GetWidth() - 1, to.GetY() + to.GetHeight() - 1}});
+        }
+    }
+
+    if (queries.empty()) {
+        std::printf("No rooms to search between\n");
+        return 1;
+    }
+
+    // The paths found by a single thread
+    std::vector<std::vector<std::size_t>> expected;
+    SearchContext context;
+
+    for (auto const &search : kSearches) {
+        for (auto const &query : queries)
+            expected.push_back(GetPath(search.run_(query.first, query.second, map, context), query.first, query.second, map));
+    }
+
+    std::atomic<std::size_t> mismatches {0};
+    std::atomic<bool> go {false};
+    std::vector<std::thread> workers;
+
+    for (std::size_t t {0}; t < threads; t++) {
+        workers.emplace_back([&, t] () {
+            SearchContext context;
+            auto count {std::size(kSearches) * queries.size()};
+
+            while (!go.load())
+                std::this_thread::yield();
+
+            // Every thread starts from a different search, so that they all run at once
+            for (std::size_t round {0}; round < rounds; round++) {
+                for (std::size_t i {0}; i < count; i++) {
+                    auto job {(i + t * count / threads) % count};
+                    auto &search {kSearches[job / queries.size()]};
+                    auto &query {queries[job % queries.size()]};
+
+                    auto path {GetPath(search.run_(query.first, query.second, map, context), query.first, query.second, map)};
+
+                    if (path != expected[job]) {
+                        std::printf("MISMATCH %s from %zu,%zu to %zu,%zu on thread %zu\n", search.name_,
+                                    query.first.first, query.first.second, query.second.first, query.second.second, t);
+                        mismatches++;
+                    }
+                }
+            }
+        });
+    }
+
+    go.store(true);
+
+    for (auto &worker : workers)
+        worker.join();
+
+    std::printf("%zu threads, %zu searches each, %zu mismatches\n",
+                threads, rounds * std::size(kSearches) * queries.size(), mismatches.load());
+    return mismatches == 0 ? 0 : 1;
+}